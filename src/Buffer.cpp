@@ -2,15 +2,13 @@
 
 #include "Util.h"
 
-#include <sstream>
-
 Buffer::Buffer(const VkDevice device,
-               const VkPhysicalDevice physicalDevice,
+               MemoryAllocator* memoryAllocator,
                const VkBufferUsageFlags bufferUsageFlags,
                const VkMemoryPropertyFlags memoryProperties,
                const VkDeviceSize size,
                const void* data)
-: device(device), size(size)
+: device(device), memoryAllocator(memoryAllocator), size(size)
 {
   VkBufferCreateInfo bufferCreateInfo{ VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
   bufferCreateInfo.size = size;
@@ -26,43 +24,17 @@ Buffer::Buffer(const VkDevice device,
   VkMemoryRequirements memoryRequirements;
   vkGetBufferMemoryRequirements(device, buffer, &memoryRequirements);
 
-  VkPhysicalDeviceMemoryProperties supportedMemoryProperties;
-  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &supportedMemoryProperties);
-
-  const VkMemoryPropertyFlags typeFilter = memoryRequirements.memoryTypeBits;
-  uint32_t memoryTypeIndex = 0u;
-  bool memoryTypeFound = false;
-  for (uint32_t i = 0u; i < supportedMemoryProperties.memoryTypeCount; ++i)
-  {
-    const VkMemoryPropertyFlags propertyFlags = supportedMemoryProperties.memoryTypes[i].propertyFlags;
-    if (typeFilter & (1 << i) && (propertyFlags & memoryProperties) == memoryProperties)
-    {
-      memoryTypeIndex = i;
-      memoryTypeFound = true;
-      break;
-    }
-  }
-
-  if (!memoryTypeFound)
+  // Staging buffers are short-lived and allocated linearly, everything else uses the buddy strategy
+  const MemoryAllocator::Strategy strategy = bufferUsageFlags == VK_BUFFER_USAGE_TRANSFER_SRC_BIT ?
+                                               MemoryAllocator::Strategy::Linear :
+                                               MemoryAllocator::Strategy::Buddy;
+  if (!memoryAllocator->allocate(memoryRequirements, memoryProperties, false, strategy, allocation))
   {
-    util::error(Error::FeatureNotSupported, "Suitable buffer memory type");
     valid = false;
     return;
   }
 
-  VkMemoryAllocateInfo memoryAllocateInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-  memoryAllocateInfo.allocationSize = memoryRequirements.size;
-  memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
-  if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &deviceMemory) != VK_SUCCESS)
-  {
-    std::stringstream s;
-    s << memoryRequirements.size << " bytes for buffer";
-    util::error(Error::OutOfMemory, s.str());
-    valid = false;
-    return;
-  }
-
-  if (vkBindBufferMemory(device, buffer, deviceMemory, 0u) != VK_SUCCESS)
+  if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS)
   {
     util::error(Error::GenericVulkan);
     valid = false;
@@ -72,7 +44,7 @@ Buffer::Buffer(const VkDevice device,
   // Fill the buffer with data
   if (data)
   {
-    void* bufferData = map();
+    void* bufferData = getMappedData();
     if (!bufferData)
     {
       valid = false;
@@ -80,70 +52,35 @@ Buffer::Buffer(const VkDevice device,
     }
 
     memcpy(bufferData, data, size);
-    unmap();
+    if (!flush(0u, size))
+    {
+      valid = false;
+      return;
+    }
   }
 }
 
 Buffer::~Buffer()
 {
-  vkFreeMemory(device, deviceMemory, nullptr);
   vkDestroyBuffer(device, buffer, nullptr);
+  memoryAllocator->free(allocation);
 }
 
-bool Buffer::copyTo(const Buffer& target, VkCommandBuffer commandBuffer, VkQueue queue) const
+void* Buffer::getMappedData() const
 {
-  VkCommandBufferBeginInfo beginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-  beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-  if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+  // Host visible memory stays mapped for the lifetime of the allocator
+  if (!allocation.mappedData)
   {
-    util::error(Error::GenericVulkan);
-    return false;
-  }
-
-  VkBufferCopy copyRegion{};
-  copyRegion.size = size;
-  vkCmdCopyBuffer(commandBuffer, buffer, target.getVkBuffer(), 1u, &copyRegion);
-
-  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
-  {
-    util::error(Error::GenericVulkan);
-    return false;
-  }
-
-  VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
-  submitInfo.commandBufferCount = 1u;
-  submitInfo.pCommandBuffers = &commandBuffer;
-  if (vkQueueSubmit(queue, 1u, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
-  {
-    util::error(Error::GenericVulkan);
-    return false;
-  }
-
-  if (vkQueueWaitIdle(queue) != VK_SUCCESS)
-  {
-    util::error(Error::GenericVulkan);
-    return false;
-  }
-
-  return true;
-}
-
-void* Buffer::map() const
-{
-  void* data;
-  VkResult result = vkMapMemory(device, deviceMemory, 0u, size, 0, &data);
-  if (result != VK_SUCCESS)
-  {
-    util::error(Error::GenericVulkan);
+    util::error(Error::GenericVulkan, "Buffer memory is not host visible");
     return nullptr;
   }
 
-  return data;
+  return allocation.mappedData;
 }
 
-void Buffer::unmap() const
+bool Buffer::flush(VkDeviceSize offset, VkDeviceSize range) const
 {
-  vkUnmapMemory(device, deviceMemory);
+  return memoryAllocator->flush(allocation, offset, range);
 }
 
 bool Buffer::isValid() const
@@ -1,21 +1,22 @@
 #pragma once
 
+#include "MemoryAllocator.h"
+
 #include <vulkan/vulkan.h>
 
 class Buffer final
 {
 public:
   Buffer(VkDevice device,
-         VkPhysicalDevice physicalDevice,
+         MemoryAllocator* memoryAllocator,
          VkBufferUsageFlags bufferUsageFlags,
          VkMemoryPropertyFlags memoryProperties,
          VkDeviceSize size,
          const void* data = nullptr);
   ~Buffer();
 
-  bool copyTo(const Buffer& target, VkCommandBuffer commandBuffer, VkQueue queue) const;
-  void* map() const;
-  void unmap() const;
+  void* getMappedData() const;
+  bool flush(VkDeviceSize offset, VkDeviceSize range) const;
 
   bool isValid() const;
   VkBuffer getVkBuffer() const;
@@ -24,7 +25,8 @@ private:
   bool valid = true;
 
   VkDevice device = nullptr;
+  MemoryAllocator* memoryAllocator = nullptr;
   VkBuffer buffer = nullptr;
-  VkDeviceMemory deviceMemory = nullptr;
+  MemoryAllocation allocation;
   VkDeviceSize size = 0u;
 };
\ No newline at end of file
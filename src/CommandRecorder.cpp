@@ -0,0 +1,204 @@
+#include "CommandRecorder.h"
+
+#include "Util.h"
+
+#include <vulkan/vk_enum_string_helper.h>
+
+#include <algorithm>
+
+namespace
+{
+constexpr size_t minItemsPerChunk = 128u; // Smaller workloads are not worth waking another thread for
+} // namespace
+
+CommandRecorder::CommandRecorder(VkDevice device,
+                                 uint32_t queueFamilyIndex,
+                                 size_t framesInFlight,
+                                 size_t requestedThreadCount)
+: device(device), threadCount(std::max(requestedThreadCount, static_cast<size_t>(1u)))
+{
+  // Create a command pool with a secondary command buffer for each thread and frame in flight, so that no two threads
+  // ever record from the same pool and a frame's pools can be reset as a whole
+  commandPools.resize(framesInFlight * threadCount);
+  commandBuffers.resize(commandPools.size());
+  for (size_t poolIndex = 0u; poolIndex < commandPools.size(); ++poolIndex)
+  {
+    VkCommandPoolCreateInfo commandPoolCreateInfo{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+    commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    commandPoolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+
+    VkResult result;
+    if ((result = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPools.at(poolIndex))) !=
+        VK_SUCCESS)
+    {
+      util::error(Error::GenericVulkan, string_VkResult(result));
+      valid = false;
+      return;
+    }
+
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    commandBufferAllocateInfo.commandPool = commandPools.at(poolIndex);
+    commandBufferAllocateInfo.commandBufferCount = 1u;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    if ((result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffers.at(poolIndex))) !=
+        VK_SUCCESS)
+    {
+      util::error(Error::GenericVulkan, string_VkResult(result));
+      valid = false;
+      return;
+    }
+  }
+
+  // Start the worker threads
+  for (size_t threadIndex = 1u; threadIndex < threadCount; ++threadIndex)
+  {
+    workerThreads.emplace_back(&CommandRecorder::work, this, threadIndex);
+  }
+}
+
+CommandRecorder::~CommandRecorder()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    exitRequested = true;
+  }
+  jobCondition.notify_all();
+
+  for (std::thread& workerThread : workerThreads)
+  {
+    workerThread.join();
+  }
+
+  for (const VkCommandPool commandPool : commandPools)
+  {
+    vkDestroyCommandPool(device, commandPool, nullptr);
+  }
+}
+
+bool CommandRecorder::record(size_t frameIndex,
+                             VkRenderPass renderPass,
+                             VkFramebuffer framebuffer,
+                             const VkCommandBufferInheritanceRenderingInfoKHR* renderingInfo,
+                             size_t itemCount,
+                             size_t maxThreadCount,
+                             const RecordFunction& recordFunction,
+                             std::vector<VkCommandBuffer>& recordedCommandBuffers)
+{
+  recordedCommandBuffers.clear();
+  if (itemCount == 0u)
+  {
+    return true;
+  }
+
+  // Split the items evenly into one range per thread, but never into ranges smaller than the minimum
+  const size_t usableThreadCount = std::max(std::min(maxThreadCount, threadCount), static_cast<size_t>(1u));
+  const size_t chunkCount = std::min((itemCount + minItemsPerChunk - 1u) / minItemsPerChunk, usableThreadCount);
+
+  // Publish the job to the worker threads
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobFrameIndex = frameIndex;
+    jobItemCount = itemCount;
+    jobChunkCount = chunkCount;
+    pendingChunkCount = chunkCount - 1u;
+
+    jobInheritanceInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO };
+    jobInheritanceInfo.renderPass = renderPass;
+    jobInheritanceInfo.subpass = 0u;
+    jobInheritanceInfo.framebuffer = framebuffer;
+    jobInheritanceInfo.pNext = renderingInfo;
+
+    jobRecordFunction = &recordFunction;
+    jobFailed = false;
+    ++jobGeneration;
+  }
+
+  if (chunkCount > 1u)
+  {
+    jobCondition.notify_all();
+  }
+
+  // Record the first range on this thread and wait for the workers to finish the rest
+  const bool success = recordChunk(0u);
+
+  std::unique_lock<std::mutex> lock(mutex);
+  doneCondition.wait(lock, [this] { return pendingChunkCount == 0u; });
+  if (!success || jobFailed)
+  {
+    return false;
+  }
+
+  // The command buffers of a frame are stored next to each other, in thread order
+  const std::vector<VkCommandBuffer>::const_iterator first = commandBuffers.begin() + frameIndex * threadCount;
+  recordedCommandBuffers.assign(first, first + chunkCount);
+  return true;
+}
+
+bool CommandRecorder::isValid() const
+{
+  return valid;
+}
+
+size_t CommandRecorder::getThreadCount() const
+{
+  return threadCount;
+}
+
+void CommandRecorder::work(size_t threadIndex)
+{
+  uint64_t seenJobGeneration = 0u;
+  while (true)
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobCondition.wait(lock, [this, seenJobGeneration] { return exitRequested || jobGeneration != seenJobGeneration; });
+    if (exitRequested)
+    {
+      return;
+    }
+
+    seenJobGeneration = jobGeneration;
+    if (threadIndex >= jobChunkCount)
+    {
+      continue;
+    }
+
+    // The job stays unchanged until all of its ranges are done, so it can be read without holding the lock
+    lock.unlock();
+    const bool success = recordChunk(threadIndex);
+    lock.lock();
+
+    jobFailed = jobFailed || !success;
+    if (--pendingChunkCount == 0u)
+    {
+      doneCondition.notify_one();
+    }
+  }
+}
+
+bool CommandRecorder::recordChunk(size_t threadIndex)
+{
+  const size_t firstItem = jobItemCount * threadIndex / jobChunkCount;
+  const size_t endItem = jobItemCount * (threadIndex + 1u) / jobChunkCount;
+
+  const size_t poolIndex = jobFrameIndex * threadCount + threadIndex;
+  const VkCommandBuffer commandBuffer = commandBuffers.at(poolIndex);
+
+  // Reset the whole pool which is cheaper than resetting its command buffer on its own
+  if (vkResetCommandPool(device, commandPools.at(poolIndex), 0u) != VK_SUCCESS)
+  {
+    return false;
+  }
+
+  VkCommandBufferBeginInfo commandBufferBeginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+  commandBufferBeginInfo.flags =
+    VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  commandBufferBeginInfo.pInheritanceInfo = &jobInheritanceInfo;
+  if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
+  {
+    return false;
+  }
+
+  (*jobRecordFunction)(commandBuffer, firstItem, endItem - firstItem);
+
+  return vkEndCommandBuffer(commandBuffer) == VK_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Records ranges of draws in parallel into secondary command buffers that continue a render pass or dynamic rendering,
+// the calling thread records the first range itself and each worker thread owns one command pool per frame in flight
+class CommandRecorder final
+{
+public:
+  CommandRecorder(VkDevice device, uint32_t queueFamilyIndex, size_t framesInFlight, size_t requestedThreadCount);
+  ~CommandRecorder();
+
+  // Called once per range with the first item and the item count, has to bind all state it uses
+  using RecordFunction = std::function<void(VkCommandBuffer commandBuffer, size_t firstItem, size_t itemCount)>;
+
+  bool record(size_t frameIndex,
+              VkRenderPass renderPass,
+              VkFramebuffer framebuffer,
+              const VkCommandBufferInheritanceRenderingInfoKHR* renderingInfo, // Used without a render pass
+              size_t itemCount,
+              size_t maxThreadCount,
+              const RecordFunction& recordFunction,
+              std::vector<VkCommandBuffer>& commandBuffers);
+
+  bool isValid() const;
+  size_t getThreadCount() const;
+
+private:
+  bool valid = true;
+
+  VkDevice device = nullptr;
+  size_t threadCount = 0u;
+  std::vector<VkCommandPool> commandPools;     // One per thread and frame in flight, grouped by frame
+  std::vector<VkCommandBuffer> commandBuffers; // One secondary command buffer per command pool
+  std::vector<std::thread> workerThreads;      // The calling thread is thread zero
+
+  // The current job, guarded by the mutex
+  std::mutex mutex;
+  std::condition_variable jobCondition, doneCondition;
+  uint64_t jobGeneration = 0u;
+  bool exitRequested = false;
+  size_t jobFrameIndex = 0u, jobItemCount = 0u, jobChunkCount = 0u, pendingChunkCount = 0u;
+  VkCommandBufferInheritanceInfo jobInheritanceInfo = {};
+  const RecordFunction* jobRecordFunction = nullptr;
+  bool jobFailed = false;
+
+  void work(size_t threadIndex);
+  bool recordChunk(size_t threadIndex);
+};
\ No newline at end of file
@@ -1,9 +1,12 @@
 #include "Context.h"
 
+#include "MemoryAllocator.h"
 #include "Util.h"
 
 #include <glfw/glfw3.h>
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 #ifdef DEBUG
@@ -537,6 +540,7 @@ Context::~Context()
   xrDestroyInstance(xrInstance);
 
   // Clean up Vulkan
+  delete memoryAllocator;
   vkDestroyDevice(device, nullptr);
 
 #ifdef DEBUG
@@ -581,8 +585,9 @@ bool Context::createDevice(VkSurfaceKHR mirrorSurface)
         continue;
       }
 
-      // Check the queue family for drawing support
-      if (queueFamilyCandidate.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+      // Check the queue family for drawing support, compute is needed for culling on the same queue
+      constexpr VkQueueFlags drawQueueFlags = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT;
+      if ((queueFamilyCandidate.queueFlags & drawQueueFlags) == drawQueueFlags)
       {
         drawQueueFamilyIndex = static_cast<uint32_t>(queueFamilyIndexCandidate);
         drawQueueFamilyIndexFound = true;
@@ -642,6 +647,39 @@ bool Context::createDevice(VkSurfaceKHR mirrorSurface)
     }
   }
 
+  // Pick the transfer queue family index
+  {
+    // Retrieve the queue families
+    std::vector<VkQueueFamilyProperties> queueFamilies;
+    uint32_t queueFamilyCount = 0u;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+
+    queueFamilies.resize(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies.data());
+
+    // Fall back to the draw queue family if there is no dedicated transfer queue family
+    transferQueueFamilyIndex = drawQueueFamilyIndex;
+    for (size_t queueFamilyIndexCandidate = 0u; queueFamilyIndexCandidate < queueFamilies.size();
+         ++queueFamilyIndexCandidate)
+    {
+      const VkQueueFamilyProperties& queueFamilyCandidate = queueFamilies.at(queueFamilyIndexCandidate);
+
+      // Check that the queue family includes actual queues
+      if (queueFamilyCandidate.queueCount == 0u)
+      {
+        continue;
+      }
+
+      // Check the queue family for transfer support without graphics or compute, usually backed by a DMA engine
+      if ((queueFamilyCandidate.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+          !(queueFamilyCandidate.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+      {
+        transferQueueFamilyIndex = static_cast<uint32_t>(queueFamilyIndexCandidate);
+        break;
+      }
+    }
+  }
+
   // Get all supported Vulkan device extensions
   std::vector<VkExtensionProperties> supportedVulkanDeviceExtensions;
   {
@@ -712,6 +750,42 @@ bool Context::createDevice(VkSurfaceKHR mirrorSurface)
     }
   }
 
+  // Adds an optional extension if it is supported, returns whether it is
+  const auto addOptionalExtension = [&](const char* name)
+  {
+    if (std::none_of(supportedVulkanDeviceExtensions.begin(), supportedVulkanDeviceExtensions.end(),
+                     [name](const VkExtensionProperties& extension)
+                     { return strcmp(extension.extensionName, name) == 0; }))
+    {
+      return false;
+    }
+
+    if (std::none_of(vulkanDeviceExtensions.begin(), vulkanDeviceExtensions.end(),
+                     [name](const char* extension) { return strcmp(extension, name) == 0; }))
+    {
+      vulkanDeviceExtensions.push_back(name);
+    }
+    return true;
+  };
+
+  // Add the optional pipeline creation feedback extension to report pipeline cache hits and creation times
+  pipelineCreationFeedbackSupported = addOptionalExtension(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+
+  // Add the optional extended dynamic state extensions that turn fixed function state into command buffer state
+  extendedDynamicStateSupported = addOptionalExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_EXTENSION_NAME);
+  extendedDynamicState2Supported = addOptionalExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_2_EXTENSION_NAME);
+  extendedDynamicState3Supported = addOptionalExtension(VK_EXT_EXTENDED_DYNAMIC_STATE_3_EXTENSION_NAME);
+
+  // Add the optional graphics pipeline library extension that allows to link pipelines from precompiled parts
+  graphicsPipelineLibrarySupported = addOptionalExtension(VK_KHR_PIPELINE_LIBRARY_EXTENSION_NAME) &&
+                                     addOptionalExtension(VK_EXT_GRAPHICS_PIPELINE_LIBRARY_EXTENSION_NAME);
+
+  // Add the optional dynamic rendering extension that renders without render pass and framebuffer objects
+  dynamicRenderingSupported = addOptionalExtension(VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME);
+
+  // Add the optional synchronization2 extension that gives every barrier its own stage masks
+  synchronization2Supported = addOptionalExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+
   // Create a device
   {
     // Verify that the required physical device features are supported
@@ -727,7 +801,67 @@ bool Context::createDevice(VkSurfaceKHR mirrorSurface)
     VkPhysicalDeviceMultiviewFeatures physicalDeviceMultiviewFeatures{
       VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MULTIVIEW_FEATURES
     };
+    VkPhysicalDeviceVulkan12Features supportedPhysicalDeviceVulkan12Features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+    };
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT supportedPhysicalDeviceExtendedDynamicStateFeatures{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT
+    };
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT supportedPhysicalDeviceExtendedDynamicState2Features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT
+    };
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT supportedPhysicalDeviceExtendedDynamicState3Features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT
+    };
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT supportedPhysicalDeviceGraphicsPipelineLibraryFeatures{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT
+    };
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR supportedPhysicalDeviceDynamicRenderingFeatures{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR
+    };
+    VkPhysicalDeviceSynchronization2FeaturesKHR supportedPhysicalDeviceSynchronization2Features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR
+    };
     physicalDeviceFeatures2.pNext = &physicalDeviceMultiviewFeatures;
+    physicalDeviceMultiviewFeatures.pNext = &supportedPhysicalDeviceVulkan12Features;
+
+    // Extension features may only be queried if their extension is supported
+    void** nextFeatures = &supportedPhysicalDeviceVulkan12Features.pNext;
+    if (extendedDynamicStateSupported)
+    {
+      *nextFeatures = &supportedPhysicalDeviceExtendedDynamicStateFeatures;
+      nextFeatures = &supportedPhysicalDeviceExtendedDynamicStateFeatures.pNext;
+    }
+
+    if (extendedDynamicState2Supported)
+    {
+      *nextFeatures = &supportedPhysicalDeviceExtendedDynamicState2Features;
+      nextFeatures = &supportedPhysicalDeviceExtendedDynamicState2Features.pNext;
+    }
+
+    if (extendedDynamicState3Supported)
+    {
+      *nextFeatures = &supportedPhysicalDeviceExtendedDynamicState3Features;
+      nextFeatures = &supportedPhysicalDeviceExtendedDynamicState3Features.pNext;
+    }
+
+    if (graphicsPipelineLibrarySupported)
+    {
+      *nextFeatures = &supportedPhysicalDeviceGraphicsPipelineLibraryFeatures;
+      nextFeatures = &supportedPhysicalDeviceGraphicsPipelineLibraryFeatures.pNext;
+    }
+
+    if (dynamicRenderingSupported)
+    {
+      *nextFeatures = &supportedPhysicalDeviceDynamicRenderingFeatures;
+      nextFeatures = &supportedPhysicalDeviceDynamicRenderingFeatures.pNext;
+    }
+
+    if (synchronization2Supported)
+    {
+      *nextFeatures = &supportedPhysicalDeviceSynchronization2Features;
+    }
+
     vkGetPhysicalDeviceFeatures2(physicalDevice, &physicalDeviceFeatures2);
     if (!physicalDeviceMultiviewFeatures.multiview)
     {
@@ -735,8 +869,112 @@ bool Context::createDevice(VkSurfaceKHR mirrorSurface)
       return false;
     }
 
+    if (!supportedPhysicalDeviceVulkan12Features.timelineSemaphore)
+    {
+      util::error(Error::FeatureNotSupported, "Vulkan physical device feature \"timelineSemaphore\"");
+      return false;
+    }
+
+    // GPU-driven indirect draws are optional, the renderer falls back to culling on the CPU without them
+    drawIndirectCountSupported = supportedPhysicalDeviceVulkan12Features.drawIndirectCount &&
+                                 physicalDeviceFeatures.multiDrawIndirect &&
+                                 physicalDeviceFeatures.drawIndirectFirstInstance;
+
+    // Extended dynamic state is optional, pipelines bake whatever state is not dynamic
+    extendedDynamicStateSupported =
+      extendedDynamicStateSupported && supportedPhysicalDeviceExtendedDynamicStateFeatures.extendedDynamicState;
+    extendedDynamicState2Supported =
+      extendedDynamicState2Supported && supportedPhysicalDeviceExtendedDynamicState2Features.extendedDynamicState2;
+    extendedDynamicState3Supported =
+      extendedDynamicState3Supported &&
+      supportedPhysicalDeviceExtendedDynamicState3Features.extendedDynamicState3ColorBlendEnable;
+
+    // Graphics pipeline libraries are optional, pipelines are compiled as a whole without them
+    graphicsPipelineLibrarySupported =
+      graphicsPipelineLibrarySupported &&
+      supportedPhysicalDeviceGraphicsPipelineLibraryFeatures.graphicsPipelineLibrary;
+
+    // Dynamic rendering is optional, the headset creates a render pass and framebuffers without it
+    dynamicRenderingSupported =
+      dynamicRenderingSupported && supportedPhysicalDeviceDynamicRenderingFeatures.dynamicRendering;
+
+    // Synchronization2 is optional, render graph barriers fall back to the original barrier command without it
+    synchronization2Supported =
+      synchronization2Supported && supportedPhysicalDeviceSynchronization2Features.synchronization2;
+
+    VkPhysicalDeviceVulkan12Features physicalDeviceVulkan12Features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES
+    };
+    physicalDeviceVulkan12Features.drawIndirectCount = drawIndirectCountSupported;
+    physicalDeviceVulkan12Features.timelineSemaphore = VK_TRUE; // Needed for frame and upload synchronization
+
     //physicalDeviceFeatures.shaderStorageImageMultisample = VK_TRUE; // Needed for some OpenXR implementations
     physicalDeviceMultiviewFeatures.multiview = VK_TRUE;            // Needed for stereo rendering
+    physicalDeviceMultiviewFeatures.pNext = &physicalDeviceVulkan12Features;
+
+    VkPhysicalDeviceExtendedDynamicStateFeaturesEXT physicalDeviceExtendedDynamicStateFeatures{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_FEATURES_EXT
+    };
+    VkPhysicalDeviceExtendedDynamicState2FeaturesEXT physicalDeviceExtendedDynamicState2Features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_2_FEATURES_EXT
+    };
+    VkPhysicalDeviceExtendedDynamicState3FeaturesEXT physicalDeviceExtendedDynamicState3Features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTENDED_DYNAMIC_STATE_3_FEATURES_EXT
+    };
+    physicalDeviceExtendedDynamicStateFeatures.extendedDynamicState = VK_TRUE;   // Depth, cull and topology state
+    physicalDeviceExtendedDynamicState2Features.extendedDynamicState2 = VK_TRUE; // Primitive restart state
+    physicalDeviceExtendedDynamicState3Features.extendedDynamicState3ColorBlendEnable = VK_TRUE; // Blend state
+
+    VkPhysicalDeviceGraphicsPipelineLibraryFeaturesEXT physicalDeviceGraphicsPipelineLibraryFeatures{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT
+    };
+    physicalDeviceGraphicsPipelineLibraryFeatures.graphicsPipelineLibrary = VK_TRUE;
+
+    VkPhysicalDeviceDynamicRenderingFeaturesKHR physicalDeviceDynamicRenderingFeatures{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES_KHR
+    };
+    physicalDeviceDynamicRenderingFeatures.dynamicRendering = VK_TRUE;
+
+    VkPhysicalDeviceSynchronization2FeaturesKHR physicalDeviceSynchronization2Features{
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR
+    };
+    physicalDeviceSynchronization2Features.synchronization2 = VK_TRUE;
+
+    nextFeatures = &physicalDeviceVulkan12Features.pNext;
+    if (extendedDynamicStateSupported)
+    {
+      *nextFeatures = &physicalDeviceExtendedDynamicStateFeatures;
+      nextFeatures = &physicalDeviceExtendedDynamicStateFeatures.pNext;
+    }
+
+    if (extendedDynamicState2Supported)
+    {
+      *nextFeatures = &physicalDeviceExtendedDynamicState2Features;
+      nextFeatures = &physicalDeviceExtendedDynamicState2Features.pNext;
+    }
+
+    if (extendedDynamicState3Supported)
+    {
+      *nextFeatures = &physicalDeviceExtendedDynamicState3Features;
+      nextFeatures = &physicalDeviceExtendedDynamicState3Features.pNext;
+    }
+
+    if (graphicsPipelineLibrarySupported)
+    {
+      *nextFeatures = &physicalDeviceGraphicsPipelineLibraryFeatures;
+      nextFeatures = &physicalDeviceGraphicsPipelineLibraryFeatures.pNext;
+    }
+
+    if (dynamicRenderingSupported)
+    {
+      *nextFeatures = &physicalDeviceDynamicRenderingFeatures;
+      nextFeatures = &physicalDeviceDynamicRenderingFeatures.pNext;
+    }
+
+    if (synchronization2Supported)
+    {
+      *nextFeatures = &physicalDeviceSynchronization2Features;
+    }
 
     constexpr float queuePriority = 1.0f;
 
@@ -754,6 +992,12 @@ bool Context::createDevice(VkSurfaceKHR mirrorSurface)
       deviceQueueCreateInfos.push_back(deviceQueueCreateInfo);
     }
 
+    if (transferQueueFamilyIndex != drawQueueFamilyIndex && transferQueueFamilyIndex != presentQueueFamilyIndex)
+    {
+      deviceQueueCreateInfo.queueFamilyIndex = transferQueueFamilyIndex;
+      deviceQueueCreateInfos.push_back(deviceQueueCreateInfo);
+    }
+
     VkDeviceCreateInfo deviceCreateInfo{ VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
     deviceCreateInfo.pNext = &physicalDeviceMultiviewFeatures;
     deviceCreateInfo.enabledExtensionCount = static_cast<uint32_t>(vulkanDeviceExtensions.size());
@@ -768,6 +1012,32 @@ bool Context::createDevice(VkSurfaceKHR mirrorSurface)
     }
   }
 
+  // Load the dynamic rendering commands
+  if (dynamicRenderingSupported)
+  {
+    vkCmdBeginRenderingKHR =
+      reinterpret_cast<PFN_vkCmdBeginRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdBeginRenderingKHR"));
+    vkCmdEndRenderingKHR =
+      reinterpret_cast<PFN_vkCmdEndRenderingKHR>(vkGetDeviceProcAddr(device, "vkCmdEndRenderingKHR"));
+    if (!vkCmdBeginRenderingKHR || !vkCmdEndRenderingKHR)
+    {
+      util::error(Error::FeatureNotSupported, "Vulkan extension function \"vkCmdBeginRenderingKHR\"");
+      return false;
+    }
+  }
+
+  // Load the synchronization2 barrier command
+  if (synchronization2Supported)
+  {
+    vkCmdPipelineBarrier2KHR =
+      reinterpret_cast<PFN_vkCmdPipelineBarrier2KHR>(vkGetDeviceProcAddr(device, "vkCmdPipelineBarrier2KHR"));
+    if (!vkCmdPipelineBarrier2KHR)
+    {
+      util::error(Error::FeatureNotSupported, "Vulkan extension function \"vkCmdPipelineBarrier2KHR\"");
+      return false;
+    }
+  }
+
   // Check the graphics requirements for Vulkan
   XrGraphicsRequirementsVulkanKHR graphicsRequirements{ XR_TYPE_GRAPHICS_REQUIREMENTS_VULKAN_KHR };
   result = xrGetVulkanGraphicsRequirementsKHR(xrInstance, systemId, &graphicsRequirements);
@@ -792,6 +1062,20 @@ bool Context::createDevice(VkSurfaceKHR mirrorSurface)
     return false;
   }
 
+  vkGetDeviceQueue(device, transferQueueFamilyIndex, 0u, &transferQueue);
+  if (!transferQueue)
+  {
+    util::error(Error::GenericVulkan);
+    return false;
+  }
+
+  // Create a memory allocator
+  memoryAllocator = new MemoryAllocator(device, physicalDevice);
+  if (!memoryAllocator->isValid())
+  {
+    return false;
+  }
+
   return true;
 }
 
@@ -849,3 +1133,58 @@ VkQueue Context::getVkPresentQueue() const
 {
   return presentQueue;
 }
+
+uint32_t Context::getVkTransferQueueFamilyIndex() const
+{
+  return transferQueueFamilyIndex;
+}
+
+VkQueue Context::getVkTransferQueue() const
+{
+  return transferQueue;
+}
+
+MemoryAllocator* Context::getMemoryAllocator() const
+{
+  return memoryAllocator;
+}
+
+bool Context::isDrawIndirectCountSupported() const
+{
+  return drawIndirectCountSupported;
+}
+
+bool Context::isPipelineCreationFeedbackSupported() const
+{
+  return pipelineCreationFeedbackSupported;
+}
+
+bool Context::isExtendedDynamicStateSupported() const
+{
+  return extendedDynamicStateSupported;
+}
+
+bool Context::isExtendedDynamicState2Supported() const
+{
+  return extendedDynamicState2Supported;
+}
+
+bool Context::isExtendedDynamicState3Supported() const
+{
+  return extendedDynamicState3Supported;
+}
+
+bool Context::isGraphicsPipelineLibrarySupported() const
+{
+  return graphicsPipelineLibrarySupported;
+}
+
+bool Context::isDynamicRenderingSupported() const
+{
+  return dynamicRenderingSupported;
+}
+
+bool Context::isSynchronization2Supported() const
+{
+  return synchronization2Supported;
+}
@@ -6,6 +6,8 @@
 #include <openxr/openxr.h>
 #include <openxr/openxr_platform.h>
 
+class MemoryAllocator;
+
 class Context final
 {
 public:
@@ -27,11 +29,29 @@ public:
   VkDevice getVkDevice() const;
   VkQueue getVkDrawQueue() const;
   VkQueue getVkPresentQueue() const;
+  uint32_t getVkTransferQueueFamilyIndex() const;
+  VkQueue getVkTransferQueue() const;
+  MemoryAllocator* getMemoryAllocator() const;
+  bool isDrawIndirectCountSupported() const;
+  bool isPipelineCreationFeedbackSupported() const;
+  bool isExtendedDynamicStateSupported() const;
+  bool isExtendedDynamicState2Supported() const;
+  bool isExtendedDynamicState3Supported() const; // Only reported with dynamic color blend enable
+  bool isGraphicsPipelineLibrarySupported() const;
+  bool isDynamicRenderingSupported() const;
+  bool isSynchronization2Supported() const;
 
   PFN_xrCreateHandTrackerEXT xrCreateHandTrackerEXT = nullptr;
   PFN_xrDestroyHandTrackerEXT xrDestroyHandTrackerEXT = nullptr;
   PFN_xrLocateHandJointsEXT xrLocateHandJointsEXT = nullptr;
 
+  // Only loaded if dynamic rendering is supported
+  PFN_vkCmdBeginRenderingKHR vkCmdBeginRenderingKHR = nullptr;
+  PFN_vkCmdEndRenderingKHR vkCmdEndRenderingKHR = nullptr;
+
+  // Only loaded if synchronization2 is supported
+  PFN_vkCmdPipelineBarrier2KHR vkCmdPipelineBarrier2KHR = nullptr;
+
 private:
   bool valid = true;
 
@@ -47,9 +67,17 @@ private:
 
   VkInstance vkInstance = nullptr;
   VkPhysicalDevice physicalDevice = nullptr;
-  uint32_t drawQueueFamilyIndex = 0u, presentQueueFamilyIndex = 0u;
+  uint32_t drawQueueFamilyIndex = 0u, presentQueueFamilyIndex = 0u, transferQueueFamilyIndex = 0u;
   VkDevice device = nullptr;
-  VkQueue drawQueue = nullptr, presentQueue = nullptr;
+  VkQueue drawQueue = nullptr, presentQueue = nullptr, transferQueue = nullptr;
+  MemoryAllocator* memoryAllocator = nullptr;
+  bool drawIndirectCountSupported = false;
+  bool pipelineCreationFeedbackSupported = false;
+  bool extendedDynamicStateSupported = false, extendedDynamicState2Supported = false,
+       extendedDynamicState3Supported = false;
+  bool graphicsPipelineLibrarySupported = false;
+  bool dynamicRenderingSupported = false;
+  bool synchronization2Supported = false;
 
 #ifdef DEBUG
   PFN_xrCreateDebugUtilsMessengerEXT xrCreateDebugUtilsMessengerEXT = nullptr;
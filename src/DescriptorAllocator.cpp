@@ -0,0 +1,317 @@
+#include "DescriptorAllocator.h"
+
+#include "Util.h"
+
+#include <vulkan/vk_enum_string_helper.h>
+
+#include <algorithm>
+#include <array>
+
+namespace
+{
+constexpr uint32_t firstPoolSetCount = 16u; // Sets of the first pool in a chain, doubled for each further pool
+constexpr uint32_t maxPoolSetCount = 4096u; // Sets of a pool at most
+
+// Descriptors of each type per set in a pool, raised for sets that need more when a pool is created
+constexpr std::array<VkDescriptorPoolSize, 4u> descriptorsPerSet = {
+  { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2u },
+    { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 2u },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4u },
+    { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 2u } }
+};
+
+uint64_t hashBindings(VkDescriptorSetLayout layout, const std::vector<DescriptorAllocator::BufferBinding>& bindings,
+                      bool buffers)
+{
+  uint64_t hash = util::hashData(reinterpret_cast<const char*>(&layout), sizeof(layout));
+  const auto hashValue = [&hash](const auto& value)
+  {
+    hash = util::hashData(reinterpret_cast<const char*>(&value), sizeof(value), hash);
+  };
+
+  for (const DescriptorAllocator::BufferBinding& binding : bindings)
+  {
+    hashValue(binding.binding);
+    hashValue(binding.type);
+    if (buffers)
+    {
+      hashValue(binding.buffer);
+      hashValue(binding.offset);
+      hashValue(binding.range);
+    }
+  }
+
+  return hash;
+}
+
+bool isEqual(const DescriptorAllocator::BufferBinding& a, const DescriptorAllocator::BufferBinding& b)
+{
+  return a.binding == b.binding && a.type == b.type && a.buffer == b.buffer && a.offset == b.offset &&
+         a.range == b.range;
+}
+} // namespace
+
+DescriptorAllocator::DescriptorAllocator(VkDevice device, size_t frameCount) : device(device)
+{
+  framePools.resize(frameCount);
+}
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+  for (const std::pair<const uint64_t, UpdateTemplate>& updateTemplate : updateTemplates)
+  {
+    vkDestroyDescriptorUpdateTemplate(device, updateTemplate.second.updateTemplate, nullptr);
+  }
+
+  // Destroying the pools frees all their sets
+  for (const VkDescriptorPool pool : persistentPools.pools)
+  {
+    vkDestroyDescriptorPool(device, pool, nullptr);
+  }
+
+  for (const PoolChain& poolChain : framePools)
+  {
+    for (const VkDescriptorPool pool : poolChain.pools)
+    {
+      vkDestroyDescriptorPool(device, pool, nullptr);
+    }
+  }
+}
+
+VkDescriptorSet DescriptorAllocator::acquire(VkDescriptorSetLayout layout, const std::vector<BufferBinding>& bindings)
+{
+  const uint64_t hash = hashBindings(layout, bindings, true);
+
+  // Return an existing set
+  const auto range = cachedSets.equal_range(hash);
+  for (auto iterator = range.first; iterator != range.second; ++iterator)
+  {
+    const CachedSet& cachedSet = iterator->second;
+    if (cachedSet.layout == layout && std::equal(cachedSet.bindings.begin(), cachedSet.bindings.end(),
+                                                 bindings.begin(), bindings.end(), isEqual))
+    {
+      ++hitCount;
+      return cachedSet.descriptorSet;
+    }
+  }
+
+  // Allocate and write a new set
+  ++missCount;
+  const VkDescriptorSet descriptorSet = allocate(persistentPools, layout, bindings);
+  if (!descriptorSet || !write(descriptorSet, layout, bindings))
+  {
+    return nullptr;
+  }
+
+  cachedSets.emplace(hash, CachedSet{ layout, bindings, descriptorSet });
+  return descriptorSet;
+}
+
+VkDescriptorSet DescriptorAllocator::allocateFrameSet(size_t frameIndex,
+                                                      VkDescriptorSetLayout layout,
+                                                      const std::vector<BufferBinding>& bindings)
+{
+  const VkDescriptorSet descriptorSet = allocate(framePools.at(frameIndex), layout, bindings);
+  if (!descriptorSet || !write(descriptorSet, layout, bindings))
+  {
+    return nullptr;
+  }
+
+  return descriptorSet;
+}
+
+void DescriptorAllocator::resetFrame(size_t frameIndex)
+{
+  PoolChain& poolChain = framePools.at(frameIndex);
+  if (!poolChain.used)
+  {
+    return;
+  }
+
+  // Reset every pool sets were allocated from but keep them around, a frame usually needs as many sets as the one
+  // before
+  for (size_t poolIndex = 0u; poolIndex <= poolChain.currentPool && poolIndex < poolChain.pools.size(); ++poolIndex)
+  {
+    vkResetDescriptorPool(device, poolChain.pools.at(poolIndex), 0u);
+  }
+
+  poolChain.currentPool = 0u;
+  poolChain.used = false;
+}
+
+bool DescriptorAllocator::isValid() const
+{
+  return valid;
+}
+
+size_t DescriptorAllocator::getPoolCount() const
+{
+  size_t poolCount = persistentPools.pools.size();
+  for (const PoolChain& poolChain : framePools)
+  {
+    poolCount += poolChain.pools.size();
+  }
+  return poolCount;
+}
+
+size_t DescriptorAllocator::getHitCount() const
+{
+  return hitCount;
+}
+
+size_t DescriptorAllocator::getMissCount() const
+{
+  return missCount;
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(PoolChain& poolChain,
+                                              VkDescriptorSetLayout layout,
+                                              const std::vector<BufferBinding>& bindings)
+{
+  VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+  descriptorSetAllocateInfo.descriptorSetCount = 1u;
+  descriptorSetAllocateInfo.pSetLayouts = &layout;
+
+  // Move on to the next pool whenever the current one is full
+  while (true)
+  {
+    const bool newPool = (poolChain.currentPool == poolChain.pools.size());
+    if (newPool)
+    {
+      const uint32_t maxSets =
+        std::min(firstPoolSetCount << std::min(poolChain.pools.size(), static_cast<size_t>(8u)), maxPoolSetCount);
+
+      // Make room in each set of the pool for the usual descriptors, and for at least those of the set at hand
+      std::vector<VkDescriptorPoolSize> descriptorPoolSizes(descriptorsPerSet.begin(), descriptorsPerSet.end());
+      for (const BufferBinding& binding : bindings)
+      {
+        if (std::none_of(descriptorPoolSizes.begin(), descriptorPoolSizes.end(),
+                         [&binding](const VkDescriptorPoolSize& descriptorPoolSize)
+                         { return descriptorPoolSize.type == binding.type; }))
+        {
+          descriptorPoolSizes.push_back({ binding.type, 0u });
+        }
+      }
+
+      for (VkDescriptorPoolSize& descriptorPoolSize : descriptorPoolSizes)
+      {
+        const uint32_t descriptorCount = static_cast<uint32_t>(
+          std::count_if(bindings.begin(), bindings.end(), [&descriptorPoolSize](const BufferBinding& binding)
+                        { return binding.type == descriptorPoolSize.type; }));
+        descriptorPoolSize.descriptorCount = std::max(descriptorPoolSize.descriptorCount, descriptorCount) * maxSets;
+      }
+
+      // Create a descriptor pool
+      VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+      descriptorPoolCreateInfo.poolSizeCount = static_cast<uint32_t>(descriptorPoolSizes.size());
+      descriptorPoolCreateInfo.pPoolSizes = descriptorPoolSizes.data();
+      descriptorPoolCreateInfo.maxSets = maxSets;
+
+      VkDescriptorPool pool;
+      const VkResult result = vkCreateDescriptorPool(device, &descriptorPoolCreateInfo, nullptr, &pool);
+      if (result != VK_SUCCESS)
+      {
+        util::error(Error::GenericVulkan, string_VkResult(result));
+        valid = false;
+        return nullptr;
+      }
+
+      poolChain.pools.push_back(pool);
+    }
+
+    descriptorSetAllocateInfo.descriptorPool = poolChain.pools.at(poolChain.currentPool);
+
+    VkDescriptorSet descriptorSet;
+    const VkResult result = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet);
+    if (result == VK_SUCCESS)
+    {
+      poolChain.used = true;
+      return descriptorSet;
+    }
+    else if (newPool || (result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL))
+    {
+      // A set that does not fit into an empty pool never will
+      util::error(Error::GenericVulkan, string_VkResult(result));
+      valid = false;
+      return nullptr;
+    }
+
+    ++poolChain.currentPool;
+  }
+}
+
+bool DescriptorAllocator::write(VkDescriptorSet descriptorSet,
+                                VkDescriptorSetLayout layout,
+                                const std::vector<BufferBinding>& bindings)
+{
+  const VkDescriptorUpdateTemplate updateTemplate = getUpdateTemplate(layout, bindings);
+  if (!updateTemplate)
+  {
+    return false;
+  }
+
+  // Lay out the buffer infos the way the update template expects them
+  std::vector<VkDescriptorBufferInfo> descriptorBufferInfos(bindings.size());
+  for (size_t bindingIndex = 0u; bindingIndex < bindings.size(); ++bindingIndex)
+  {
+    const BufferBinding& binding = bindings.at(bindingIndex);
+    descriptorBufferInfos.at(bindingIndex) = { binding.buffer, binding.offset, binding.range };
+  }
+
+  vkUpdateDescriptorSetWithTemplate(device, descriptorSet, updateTemplate, descriptorBufferInfos.data());
+  return true;
+}
+
+VkDescriptorUpdateTemplate DescriptorAllocator::getUpdateTemplate(VkDescriptorSetLayout layout,
+                                                                  const std::vector<BufferBinding>& bindings)
+{
+  const uint64_t hash = hashBindings(layout, bindings, false);
+
+  // Return an existing template
+  const auto range = updateTemplates.equal_range(hash);
+  for (auto iterator = range.first; iterator != range.second; ++iterator)
+  {
+    const UpdateTemplate& updateTemplate = iterator->second;
+    if (updateTemplate.layout == layout &&
+        std::equal(updateTemplate.entries.begin(), updateTemplate.entries.end(), bindings.begin(), bindings.end(),
+                   [](const VkDescriptorUpdateTemplateEntry& entry, const BufferBinding& binding)
+                   { return entry.dstBinding == binding.binding && entry.descriptorType == binding.type; }))
+    {
+      return updateTemplate.updateTemplate;
+    }
+  }
+
+  std::vector<VkDescriptorUpdateTemplateEntry> entries(bindings.size());
+  for (size_t bindingIndex = 0u; bindingIndex < bindings.size(); ++bindingIndex)
+  {
+    VkDescriptorUpdateTemplateEntry& entry = entries.at(bindingIndex);
+    entry.dstBinding = bindings.at(bindingIndex).binding;
+    entry.dstArrayElement = 0u;
+    entry.descriptorCount = 1u;
+    entry.descriptorType = bindings.at(bindingIndex).type;
+    entry.offset = bindingIndex * sizeof(VkDescriptorBufferInfo);
+    entry.stride = sizeof(VkDescriptorBufferInfo);
+  }
+
+  // Create a descriptor update template
+  VkDescriptorUpdateTemplateCreateInfo descriptorUpdateTemplateCreateInfo{
+    VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO
+  };
+  descriptorUpdateTemplateCreateInfo.descriptorUpdateEntryCount = static_cast<uint32_t>(entries.size());
+  descriptorUpdateTemplateCreateInfo.pDescriptorUpdateEntries = entries.data();
+  descriptorUpdateTemplateCreateInfo.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+  descriptorUpdateTemplateCreateInfo.descriptorSetLayout = layout;
+
+  VkDescriptorUpdateTemplate updateTemplate;
+  const VkResult result =
+    vkCreateDescriptorUpdateTemplate(device, &descriptorUpdateTemplateCreateInfo, nullptr, &updateTemplate);
+  if (result != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan, string_VkResult(result));
+    valid = false;
+    return nullptr;
+  }
+
+  updateTemplates.emplace(hash, UpdateTemplate{ layout, entries, updateTemplate });
+  return updateTemplate;
+}
\ No newline at end of file
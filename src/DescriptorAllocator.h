@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <unordered_map>
+#include <vector>
+
+// Allocates descriptor sets from pools that grow on demand. Sets that live as long as their buffers are cached by
+// layout and bindings, sets that only live for one frame come from per-frame pools that are reset as a whole. Only
+// used from the thread that records the frames
+class DescriptorAllocator final
+{
+public:
+  DescriptorAllocator(VkDevice device, size_t frameCount);
+  ~DescriptorAllocator();
+
+  // A buffer bound to a set, all bindings of a set are written at once with a cached update template
+  struct BufferBinding final
+  {
+    uint32_t binding;
+    VkDescriptorType type;
+    VkBuffer buffer;
+    VkDeviceSize offset, range;
+  };
+
+  // Returns the same set for the same layout and bindings, never freed before the allocator is destroyed. The
+  // bindings have to cover all bindings of the layout
+  VkDescriptorSet acquire(VkDescriptorSetLayout layout, const std::vector<BufferBinding>& bindings);
+
+  // Returns a new set that is valid until the frame is reset, the bindings have to cover all bindings of the layout
+  VkDescriptorSet allocateFrameSet(size_t frameIndex,
+                                   VkDescriptorSetLayout layout,
+                                   const std::vector<BufferBinding>& bindings);
+  void resetFrame(size_t frameIndex); // Only once the GPU is done with the frame
+
+  bool isValid() const;
+  size_t getPoolCount() const;
+  size_t getHitCount() const;
+  size_t getMissCount() const;
+
+private:
+  // Pools that are only reset as a whole, each new pool holds twice the sets of the one before
+  struct PoolChain final
+  {
+    std::vector<VkDescriptorPool> pools;
+    size_t currentPool = 0u; // The pools before it are full
+    bool used = false;       // Sets have been allocated since the last reset
+  };
+
+  struct CachedSet final
+  {
+    VkDescriptorSetLayout layout;
+    std::vector<BufferBinding> bindings;
+    VkDescriptorSet descriptorSet;
+  };
+
+  struct UpdateTemplate final
+  {
+    VkDescriptorSetLayout layout;
+    std::vector<VkDescriptorUpdateTemplateEntry> entries; // One per binding, in the order of the bindings
+    VkDescriptorUpdateTemplate updateTemplate;
+  };
+
+  bool valid = true;
+
+  VkDevice device = nullptr;
+  PoolChain persistentPools;
+  std::vector<PoolChain> framePools;
+  std::unordered_multimap<uint64_t, CachedSet> cachedSets;           // By layout and bindings hash
+  std::unordered_multimap<uint64_t, UpdateTemplate> updateTemplates; // By layout, binding and type hash
+  size_t hitCount = 0u, missCount = 0u;
+
+  VkDescriptorSet allocate(PoolChain& poolChain,
+                           VkDescriptorSetLayout layout,
+                           const std::vector<BufferBinding>& bindings);
+  bool write(VkDescriptorSet descriptorSet, VkDescriptorSetLayout layout, const std::vector<BufferBinding>& bindings);
+  VkDescriptorUpdateTemplate getUpdateTemplate(VkDescriptorSetLayout layout,
+                                               const std::vector<BufferBinding>& bindings);
+};
\ No newline at end of file
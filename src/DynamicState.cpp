@@ -0,0 +1,177 @@
+#include "DynamicState.h"
+
+namespace
+{
+// Pipelines with dynamic topology only need to agree on the topology class, this picks a representative for it
+VkPrimitiveTopology getTopologyClass(VkPrimitiveTopology topology)
+{
+  switch (topology)
+  {
+  case VK_PRIMITIVE_TOPOLOGY_POINT_LIST:
+    return VK_PRIMITIVE_TOPOLOGY_POINT_LIST;
+  case VK_PRIMITIVE_TOPOLOGY_LINE_LIST:
+  case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP:
+  case VK_PRIMITIVE_TOPOLOGY_LINE_LIST_WITH_ADJACENCY:
+  case VK_PRIMITIVE_TOPOLOGY_LINE_STRIP_WITH_ADJACENCY:
+    return VK_PRIMITIVE_TOPOLOGY_LINE_LIST;
+  case VK_PRIMITIVE_TOPOLOGY_PATCH_LIST:
+    return VK_PRIMITIVE_TOPOLOGY_PATCH_LIST;
+  default:
+    return VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  }
+}
+} // namespace
+
+DynamicState::DynamicState(VkDevice device,
+                           bool extendedDynamicState,
+                           bool extendedDynamicState2,
+                           bool extendedDynamicState3)
+: extendedDynamicState(extendedDynamicState),
+  extendedDynamicState2(extendedDynamicState2),
+  extendedDynamicState3(extendedDynamicState3)
+{
+  // Viewport and scissor are always dynamic
+  dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+  if (extendedDynamicState)
+  {
+    vkCmdSetPrimitiveTopologyEXT =
+      reinterpret_cast<PFN_vkCmdSetPrimitiveTopologyEXT>(vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveTopologyEXT"));
+    vkCmdSetCullModeEXT = reinterpret_cast<PFN_vkCmdSetCullModeEXT>(vkGetDeviceProcAddr(device, "vkCmdSetCullModeEXT"));
+    vkCmdSetFrontFaceEXT =
+      reinterpret_cast<PFN_vkCmdSetFrontFaceEXT>(vkGetDeviceProcAddr(device, "vkCmdSetFrontFaceEXT"));
+    vkCmdSetDepthTestEnableEXT =
+      reinterpret_cast<PFN_vkCmdSetDepthTestEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthTestEnableEXT"));
+    vkCmdSetDepthWriteEnableEXT =
+      reinterpret_cast<PFN_vkCmdSetDepthWriteEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthWriteEnableEXT"));
+    vkCmdSetDepthCompareOpEXT =
+      reinterpret_cast<PFN_vkCmdSetDepthCompareOpEXT>(vkGetDeviceProcAddr(device, "vkCmdSetDepthCompareOpEXT"));
+
+    dynamicStates.insert(dynamicStates.end(),
+                         { VK_DYNAMIC_STATE_PRIMITIVE_TOPOLOGY_EXT, VK_DYNAMIC_STATE_CULL_MODE_EXT,
+                           VK_DYNAMIC_STATE_FRONT_FACE_EXT, VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE_EXT,
+                           VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE_EXT, VK_DYNAMIC_STATE_DEPTH_COMPARE_OP_EXT });
+  }
+
+  if (extendedDynamicState2)
+  {
+    vkCmdSetPrimitiveRestartEnableEXT = reinterpret_cast<PFN_vkCmdSetPrimitiveRestartEnableEXT>(
+      vkGetDeviceProcAddr(device, "vkCmdSetPrimitiveRestartEnableEXT"));
+
+    dynamicStates.push_back(VK_DYNAMIC_STATE_PRIMITIVE_RESTART_ENABLE_EXT);
+  }
+
+  if (extendedDynamicState3)
+  {
+    vkCmdSetColorBlendEnableEXT =
+      reinterpret_cast<PFN_vkCmdSetColorBlendEnableEXT>(vkGetDeviceProcAddr(device, "vkCmdSetColorBlendEnableEXT"));
+
+    dynamicStates.push_back(VK_DYNAMIC_STATE_COLOR_BLEND_ENABLE_EXT);
+  }
+}
+
+const std::vector<VkDynamicState>& DynamicState::getDynamicStates() const
+{
+  return dynamicStates;
+}
+
+RenderState DynamicState::getPipelineState(const RenderState& renderState) const
+{
+  // Reset every dynamic part to its default so that render states that only differ in those share a pipeline
+  const RenderState defaultState;
+  RenderState pipelineState = renderState;
+  if (extendedDynamicState)
+  {
+    pipelineState.topology = getTopologyClass(renderState.topology);
+    pipelineState.cullMode = defaultState.cullMode;
+    pipelineState.frontFace = defaultState.frontFace;
+    pipelineState.depthTest = defaultState.depthTest;
+    pipelineState.depthWrite = defaultState.depthWrite;
+    pipelineState.depthCompareOp = defaultState.depthCompareOp;
+  }
+
+  if (extendedDynamicState2)
+  {
+    pipelineState.primitiveRestart = defaultState.primitiveRestart;
+  }
+
+  if (extendedDynamicState3)
+  {
+    pipelineState.blend = defaultState.blend;
+  }
+
+  return pipelineState;
+}
+
+bool DynamicState::isExtendedDynamicState() const
+{
+  return extendedDynamicState;
+}
+
+bool DynamicState::isExtendedDynamicState2() const
+{
+  return extendedDynamicState2;
+}
+
+bool DynamicState::isExtendedDynamicState3() const
+{
+  return extendedDynamicState3;
+}
+
+StateTracker::StateTracker(const DynamicState* dynamicState) : dynamicState(dynamicState) {}
+
+void StateTracker::apply(VkCommandBuffer commandBuffer, const RenderState& renderState)
+{
+  if (dynamicState->isExtendedDynamicState())
+  {
+    if (needsSet(currentState.topology != renderState.topology))
+    {
+      dynamicState->vkCmdSetPrimitiveTopologyEXT(commandBuffer, renderState.topology);
+    }
+
+    if (needsSet(currentState.cullMode != renderState.cullMode))
+    {
+      dynamicState->vkCmdSetCullModeEXT(commandBuffer, renderState.cullMode);
+    }
+
+    if (needsSet(currentState.frontFace != renderState.frontFace))
+    {
+      dynamicState->vkCmdSetFrontFaceEXT(commandBuffer, renderState.frontFace);
+    }
+
+    if (needsSet(currentState.depthTest != renderState.depthTest))
+    {
+      dynamicState->vkCmdSetDepthTestEnableEXT(commandBuffer, renderState.depthTest ? VK_TRUE : VK_FALSE);
+    }
+
+    if (needsSet(currentState.depthWrite != renderState.depthWrite))
+    {
+      dynamicState->vkCmdSetDepthWriteEnableEXT(commandBuffer, renderState.depthWrite ? VK_TRUE : VK_FALSE);
+    }
+
+    if (needsSet(currentState.depthCompareOp != renderState.depthCompareOp))
+    {
+      dynamicState->vkCmdSetDepthCompareOpEXT(commandBuffer, renderState.depthCompareOp);
+    }
+  }
+
+  if (dynamicState->isExtendedDynamicState2() &&
+      needsSet(currentState.primitiveRestart != renderState.primitiveRestart))
+  {
+    dynamicState->vkCmdSetPrimitiveRestartEnableEXT(commandBuffer, renderState.primitiveRestart ? VK_TRUE : VK_FALSE);
+  }
+
+  if (dynamicState->isExtendedDynamicState3() && needsSet(currentState.blend != renderState.blend))
+  {
+    const VkBool32 blendEnable = renderState.blend ? VK_TRUE : VK_FALSE;
+    dynamicState->vkCmdSetColorBlendEnableEXT(commandBuffer, 0u, 1u, &blendEnable);
+  }
+
+  currentState = renderState;
+  currentStateKnown = true;
+}
+
+bool StateTracker::needsSet(bool changed) const
+{
+  return changed || !currentStateKnown;
+}
\ No newline at end of file
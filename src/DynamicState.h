@@ -0,0 +1,64 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+// The fixed function state that materials differ in, parts that are dynamic on the device are set on the command
+// buffer instead of being baked into pipelines
+struct RenderState final
+{
+  VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  VkCullModeFlags cullMode = VK_CULL_MODE_NONE;
+  VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+  bool depthTest = true, depthWrite = true;
+  VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+  bool primitiveRestart = false;
+  bool blend = true;
+
+  bool operator==(const RenderState& other) const = default;
+};
+
+// Knows which parts of the render state are dynamic thanks to the extended dynamic state extensions
+class DynamicState final
+{
+public:
+  DynamicState(VkDevice device, bool extendedDynamicState, bool extendedDynamicState2, bool extendedDynamicState3);
+
+  const std::vector<VkDynamicState>& getDynamicStates() const; // For graphics pipeline creation
+  RenderState getPipelineState(const RenderState& renderState) const; // The part that has to be baked into a pipeline
+
+  bool isExtendedDynamicState() const;
+  bool isExtendedDynamicState2() const;
+  bool isExtendedDynamicState3() const;
+
+  // Extension function pointers, only loaded if the respective extension is enabled
+  PFN_vkCmdSetPrimitiveTopologyEXT vkCmdSetPrimitiveTopologyEXT = nullptr;
+  PFN_vkCmdSetCullModeEXT vkCmdSetCullModeEXT = nullptr;
+  PFN_vkCmdSetFrontFaceEXT vkCmdSetFrontFaceEXT = nullptr;
+  PFN_vkCmdSetDepthTestEnableEXT vkCmdSetDepthTestEnableEXT = nullptr;
+  PFN_vkCmdSetDepthWriteEnableEXT vkCmdSetDepthWriteEnableEXT = nullptr;
+  PFN_vkCmdSetDepthCompareOpEXT vkCmdSetDepthCompareOpEXT = nullptr;
+  PFN_vkCmdSetPrimitiveRestartEnableEXT vkCmdSetPrimitiveRestartEnableEXT = nullptr;
+  PFN_vkCmdSetColorBlendEnableEXT vkCmdSetColorBlendEnableEXT = nullptr;
+
+private:
+  bool extendedDynamicState = false, extendedDynamicState2 = false, extendedDynamicState3 = false;
+  std::vector<VkDynamicState> dynamicStates;
+};
+
+// Sets the dynamic parts of render states on a single command buffer and skips calls that would not change anything
+class StateTracker final
+{
+public:
+  StateTracker(const DynamicState* dynamicState);
+
+  void apply(VkCommandBuffer commandBuffer, const RenderState& renderState);
+
+private:
+  const DynamicState* dynamicState = nullptr;
+  RenderState currentState;
+  bool currentStateKnown = false; // A new command buffer starts with undefined dynamic state
+
+  bool needsSet(bool changed) const;
+};
\ No newline at end of file
@@ -0,0 +1,69 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+constexpr float meanGain = 1.0f / 8.0f;      // Weight of a new frame in the smoothed mean of the render cost
+constexpr float deviationGain = 1.0f / 4.0f; // Weight of a new frame in the smoothed deviation of the render cost
+constexpr float deviationFactor = 4.0f;      // Deviations of the render cost that are kept as a safety margin
+constexpr float fixedMargin = 0.001f;        // Seconds kept for the compositor and scheduling jitter
+constexpr size_t rampFrameCount = 90u;       // Rendered frames until the full delay is reached after a late frame
+} // namespace
+
+FrameScheduler::FrameScheduler(bool delayFrames) : delayFrames(delayFrames)
+{
+}
+
+void FrameScheduler::addFrameTime(float cpuTime, float gpuTime)
+{
+  // The GPU only starts once the CPU submitted the frame
+  const float cost = cpuTime + gpuTime;
+  if (!measured)
+  {
+    costMean = cost;
+    costDeviation = cost / 2.0f;
+    measured = true;
+  }
+  else
+  {
+    costDeviation += deviationGain * (std::abs(cost - costMean) - costDeviation);
+    costMean += meanGain * (cost - costMean);
+  }
+
+  delayScale = std::min(delayScale + 1.0f / static_cast<float>(rampFrameCount), 1.0f);
+}
+
+void FrameScheduler::addLateFrame()
+{
+  delayScale = 0.0f;
+}
+
+void FrameScheduler::scheduleFrame(float displayPeriod)
+{
+  // Start right away until the render cost is known
+  if (!measured)
+  {
+    delay = slack = 0.0f;
+    return;
+  }
+
+  delay = delayFrames ? std::clamp(displayPeriod - getRenderCost(), 0.0f, displayPeriod) * delayScale : 0.0f;
+  slack = displayPeriod - delay - costMean;
+}
+
+float FrameScheduler::getRenderCost() const
+{
+  return costMean + deviationFactor * costDeviation + fixedMargin;
+}
+
+float FrameScheduler::getDelay() const
+{
+  return delay;
+}
+
+float FrameScheduler::getSlack() const
+{
+  return slack;
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+// Delays the start of each frame to the latest moment that still leaves enough time to render it before it is
+// displayed, so that the views and input are sampled as late as possible. The render cost is estimated from the CPU
+// and GPU times of recent frames as a smoothed mean plus a multiple of their smoothed deviation. A late frame drops
+// the delay to zero, from where it ramps up again over a number of frames. Only used from one thread at a time
+class FrameScheduler final
+{
+public:
+  FrameScheduler(bool delayFrames); // Only estimates the slack without delaying the frames if false
+
+  void addFrameTime(float cpuTime, float gpuTime); // In seconds, of a rendered frame
+  void addLateFrame();
+
+  // Chooses the delay of the next frame from its display period, both in seconds
+  void scheduleFrame(float displayPeriod);
+
+  float getRenderCost() const; // In seconds, estimated with the safety margin
+  float getDelay() const;      // In seconds, from waiting for the frame until beginning it
+  float getSlack() const;      // In seconds, left in the display period by the average render cost after the delay
+
+private:
+  bool delayFrames = false;
+  bool measured = false;
+  float costMean = 0.0f, costDeviation = 0.0f;
+  float delayScale = 0.0f; // Ramps from zero to one after a late frame
+  float delay = 0.0f, slack = 0.0f;
+};
\ No newline at end of file
@@ -1,29 +1,31 @@
 #include "Headset.h"
 
 #include "Context.h"
+#include "ImageViewCache.h"
+#include "InputSampler.h"
 #include "RenderTarget.h"
 #include "Util.h"
 
 #include <array>
-#include <sstream>
 
 namespace
 {
 constexpr XrReferenceSpaceType spaceType = XR_REFERENCE_SPACE_TYPE_STAGE;
 constexpr VkFormat colorFormat = VK_FORMAT_R8G8B8A8_UNORM;
 constexpr VkFormat depthFormat = VK_FORMAT_D32_SFLOAT;
+constexpr uint32_t viewMask = 0b00000011; // Both eyes are rendered at once with multiview
 } // namespace
 
 static XrPosef identity_pose = {.orientation = {.x = 0, .y = 0, .z = 0, .w = 1.0},
                                 .position = {.x = 0, .y = 0, .z = 0}};
 
-Headset::Headset(const Context* context) : context(context)
+Headset::Headset(const Context* context, float inputRate) : context(context)
 {
   const VkDevice device = context->getVkDevice();
 
-  // Create a render pass
+  // Create a render pass, dynamic rendering describes the attachments when it begins rendering instead
+  if (!context->isDynamicRenderingSupported())
   {
-    constexpr uint32_t viewMask = 0b00000011;
     constexpr uint32_t correlationMask = 0b00000011;
 
     VkRenderPassMultiviewCreateInfo renderPassMultiviewCreateInfo{
@@ -41,7 +43,7 @@ Headset::Headset(const Context* context) : context(context)
     colorAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     colorAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     colorAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    colorAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; // Set by the render graph
     colorAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference colorAttachmentReference;
@@ -55,7 +57,7 @@ Headset::Headset(const Context* context) : context(context)
     depthAttachmentDescription.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
     depthAttachmentDescription.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
     depthAttachmentDescription.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-    depthAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    depthAttachmentDescription.initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL; // Likewise
     depthAttachmentDescription.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
     VkAttachmentReference depthAttachmentReference;
@@ -198,7 +200,11 @@ Headset::Headset(const Context* context) : context(context)
 
   const VkExtent2D eyeResolution = getEyeResolution(0u);
 
-  // Create a depth buffer
+  // Create an image view cache for the attachments
+  imageViewCache = new ImageViewCache(device);
+
+  // Create a depth buffer for the framebuffers, with dynamic rendering the renderer's render graph owns it instead
+  if (renderPass)
   {
     // Create an image
     VkImageCreateInfo imageCreateInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
@@ -224,44 +230,14 @@ Headset::Headset(const Context* context) : context(context)
     VkMemoryRequirements memoryRequirements;
     vkGetImageMemoryRequirements(device, depthImage, &memoryRequirements);
 
-    VkPhysicalDeviceMemoryProperties supportedMemoryProperties;
-    vkGetPhysicalDeviceMemoryProperties(vkPhysicalDevice, &supportedMemoryProperties);
-
-    const VkMemoryPropertyFlags memoryProperties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
-    const VkMemoryPropertyFlags typeFilter = memoryRequirements.memoryTypeBits;
-    uint32_t memoryTypeIndex = 0u;
-    bool memoryTypeFound = false;
-    for (uint32_t i = 0u; i < supportedMemoryProperties.memoryTypeCount; ++i)
-    {
-      const VkMemoryPropertyFlags propertyFlags = supportedMemoryProperties.memoryTypes[i].propertyFlags;
-      if (typeFilter & (1 << i) && (propertyFlags & memoryProperties) == memoryProperties)
-      {
-        memoryTypeIndex = i;
-        memoryTypeFound = true;
-        break;
-      }
-    }
-
-    if (!memoryTypeFound)
-    {
-      util::error(Error::FeatureNotSupported, "Suitable depth buffer memory type");
-      valid = false;
-      return;
-    }
-
-    VkMemoryAllocateInfo memoryAllocateInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
-    memoryAllocateInfo.allocationSize = memoryRequirements.size;
-    memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
-    if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &depthMemory) != VK_SUCCESS)
+    if (!context->getMemoryAllocator()->allocate(memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true,
+                                                 MemoryAllocator::Strategy::Buddy, depthMemory))
     {
-      std::stringstream s;
-      s << memoryRequirements.size << " bytes for depth buffer";
-      util::error(Error::OutOfMemory, s.str());
       valid = false;
       return;
     }
 
-    if (vkBindImageMemory(device, depthImage, depthMemory, 0) != VK_SUCCESS)
+    if (vkBindImageMemory(device, depthImage, depthMemory.memory, depthMemory.offset) != VK_SUCCESS)
     {
       util::error(Error::GenericVulkan);
       valid = false;
@@ -269,20 +245,9 @@ Headset::Headset(const Context* context) : context(context)
     }
 
     // Create an image view
-    VkImageViewCreateInfo imageViewCreateInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-    imageViewCreateInfo.image = depthImage;
-    imageViewCreateInfo.format = depthFormat;
-    imageViewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
-    imageViewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
-                                       VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
-    imageViewCreateInfo.subresourceRange.layerCount = 2u;
-    imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-    imageViewCreateInfo.subresourceRange.baseArrayLayer = 0u;
-    imageViewCreateInfo.subresourceRange.baseMipLevel = 0u;
-    imageViewCreateInfo.subresourceRange.levelCount = 1u;
-    if (vkCreateImageView(device, &imageViewCreateInfo, nullptr, &depthImageView) != VK_SUCCESS)
+    depthImageView = imageViewCache->get(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 2u);
+    if (!depthImageView)
     {
-      util::error(Error::GenericVulkan);
       valid = false;
       return;
     }
@@ -345,7 +310,14 @@ Headset::Headset(const Context* context) : context(context)
       RenderTarget*& renderTarget = swapchainRenderTargets.at(renderTargetIndex);
 
       const VkImage image = swapchainImages.at(renderTargetIndex).image;
-      renderTarget = new RenderTarget(device, image, depthImageView, eyeResolution, colorFormat, renderPass, 2u);
+      const VkImageView imageView = imageViewCache->get(image, colorFormat, VK_IMAGE_ASPECT_COLOR_BIT, 2u);
+      if (!imageView)
+      {
+        valid = false;
+        return;
+      }
+
+      renderTarget = new RenderTarget(device, image, imageView, depthImageView, eyeResolution, renderPass);
       if (!renderTarget->isValid())
       {
         valid = false;
@@ -634,10 +606,16 @@ Headset::Headset(const Context* context) : context(context)
   rightLocations.next = &rightVelocities;
   rightLocations.jointCount = XR_HAND_JOINT_COUNT_EXT;
   rightLocations.jointLocations = rightJointLocations;
+
+  // Start sampling the input, which waits for the first frame to know the display time to locate the poses at
+  inputSampler = new InputSampler([this](InputSnapshot& snapshot) { return sampleInput(snapshot); }, inputRate);
 }
 
 Headset::~Headset()
 {
+  // Stop sampling the input before the actions and spaces go away
+  delete inputSampler;
+
   // Clean up OpenXR
   xrEndSession(session);
   xrDestroySwapchain(swapchain);
@@ -652,13 +630,13 @@ Headset::~Headset()
 
   // Clean up Vulkan
   const VkDevice vkDevice = context->getVkDevice();
-  vkDestroyImageView(vkDevice, depthImageView, nullptr);
-  vkFreeMemory(vkDevice, depthMemory, nullptr);
+  delete imageViewCache;
   vkDestroyImage(vkDevice, depthImage, nullptr);
+  context->getMemoryAllocator()->free(depthMemory);
   vkDestroyRenderPass(vkDevice, renderPass, nullptr);
 }
 
-Headset::BeginFrameResult Headset::beginFrame(uint32_t& swapchainImageIndex)
+bool Headset::pollEvents()
 {
   const XrInstance instance = context->getXrInstance();
 
@@ -671,7 +649,7 @@ Headset::BeginFrameResult Headset::beginFrame(uint32_t& swapchainImageIndex)
     {
     case XR_TYPE_EVENT_DATA_INSTANCE_LOSS_PENDING:
       exitRequested = true;
-      return BeginFrameResult::SkipFully;
+      return true;
     case XR_TYPE_EVENT_DATA_SESSION_STATE_CHANGED:
     {
       XrEventDataSessionStateChanged* event = reinterpret_cast<XrEventDataSessionStateChanged*>(&buffer);
@@ -681,20 +659,20 @@ Headset::BeginFrameResult Headset::beginFrame(uint32_t& swapchainImageIndex)
       {
         if (!beginSession())
         {
-          return BeginFrameResult::Error;
+          return false;
         }
       }
       else if (event->state == XR_SESSION_STATE_STOPPING)
       {
         if (!endSession())
         {
-          return BeginFrameResult::Error;
+          return false;
         }
       }
       else if (event->state == XR_SESSION_STATE_LOSS_PENDING || event->state == XR_SESSION_STATE_EXITING)
       {
         exitRequested = true;
-        return BeginFrameResult::SkipFully;
+        return true;
       }
 
       break;
@@ -702,59 +680,106 @@ Headset::BeginFrameResult Headset::beginFrame(uint32_t& swapchainImageIndex)
     }
   }
 
-  if (sessionState != XR_SESSION_STATE_READY && sessionState != XR_SESSION_STATE_SYNCHRONIZED &&
-      sessionState != XR_SESSION_STATE_VISIBLE && sessionState != XR_SESSION_STATE_FOCUSED)
+  return true;
+}
+
+Headset::BeginFrameResult Headset::waitFrame()
+{
+  if (!isSessionRunning())
   {
     // If we are not ready, synchronized, visible or focused, we skip all processing of this frame
     // This means no waiting, no beginning or ending of the frame at all
     return BeginFrameResult::SkipFully;
   }
 
-  // Wait for the new frame
-  frameState.type = XR_TYPE_FRAME_STATE;
+  // Wait for the new frame, into its own frame state as the previous frame may still be ended with the current one
+  waitedFrameState.type = XR_TYPE_FRAME_STATE;
   XrFrameWaitInfo frameWaitInfo{ XR_TYPE_FRAME_WAIT_INFO };
-  XrResult result = xrWaitFrame(session, &frameWaitInfo, &frameState);
+  const XrResult result = xrWaitFrame(session, &frameWaitInfo, &waitedFrameState);
   if (XR_FAILED(result))
   {
     util::error(Error::GenericOpenXR);
     return BeginFrameResult::Error;
   }
 
+  return BeginFrameResult::RenderFully;
+}
+
+Headset::BeginFrameResult Headset::beginFrame(uint32_t& swapchainImageIndex)
+{
   // Begin the new frame
   XrFrameBeginInfo frameBeginInfo{ XR_TYPE_FRAME_BEGIN_INFO };
-  result = xrBeginFrame(session, &frameBeginInfo);
+  XrResult result = xrBeginFrame(session, &frameBeginInfo);
   if (XR_FAILED(result))
   {
     util::error(Error::GenericOpenXR);
     return BeginFrameResult::Error;
   }
 
+  frameState = waitedFrameState;
+
   if (!frameState.shouldRender)
   {
-    // Let the host know that we don't want to render this frame
-    // We do still need to end the frame however
-    //return BeginFrameResult::SkipRender;
+    // Skip all GPU work while the frame is not visible, it still needs to be ended however, and there is no input
+    // worth sampling either
+    inputTime = 0;
+    return BeginFrameResult::SkipRender;
   }
 
   // Update the eye poses
+  if (!locateViews())
+  {
+    return BeginFrameResult::Error;
+  }
+
+  // Acquire the swapchain image
+  XrSwapchainImageAcquireInfo swapchainImageAcquireInfo{ XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
+  result = xrAcquireSwapchainImage(swapchain, &swapchainImageAcquireInfo, &swapchainImageIndex);
+  if (XR_FAILED(result))
+  {
+    util::error(Error::GenericOpenXR);
+    return BeginFrameResult::Error;
+  }
+  swapchainImageAcquired = true;
+
+  // Wait for the swapchain image
+  XrSwapchainImageWaitInfo swapchainImageWaitInfo{ XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
+  swapchainImageWaitInfo.timeout = XR_INFINITE_DURATION;
+  result = xrWaitSwapchainImage(swapchain, &swapchainImageWaitInfo);
+  if (XR_FAILED(result))
+  {
+    util::error(Error::GenericOpenXR);
+    return BeginFrameResult::Error;
+  }
+
+  // Let the input sampler locate the input at the display time of this frame from now on
+  inputTime = frameState.predictedDisplayTime;
+  inputSampler->wake();
+
+  return BeginFrameResult::RenderFully; // Request full rendering of the frame
+}
+
+bool Headset::locateViews()
+{
+  // Locate the eyes at the display time of the frame in progress
   viewState.type = XR_TYPE_VIEW_STATE;
   uint32_t viewCount;
   XrViewLocateInfo viewLocateInfo{ XR_TYPE_VIEW_LOCATE_INFO };
   viewLocateInfo.viewConfigurationType = context->getXrViewType();
   viewLocateInfo.displayTime = frameState.predictedDisplayTime;
   viewLocateInfo.space = space;
-  result = xrLocateViews(session, &viewLocateInfo, &viewState, static_cast<uint32_t>(eyePoses.size()), &viewCount,
-                         eyePoses.data());
+  const XrResult result = xrLocateViews(session, &viewLocateInfo, &viewState,
+                                        static_cast<uint32_t>(eyePoses.size()), &viewCount, eyePoses.data());
   if (XR_FAILED(result))
   {
     util::error(Error::GenericOpenXR);
-    return BeginFrameResult::Error;
+    return false;
   }
 
   if (viewCount != eyeCount)
   {
     util::error(Error::GenericOpenXR);
-    return BeginFrameResult::Error;
+    return false;
   }
 
   // Update the eye render infos, view and projection matrices
@@ -772,233 +797,169 @@ Headset::BeginFrameResult Headset::beginFrame(uint32_t& swapchainImageIndex)
     eyeProjectionMatrices.at(eyeIndex) = util::createProjectionMatrix(eyeRenderInfo.fov, 0.1f, 250.0f);
   }
 
-  // Acquire the swapchain image
-  XrSwapchainImageAcquireInfo swapchainImageAcquireInfo{ XR_TYPE_SWAPCHAIN_IMAGE_ACQUIRE_INFO };
-  result = xrAcquireSwapchainImage(swapchain, &swapchainImageAcquireInfo, &swapchainImageIndex);
-  if (XR_FAILED(result))
+  return true;
+}
+
+void Headset::endFrame(bool rendered)
+{
+  // Release the swapchain image, frames that should not be rendered never acquire one
+  if (swapchainImageAcquired)
   {
-    util::error(Error::GenericOpenXR);
-    return BeginFrameResult::Error;
+    swapchainImageAcquired = false;
+
+    XrSwapchainImageReleaseInfo swapchainImageReleaseInfo{ XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
+    const XrResult result = xrReleaseSwapchainImage(swapchain, &swapchainImageReleaseInfo);
+    if (XR_FAILED(result))
+    {
+      return;
+    }
   }
 
-  // Wait for the swapchain image
-  XrSwapchainImageWaitInfo swapchainImageWaitInfo{ XR_TYPE_SWAPCHAIN_IMAGE_WAIT_INFO };
-  swapchainImageWaitInfo.timeout = XR_INFINITE_DURATION;
-  result = xrWaitSwapchainImage(swapchain, &swapchainImageWaitInfo);
+  // End the frame
+  XrCompositionLayerProjection compositionLayerProjection{ XR_TYPE_COMPOSITION_LAYER_PROJECTION };
+  compositionLayerProjection.space = space;
+  compositionLayerProjection.viewCount = static_cast<uint32_t>(eyeRenderInfos.size());
+  compositionLayerProjection.views = eyeRenderInfos.data();
+
+  std::vector<XrCompositionLayerBaseHeader*> layers;
+
+  const bool positionValid = viewState.viewStateFlags & XR_VIEW_STATE_POSITION_VALID_BIT;
+  const bool orientationValid = viewState.viewStateFlags & XR_VIEW_STATE_ORIENTATION_VALID_BIT;
+  if (rendered && frameState.shouldRender && positionValid && orientationValid)
+  {
+    layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&compositionLayerProjection));
+  }
+
+  XrFrameEndInfo frameEndInfo{ XR_TYPE_FRAME_END_INFO };
+  frameEndInfo.displayTime = frameState.predictedDisplayTime;
+  frameEndInfo.layerCount = static_cast<uint32_t>(layers.size());
+  frameEndInfo.layers = layers.data();
+  frameEndInfo.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
+  const XrResult result = xrEndFrame(session, &frameEndInfo);
   if (XR_FAILED(result))
   {
-    util::error(Error::GenericOpenXR);
-    return BeginFrameResult::Error;
+    return;
   }
+}
 
-  for (int i = 0; i < 64; i++) {
-    tracked_locations[i].pose.position = {0.0, 0.0, 0.0};
-    tracked_locations[i].pose.orientation = {0.0, 0.0, 0.0, 1.0};
+bool Headset::sampleInput(InputSnapshot& snapshot)
+{
+  const XrTime time = inputTime;
+  if (time == 0)
+  {
+    // No frame has been begun in the running session yet
+    return false;
   }
 
-  // query each value / location with a subaction path != XR_NULL_PATH
-  // resulting in individual values per hand/.
+  snapshot.time = time;
+  for (XrSpaceLocation& trackedLocation : snapshot.trackedLocations)
+  {
+    trackedLocation.pose = util::makeIdentity();
+  }
 
-  const XrActiveActionSet active_actionsets[] = {
-    {.actionSet = gameplay_actionset, .subactionPath = XR_NULL_PATH}};
+  // Query each value and location with a subaction path, resulting in individual values per hand
+  XrActiveActionSet activeActionSet;
+  activeActionSet.actionSet = gameplay_actionset;
+  activeActionSet.subactionPath = XR_NULL_PATH;
 
-  XrActionsSyncInfo actions_sync_info = {
-    .type = XR_TYPE_ACTIONS_SYNC_INFO,
-    .countActiveActionSets = sizeof(active_actionsets) / sizeof(active_actionsets[0]),
-    .activeActionSets = active_actionsets,
-  };
-  result = xrSyncActions(session, &actions_sync_info);
-  //xr_result(self->instance, result, "failed to sync actions!");
+  XrActionsSyncInfo actionsSyncInfo{ XR_TYPE_ACTIONS_SYNC_INFO };
+  actionsSyncInfo.countActiveActionSets = 1u;
+  actionsSyncInfo.activeActionSets = &activeActionSet;
+  if (XR_FAILED(xrSyncActions(session, &actionsSyncInfo)))
+  {
+    // The session may have just stopped, try again with the next sample
+    return false;
+  }
 
-  for (int i = 0; i < HAND_COUNT; i++) {
-    XrActionStatePose hand_pose_state = {.type = XR_TYPE_ACTION_STATE_POSE, .next = NULL};
+  for (size_t handIndex = 0u; handIndex < HAND_COUNT; ++handIndex)
+  {
+    XrActionStateGetInfo actionStateGetInfo{ XR_TYPE_ACTION_STATE_GET_INFO };
+    actionStateGetInfo.subactionPath = hand_paths[handIndex];
+
+    XrSpaceLocation& trackedLocation = snapshot.trackedLocations[handIndex];
+    trackedLocation.type = XR_TYPE_SPACE_LOCATION;
+    trackedLocation.next = nullptr;
+    xrLocateSpace(hand_pose_spaces[handIndex], space, time, &trackedLocation);
+
+    XrActionStateFloat& grabValue = snapshot.grabValues[handIndex];
+    grabValue = { XR_TYPE_ACTION_STATE_FLOAT };
+    actionStateGetInfo.action = grab_action_float;
+    if (XR_FAILED(xrGetActionStateFloat(session, &actionStateGetInfo, &grabValue)))
     {
-      XrActionStateGetInfo get_info = {.type = XR_TYPE_ACTION_STATE_GET_INFO,
-                                       .next = NULL,
-                                       .action = hand_pose_action,
-                                       .subactionPath = hand_paths[i]};
-      result = xrGetActionStatePose(session, &get_info, &hand_pose_state);
-      //xr_check(instance, result, "failed to get pose value!");
+      util::error(Error::GenericOpenXR);
     }
-    //printf("Hand pose %d active: %d\n", i, hand_pose_state.isActive);
-
-    tracked_locations[i].type = XR_TYPE_SPACE_LOCATION;
-    tracked_locations[i].next = NULL;
-
-    result = xrLocateSpace(hand_pose_spaces[i], space, frameState.predictedDisplayTime,
-                           &tracked_locations[i]);
-    //xr_check(instance, result, "failed to locate space %d!", i);
-
 
-    /*printf("Pose %d valid %d: %f %f %f %f, %f %f %f\n", i,
-    1, hand_locations[i].pose.orientation.x,
-    hand_locations[i].pose.orientation.y, hand_locations[i].pose.orientation.z,
-    hand_locations[i].pose.orientation.w, hand_locations[i].pose.position.x,
-    hand_locations[i].pose.position.y, hand_locations[i].pose.position.z
-    );*/
-
-
-    grab_value[i].type = XR_TYPE_ACTION_STATE_FLOAT;
-    grab_value[i].next = NULL;
+    XrActionStateBoolean& systemValue = snapshot.systemValues[handIndex];
+    systemValue = { XR_TYPE_ACTION_STATE_BOOLEAN };
+    actionStateGetInfo.action = system_action_bool;
+    xrGetActionStateBoolean(session, &actionStateGetInfo, &systemValue);
+    if (systemValue.currentState && systemValue.changedSinceLastSync)
     {
-      XrActionStateGetInfo get_info = {.type = XR_TYPE_ACTION_STATE_GET_INFO,
-                                       .next = NULL,
-                                       .action = grab_action_float,
-                                       .subactionPath = hand_paths[i]};
-
-      result = xrGetActionStateFloat(session, &get_info, &grab_value[i]);
-      if (XR_FAILED(result)) {
-        util::error(Error::GenericOpenXR);
-      }
+      printf("system %zu, %x\n", handIndex, systemValue.currentState);
     }
+  }
+
+  // Locate the joints of both hands, they follow the two controllers in the tracked points
+  XrHandJointsLocateInfoEXT handJointsLocateInfo{ XR_TYPE_HAND_JOINTS_LOCATE_INFO_EXT };
+  handJointsLocateInfo.baseSpace = space;
+  handJointsLocateInfo.time = time;
 
-    /*if (grab_value[i].isActive)
+  snapshot.pinchLeft = snapshot.pinchRight = false;
+  const auto locateHand = [&](XrHandTrackerEXT handTracker, XrHandJointLocationsEXT& locations,
+                              const XrHandJointLocationEXT* jointLocations, size_t firstTrackedPoint, bool& pinch)
+  {
+    if (XR_FAILED(context->xrLocateHandJointsEXT(handTracker, &handJointsLocateInfo, &locations)) ||
+        !locations.isActive)
     {
-      printf("Grab %d active %d, current %f, changed %d\n", i,
-      grab_value[i].isActive, grab_value[i].currentState,
-      grab_value[i].changedSinceLastSync);
-    }*/
-    
-
-    if (grab_value[i].isActive && grab_value[i].currentState > 0.75) {
-      XrHapticVibration vibration = {.type = XR_TYPE_HAPTIC_VIBRATION,
-                                     .next = NULL,
-                                     .amplitude = 0.5,
-                                     .duration = XR_MIN_HAPTIC_DURATION,
-                                     .frequency = XR_FREQUENCY_UNSPECIFIED};
-
-      XrHapticActionInfo haptic_action_info = {.type = XR_TYPE_HAPTIC_ACTION_INFO,
-                                               .next = NULL,
-                                               .action = haptic_action,
-                                               .subactionPath = hand_paths[i]};
-      result = xrApplyHapticFeedback(session, &haptic_action_info,
-                                     (const XrHapticBaseHeader*)&vibration);
-      //xr_check(instance, result, "failed to apply haptic feedback!");
-      // printf("Sent haptic output to hand %d\n", i);
+      return;
     }
 
-    system_value[i].type = XR_TYPE_ACTION_STATE_BOOLEAN;
-    system_value[i].next = NULL;
+    for (size_t jointIndex = 0u; jointIndex <= XR_HAND_JOINT_LITTLE_TIP_EXT; ++jointIndex)
     {
-      XrActionStateGetInfo get_info = {.type = XR_TYPE_ACTION_STATE_GET_INFO,
-                                       .next = NULL,
-                                       .action = system_action_bool,
-                                       .subactionPath = hand_paths[i]};
-
-      
-      result = xrGetActionStateBoolean(session, &get_info, &system_value[i]);
-      //xr_check(instance, result, "failed to get grab value!");
-
-      if (system_value[i].currentState)
-        printf("system %u, %x\n", i, system_value[i].currentState);
-      if (system_value[i].currentState) {
-        //system_button = true;
-      }
+      snapshot.trackedLocations[firstTrackedPoint + jointIndex].pose = jointLocations[jointIndex].pose;
     }
-  };
 
-  XrHandJointsLocateInfoEXT locateInfo{XR_TYPE_HAND_JOINTS_LOCATE_INFO_EXT};
-  locateInfo.baseSpace = space;
-  locateInfo.time = frameState.predictedDisplayTime;
+    // The returned joint location array can be directly indexed with the joint enum
+    const XrVector3f& indexTip = jointLocations[XR_HAND_JOINT_INDEX_TIP_EXT].pose.position;
+    const XrVector3f& thumbTip = jointLocations[XR_HAND_JOINT_THUMB_TIP_EXT].pose.position;
+    const float distance =
+      glm::length(glm::vec3(thumbTip.x, thumbTip.y, thumbTip.z) - glm::vec3(indexTip.x, indexTip.y, indexTip.z));
+    pinch = distance < 0.001f;
+  };
 
   if (left_hand_valid)
-    context->xrLocateHandJointsEXT(leftHandTracker, &locateInfo, &leftLocations);
-  if (right_hand_valid)
-    context->xrLocateHandJointsEXT(rightHandTracker, &locateInfo, &rightLocations);
-
-  if (leftLocations.isActive) {
-      // The returned joint location array can be directly indexed with
-      // XrHandJointEXT enum.
-      const XrPosef &indexTipInWorld =
-          leftJointLocations[XR_HAND_JOINT_INDEX_TIP_EXT].pose;
-      const XrPosef &thumbTipInWorld =
-          leftJointLocations[XR_HAND_JOINT_THUMB_TIP_EXT].pose;
-        const XrPosef &palmInWorld =
-          leftJointLocations[XR_HAND_JOINT_WRIST_EXT].pose;
-
-      // using the returned radius and velocity of index finger tip.
-      const float indexTipRadius =
-          leftJointLocations[XR_HAND_JOINT_INDEX_TIP_EXT].radius;
-      const XrHandJointVelocityEXT &indexTipVelocity =
-          leftJointVelocities[XR_HAND_JOINT_INDEX_TIP_EXT];
-
-      for (int i = 0; i <= XR_HAND_JOINT_LITTLE_TIP_EXT; i++) {
-        tracked_locations[2+i].pose = leftJointLocations[i].pose;
-      }
-
-      glm::vec3 v1 = {indexTipInWorld.position.x, indexTipInWorld.position.y, indexTipInWorld.position.z};
-      glm::vec3 v2 = {thumbTipInWorld.position.x, thumbTipInWorld.position.y, thumbTipInWorld.position.z};
-
-      float distance = glm::length(v2 - v1);
-
-      pinch_l = distance < 0.001;
-
-      //printf("l: %f\n", distance);
-
-      //printf("l: %f %f %f\n", palmInWorld.position.x, palmInWorld.position.y, palmInWorld.position.z);
+  {
+    locateHand(leftHandTracker, leftLocations, leftJointLocations, 2u, snapshot.pinchLeft);
   }
 
-  if (rightLocations.isActive) {
-      const XrPosef &indexTipInWorld =
-          rightJointLocations[XR_HAND_JOINT_INDEX_TIP_EXT].pose;
-      const XrPosef &thumbTipInWorld =
-          rightJointLocations[XR_HAND_JOINT_THUMB_TIP_EXT].pose;
-        const XrPosef &palmInWorld =
-          rightJointLocations[XR_HAND_JOINT_WRIST_EXT].pose;
-
-      for (int i = 0; i <= XR_HAND_JOINT_LITTLE_TIP_EXT; i++) {
-        tracked_locations[2+XR_HAND_JOINT_LITTLE_TIP_EXT+1+i].pose = rightJointLocations[i].pose;
-      }
-
-      glm::vec3 v1 = {indexTipInWorld.position.x, indexTipInWorld.position.y, indexTipInWorld.position.z};
-      glm::vec3 v2 = {thumbTipInWorld.position.x, thumbTipInWorld.position.y, thumbTipInWorld.position.z};
-
-      float distance = glm::length(v2 - v1);
-
-      pinch_r = distance < 0.001;
-
-      //printf("r: %f\n", distance);
-
-      //printf("r: %f %f %f\n", palmInWorld.position.x, palmInWorld.position.y, palmInWorld.position.z);
+  if (right_hand_valid)
+  {
+    locateHand(rightHandTracker, rightLocations, rightJointLocations, 2u + XR_HAND_JOINT_LITTLE_TIP_EXT + 1u,
+               snapshot.pinchRight);
   }
 
-  return BeginFrameResult::RenderFully; // Request full rendering of the frame
+  return true;
 }
 
-void Headset::endFrame() const
+void Headset::applyHapticFeedback()
 {
-  // Release the swapchain image
-  XrSwapchainImageReleaseInfo swapchainImageReleaseInfo{ XR_TYPE_SWAPCHAIN_IMAGE_RELEASE_INFO };
-  XrResult result = xrReleaseSwapchainImage(swapchain, &swapchainImageReleaseInfo);
-  if (XR_FAILED(result))
-  {
-    return;
-  }
-
-  // End the frame
-  XrCompositionLayerProjection compositionLayerProjection{ XR_TYPE_COMPOSITION_LAYER_PROJECTION };
-  compositionLayerProjection.space = space;
-  compositionLayerProjection.viewCount = static_cast<uint32_t>(eyeRenderInfos.size());
-  compositionLayerProjection.views = eyeRenderInfos.data();
-
-  std::vector<XrCompositionLayerBaseHeader*> layers;
-
-  const bool positionValid = viewState.viewStateFlags & XR_VIEW_STATE_POSITION_VALID_BIT;
-  const bool orientationValid = viewState.viewStateFlags & XR_VIEW_STATE_ORIENTATION_VALID_BIT;
-  if (frameState.shouldRender && positionValid && orientationValid)
-  {
-    layers.push_back(reinterpret_cast<XrCompositionLayerBaseHeader*>(&compositionLayerProjection));
-  }
-
-  XrFrameEndInfo frameEndInfo{ XR_TYPE_FRAME_END_INFO };
-  frameEndInfo.displayTime = frameState.predictedDisplayTime;
-  frameEndInfo.layerCount = static_cast<uint32_t>(layers.size());
-  frameEndInfo.layers = layers.data();
-  frameEndInfo.environmentBlendMode = XR_ENVIRONMENT_BLEND_MODE_OPAQUE;
-  result = xrEndFrame(session, &frameEndInfo);
-  if (XR_FAILED(result))
+  // Vibrate while grabbing, the sampler only reads the input so that it has no side effects at its own rate
+  const InputSnapshot& input = getLatestInput();
+  for (size_t handIndex = 0u; handIndex < HAND_COUNT; ++handIndex)
   {
-    return;
+    const XrActionStateFloat& grabValue = input.grabValues[handIndex];
+    if (grabValue.isActive && grabValue.currentState > 0.75f)
+    {
+      XrHapticVibration vibration{ XR_TYPE_HAPTIC_VIBRATION };
+      vibration.amplitude = 0.5f;
+      vibration.duration = XR_MIN_HAPTIC_DURATION;
+      vibration.frequency = XR_FREQUENCY_UNSPECIFIED;
+
+      XrHapticActionInfo hapticActionInfo{ XR_TYPE_HAPTIC_ACTION_INFO };
+      hapticActionInfo.action = haptic_action;
+      hapticActionInfo.subactionPath = hand_paths[handIndex];
+      xrApplyHapticFeedback(session, &hapticActionInfo, reinterpret_cast<const XrHapticBaseHeader*>(&vibration));
+    }
   }
 }
 
@@ -1012,11 +973,52 @@ bool Headset::isExitRequested() const
   return exitRequested;
 }
 
+const InputSnapshot& Headset::getLatestInput() const
+{
+  return inputSampler->getLatest();
+}
+
+bool Headset::isSessionRunning() const
+{
+  return sessionState == XR_SESSION_STATE_READY || sessionState == XR_SESSION_STATE_SYNCHRONIZED ||
+         sessionState == XR_SESSION_STATE_VISIBLE || sessionState == XR_SESSION_STATE_FOCUSED;
+}
+
+float Headset::getDisplayPeriod() const
+{
+  return static_cast<float>(static_cast<double>(waitedFrameState.predictedDisplayPeriod) * 1e-9);
+}
+
 VkRenderPass Headset::getRenderPass() const
 {
   return renderPass;
 }
 
+VkFormat Headset::getColorFormat() const
+{
+  return colorFormat;
+}
+
+VkFormat Headset::getDepthFormat() const
+{
+  return depthFormat;
+}
+
+uint32_t Headset::getViewMask() const
+{
+  return viewMask;
+}
+
+VkImage Headset::getDepthImage() const
+{
+  return depthImage;
+}
+
+VkImageView Headset::getDepthImageView() const
+{
+  return depthImageView;
+}
+
 size_t Headset::getEyeCount() const
 {
   return eyeCount;
@@ -1038,6 +1040,11 @@ glm::mat4 Headset::getEyeProjectionMatrix(size_t eyeIndex) const
   return eyeProjectionMatrices.at(eyeIndex);
 }
 
+size_t Headset::getSwapchainImageCount() const
+{
+  return swapchainRenderTargets.size();
+}
+
 RenderTarget* Headset::getRenderTarget(size_t swapchainImageIndex) const
 {
   return swapchainRenderTargets.at(swapchainImageIndex);
@@ -1058,8 +1065,11 @@ bool Headset::beginSession() const
   return true;
 }
 
-bool Headset::endSession() const
+bool Headset::endSession()
 {
+  // Stop sampling the input until the next frame of a new session has begun
+  inputTime = 0;
+
   // End the session
   const XrResult result = xrEndSession(session);
   if (XR_FAILED(result))
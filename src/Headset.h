@@ -1,5 +1,7 @@
 #pragma once
 
+#include "MemoryAllocator.h"
+
 #include <glm/mat4x4.hpp>
 
 #include <vulkan/vulkan.h>
@@ -8,19 +10,24 @@
 #include <openxr/openxr.h>
 #include <openxr/openxr_platform.h>
 
+#include <atomic>
 #include <vector>
 
 class Context;
+class ImageViewCache;
+class InputSampler;
 class RenderTarget;
+struct InputSnapshot;
 
 #define HAND_LEFT_INDEX (0)
 #define HAND_RIGHT_INDEX (1)
 #define HAND_COUNT (2)
+#define TRACKED_POINT_COUNT (64) // Controllers followed by the joints of both hands
 
 class Headset final
 {
 public:
-  Headset(const Context* context);
+  Headset(const Context* context, float inputRate); // Input sampling rate in Hz
   ~Headset();
 
   enum class BeginFrameResult
@@ -30,27 +37,40 @@ public:
     SkipRender,  // Skip rendering the frame but end it
     SkipFully    // Skip processing this frame entirely without ending it
   };
-  BeginFrameResult beginFrame(uint32_t& swapchainImageIndex);
-  void endFrame() const;
+  // The frame is waited for while the previous one may still be rendered, it is only begun once that one is ended and
+  // the events are polled, so that session state changes never happen with a frame in progress
+  bool pollEvents();
+  BeginFrameResult waitFrame();
+  BeginFrameResult beginFrame(uint32_t& swapchainImageIndex); // Also acquires the swapchain image and samples input
+  void endFrame(bool rendered);                               // Only submits the layer if the frame was rendered
+
+  // Locates the eyes of the frame in progress once more, which refines the eye matrices and the poses that are
+  // submitted when the frame is ended
+  bool locateViews();
+
+  // Vibrates the controllers that grab in the latest input, once per frame from the render thread
+  void applyHapticFeedback();
 
   bool isValid() const;
   bool isExitRequested() const;
-  VkRenderPass getRenderPass() const;
+  bool isSessionRunning() const;
+  float getDisplayPeriod() const; // In seconds, predicted for the frame waited for last
+  VkRenderPass getRenderPass() const; // Null with dynamic rendering
+  VkFormat getColorFormat() const;
+  VkFormat getDepthFormat() const;
+  uint32_t getViewMask() const;
+  VkImage getDepthImage() const;         // Null with dynamic rendering
+  VkImageView getDepthImageView() const; // Null with dynamic rendering
   size_t getEyeCount() const;
   VkExtent2D getEyeResolution(size_t eyeIndex) const;
   glm::mat4 getEyeViewMatrix(size_t eyeIndex) const;
   glm::mat4 getEyeProjectionMatrix(size_t eyeIndex) const;
+  size_t getSwapchainImageCount() const;
   RenderTarget* getRenderTarget(size_t swapchainImageIndex) const;
+  const InputSnapshot& getLatestInput() const; // Only from the render thread, valid until its next call
 
-  XrActionStateFloat grab_value[HAND_COUNT];
-  XrActionStateBoolean system_value[HAND_COUNT];
-  XrSpaceLocation tracked_locations[64];
   XrActionSet gameplay_actionset;
 
-  bool pinch_l;
-  bool pinch_r;
-
-
   XrPath grip_pose_path[HAND_COUNT];
   XrPath haptic_path[HAND_COUNT];
   XrPath thumbstick_y_path[HAND_COUNT];
@@ -62,6 +82,7 @@ public:
   XrHandTrackerEXT leftHandTracker;
   XrHandTrackerEXT rightHandTracker;
 
+  // Only used by the input sampler thread
   XrHandJointLocationEXT leftJointLocations[XR_HAND_JOINT_COUNT_EXT];
   XrHandJointVelocityEXT leftJointVelocities[XR_HAND_JOINT_COUNT_EXT];
 
@@ -90,6 +111,7 @@ private:
   XrSessionState sessionState = XR_SESSION_STATE_UNKNOWN;
   XrSpace space = nullptr;
   XrFrameState frameState = {};
+  XrFrameState waitedFrameState = {}; // Of the next frame, while the current one may still be rendered
   XrViewState viewState = {};
 
   std::vector<XrViewConfigurationView> eyeImageInfos;
@@ -97,14 +119,16 @@ private:
   std::vector<XrCompositionLayerProjectionView> eyeRenderInfos;
 
   XrSwapchain swapchain = nullptr;
+  bool swapchainImageAcquired = false; // By the frame in progress
   std::vector<RenderTarget*> swapchainRenderTargets;
 
   VkRenderPass renderPass = nullptr;
+  ImageViewCache* imageViewCache = nullptr;
 
   // Depth buffer
   VkImage depthImage = nullptr;
-  VkDeviceMemory depthMemory = nullptr;
-  VkImageView depthImageView = nullptr;
+  MemoryAllocation depthMemory;
+  VkImageView depthImageView = nullptr; // Owned by the image view cache
 
   XrAction hand_pose_action;
   XrSpace hand_pose_spaces[HAND_COUNT];
@@ -113,6 +137,10 @@ private:
   XrAction haptic_action;
   XrPath hand_paths[HAND_COUNT];
 
+  InputSampler* inputSampler = nullptr;
+  std::atomic<XrTime> inputTime = 0; // Display time of the frame in progress, zero if there is none
+
   bool beginSession() const;
-  bool endSession() const;
+  bool endSession();
+  bool sampleInput(InputSnapshot& snapshot); // On the input sampler thread
 };
\ No newline at end of file
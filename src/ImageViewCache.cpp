@@ -0,0 +1,58 @@
+#include "ImageViewCache.h"
+
+#include "Util.h"
+
+ImageViewCache::ImageViewCache(VkDevice device) : device(device)
+{
+}
+
+ImageViewCache::~ImageViewCache()
+{
+  for (const std::pair<const uint64_t, Entry>& entry : entries)
+  {
+    vkDestroyImageView(device, entry.second.imageView, nullptr);
+  }
+}
+
+VkImageView ImageViewCache::get(VkImage image, VkFormat format, VkImageAspectFlags aspectMask, uint32_t layerCount)
+{
+  uint64_t hash = util::hashData(reinterpret_cast<const char*>(&image), sizeof(image));
+  hash = util::hashData(reinterpret_cast<const char*>(&format), sizeof(format), hash);
+  hash = util::hashData(reinterpret_cast<const char*>(&aspectMask), sizeof(aspectMask), hash);
+  hash = util::hashData(reinterpret_cast<const char*>(&layerCount), sizeof(layerCount), hash);
+
+  // Return an existing view
+  const auto range = entries.equal_range(hash);
+  for (auto iterator = range.first; iterator != range.second; ++iterator)
+  {
+    const Entry& entry = iterator->second;
+    if (entry.image == image && entry.format == format && entry.aspectMask == aspectMask &&
+        entry.layerCount == layerCount)
+    {
+      return entry.imageView;
+    }
+  }
+
+  // Create an image view
+  VkImageViewCreateInfo imageViewCreateInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+  imageViewCreateInfo.image = image;
+  imageViewCreateInfo.format = format;
+  imageViewCreateInfo.viewType = (layerCount == 1u ? VK_IMAGE_VIEW_TYPE_2D : VK_IMAGE_VIEW_TYPE_2D_ARRAY);
+  imageViewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
+                                     VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
+  imageViewCreateInfo.subresourceRange.layerCount = layerCount;
+  imageViewCreateInfo.subresourceRange.aspectMask = aspectMask;
+  imageViewCreateInfo.subresourceRange.baseArrayLayer = 0u;
+  imageViewCreateInfo.subresourceRange.baseMipLevel = 0u;
+  imageViewCreateInfo.subresourceRange.levelCount = 1u;
+
+  VkImageView imageView;
+  if (vkCreateImageView(device, &imageViewCreateInfo, nullptr, &imageView) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return nullptr;
+  }
+
+  entries.emplace(hash, Entry{ image, format, aspectMask, layerCount, imageView });
+  return imageView;
+}
\ No newline at end of file
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <unordered_map>
+
+// Creates image views on first use and hands out the same view for the same image, format, aspect and layer count
+// afterwards, so attachments can be looked up every frame without creating or destroying any views
+class ImageViewCache final
+{
+public:
+  ImageViewCache(VkDevice device);
+  ~ImageViewCache(); // Destroys all views, the images have to outlive the cache
+
+  VkImageView get(VkImage image, VkFormat format, VkImageAspectFlags aspectMask, uint32_t layerCount);
+
+private:
+  struct Entry final
+  {
+    VkImage image = nullptr;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkImageAspectFlags aspectMask = 0u;
+    uint32_t layerCount = 0u;
+    VkImageView imageView = nullptr;
+  };
+
+  VkDevice device = nullptr;
+  std::unordered_multimap<uint64_t, Entry> entries; // By image, format, aspect and layer count hash
+};
\ No newline at end of file
@@ -0,0 +1,97 @@
+#include "InputSampler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+constexpr uint32_t freshFlag = 4u; // Set in the middle index when the middle snapshot has not been read yet
+} // namespace
+
+InputSampler::InputSampler(const SampleFunction& sampleFunction, float rate)
+: sampleFunction(sampleFunction), rate(rate)
+{
+  // Start with identity poses, which is what untracked points are drawn at
+  for (InputSnapshot& snapshot : snapshots)
+  {
+    for (XrSpaceLocation& trackedLocation : snapshot.trackedLocations)
+    {
+      trackedLocation = { XR_TYPE_SPACE_LOCATION };
+      trackedLocation.pose.orientation.w = 1.0f;
+    }
+
+    for (XrActionStateFloat& grabValue : snapshot.grabValues)
+    {
+      grabValue = { XR_TYPE_ACTION_STATE_FLOAT };
+    }
+
+    for (XrActionStateBoolean& systemValue : snapshot.systemValues)
+    {
+      systemValue = { XR_TYPE_ACTION_STATE_BOOLEAN };
+    }
+  }
+
+  // Start the thread
+  thread = std::thread(&InputSampler::work, this);
+}
+
+InputSampler::~InputSampler()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    exitRequested = true;
+  }
+  wakeCondition.notify_one();
+  thread.join();
+}
+
+void InputSampler::wake()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    wakeRequested = true;
+  }
+  wakeCondition.notify_one();
+}
+
+const InputSnapshot& InputSampler::getLatest()
+{
+  if (middleIndex.load(std::memory_order_relaxed) & freshFlag)
+  {
+    frontIndex = middleIndex.exchange(frontIndex, std::memory_order_acq_rel) & ~freshFlag;
+  }
+
+  return snapshots[frontIndex];
+}
+
+void InputSampler::work()
+{
+  const std::chrono::steady_clock::duration period =
+    std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float>(1.0f / rate));
+
+  uint64_t sampleIndex = 0u;
+  std::chrono::steady_clock::time_point sampleTime = std::chrono::steady_clock::now();
+  while (!exitRequested)
+  {
+    InputSnapshot& snapshot = snapshots[backIndex];
+    if (sampleFunction(snapshot))
+    {
+      // Publish the snapshot, the previous middle snapshot becomes the next one to write
+      snapshot.sampleIndex = ++sampleIndex;
+      backIndex = middleIndex.exchange(backIndex | freshFlag, std::memory_order_acq_rel) & ~freshFlag;
+    }
+    else
+    {
+      // Sleep without waking up at the rate until there is something to sample again
+      std::unique_lock<std::mutex> lock(mutex);
+      wakeCondition.wait(lock, [this]() { return wakeRequested || exitRequested; });
+      wakeRequested = false;
+      sampleTime = std::chrono::steady_clock::now();
+      continue;
+    }
+
+    // Keep the rate without trying to catch up on samples that were missed
+    sampleTime = std::max(sampleTime + period, std::chrono::steady_clock::now());
+    std::this_thread::sleep_until(sampleTime);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "Headset.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// The input at one point in time, never changed once it is published
+struct InputSnapshot final
+{
+  XrTime time = 0;           // Display time the poses are located at
+  uint64_t sampleIndex = 0u; // Increases with every published snapshot
+  XrSpaceLocation trackedLocations[TRACKED_POINT_COUNT];
+  XrActionStateFloat grabValues[HAND_COUNT];
+  XrActionStateBoolean systemValues[HAND_COUNT];
+  bool pinchLeft = false, pinchRight = false;
+};
+
+// Samples the input on a dedicated thread at a fixed rate and publishes snapshots through a wait-free triple buffer,
+// a single reader always gets the latest snapshot without ever blocking the sampler or being blocked by it
+class InputSampler final
+{
+public:
+  // Fills in a snapshot, returns false if there is nothing to sample, the sampler then sleeps until it is woken
+  using SampleFunction = std::function<bool(InputSnapshot& snapshot)>;
+
+  InputSampler(const SampleFunction& sampleFunction, float rate); // Rate in Hz
+  ~InputSampler();
+
+  const InputSnapshot& getLatest(); // Only from one reader thread, valid until its next call
+  void wake();                      // Once there may be something to sample again
+
+private:
+  SampleFunction sampleFunction;
+  float rate = 0.0f;
+  std::thread thread;
+  std::atomic<bool> exitRequested = false; // Set under the mutex so that a sleeping sampler cannot miss it
+
+  std::mutex mutex;
+  std::condition_variable wakeCondition;
+  bool wakeRequested = false; // Guarded by the mutex
+
+  // The sampler writes the back snapshot and swaps it with the middle one, the reader swaps the middle one with its
+  // front snapshot whenever it is newer, so the three of them are never touched by both threads at once
+  InputSnapshot snapshots[3];
+  uint32_t backIndex = 0u;                // Only used by the sampler
+  std::atomic<uint32_t> middleIndex = 1u; // Flagged while not read yet
+  uint32_t frontIndex = 2u;               // Only used by the reader
+
+  void work();
+};
\ No newline at end of file
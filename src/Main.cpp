@@ -1,10 +1,121 @@
 #include "Context.h"
+#include "FrameScheduler.h"
 #include "Headset.h"
+#include "MemoryAllocator.h"
 #include "MirrorView.h"
+#include "RenderThread.h"
 #include "Renderer.h"
+#include "Util.h"
 
-int main()
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace
+{
+constexpr size_t defaultFramesInFlight = 2u;
+constexpr size_t maxFramesInFlight = 4u;
+constexpr size_t maxRecordingThreads = 16u;
+constexpr float defaultInputRate = 500.0f;       // Input samples per second
+constexpr float minInputRate = 30.0f;
+constexpr float maxInputRate = 2000.0f;
+constexpr float minIdleTimeout = 0.01f;          // Seconds to wait for window events once the session stops running
+constexpr float maxIdleTimeout = 0.25f;          // Seconds to wait for window events at most while the session idles
+constexpr size_t frameStatisticsInterval = 90u;  // Number of frames between frame pacing reports
+constexpr size_t benchmarkRepetitionCount = 16u; // Number of recordings averaged per benchmark configuration
+
+// Print the command recording time for growing draw counts and thread counts
+void benchmarkRecording(Renderer& renderer)
+{
+  for (size_t drawCount = 1024u; drawCount <= 262144u; drawCount *= 4u)
+  {
+    for (size_t threadCount = 1u; threadCount <= renderer.getRecordingThreadCount(); threadCount *= 2u)
+    {
+      const float time = renderer.measureRecordingTime(drawCount, threadCount, benchmarkRepetitionCount);
+      std::cout << "Draws: " << drawCount << ", threads: " << threadCount << ", record time: " << time * 1000.0f
+                << " ms\n";
+    }
+  }
+}
+
+// Print how much of each memory heap the allocator holds in blocks and how much of that is handed out
+void printHeapStats(const MemoryAllocator& memoryAllocator)
+{
+  for (uint32_t heapIndex = 0u; heapIndex < memoryAllocator.getHeapCount(); ++heapIndex)
+  {
+    const MemoryAllocator::HeapStats stats = memoryAllocator.getHeapStats(heapIndex);
+    std::cout << "Memory heap " << heapIndex << ": " << stats.blockCount << " blocks, "
+              << stats.blockBytes / (1024u * 1024u) << " MiB, " << stats.allocationCount << " allocations, "
+              << stats.allocationBytes / (1024u * 1024u) << " MiB\n";
+  }
+}
+} // namespace
+
+int main(int argc, char* argv[])
 {
+  // Parse the command line, one frame in flight gives the lowest latency while more frames increase throughput
+  size_t framesInFlight = defaultFramesInFlight;
+  size_t recordingThreadCount = std::clamp(static_cast<size_t>(std::thread::hardware_concurrency()),
+                                           static_cast<size_t>(1u), maxRecordingThreads);
+  bool staticCommandBuffers = false, benchmark = false;
+  int frameThreadCore = -1, renderThreadCore = -1; // Negative to leave the placement to the scheduler
+  bool highPriorityThreads = false, lateLatching = false, justInTime = false;
+  float inputRate = defaultInputRate;
+  std::string shaderOverrideDirectory;
+  for (int argumentIndex = 1; argumentIndex < argc; ++argumentIndex)
+  {
+    if (strcmp(argv[argumentIndex], "--frames-in-flight") == 0 && argumentIndex + 1 < argc)
+    {
+      const size_t value = static_cast<size_t>(strtoul(argv[++argumentIndex], nullptr, 10));
+      framesInFlight = std::clamp(value, static_cast<size_t>(1u), maxFramesInFlight);
+    }
+    else if (strcmp(argv[argumentIndex], "--recording-threads") == 0 && argumentIndex + 1 < argc)
+    {
+      const size_t value = static_cast<size_t>(strtoul(argv[++argumentIndex], nullptr, 10));
+      recordingThreadCount = std::clamp(value, static_cast<size_t>(1u), maxRecordingThreads);
+    }
+    else if (strcmp(argv[argumentIndex], "--shader-directory") == 0 && argumentIndex + 1 < argc)
+    {
+      shaderOverrideDirectory = argv[++argumentIndex];
+    }
+    else if (strcmp(argv[argumentIndex], "--static-command-buffers") == 0)
+    {
+      staticCommandBuffers = true;
+    }
+    else if (strcmp(argv[argumentIndex], "--benchmark-recording") == 0)
+    {
+      benchmark = true;
+    }
+    else if (strcmp(argv[argumentIndex], "--frame-thread-core") == 0 && argumentIndex + 1 < argc)
+    {
+      frameThreadCore = atoi(argv[++argumentIndex]);
+    }
+    else if (strcmp(argv[argumentIndex], "--render-thread-core") == 0 && argumentIndex + 1 < argc)
+    {
+      renderThreadCore = atoi(argv[++argumentIndex]);
+    }
+    else if (strcmp(argv[argumentIndex], "--input-rate") == 0 && argumentIndex + 1 < argc)
+    {
+      inputRate = std::clamp(static_cast<float>(atof(argv[++argumentIndex])), minInputRate, maxInputRate);
+    }
+    else if (strcmp(argv[argumentIndex], "--high-priority-threads") == 0)
+    {
+      highPriorityThreads = true;
+    }
+    else if (strcmp(argv[argumentIndex], "--late-latching") == 0)
+    {
+      lateLatching = true;
+    }
+    else if (strcmp(argv[argumentIndex], "--just-in-time") == 0)
+    {
+      justInTime = true;
+    }
+  }
+
   Context context;
   if (!context.isValid())
   {
@@ -22,59 +133,214 @@ int main()
     return EXIT_FAILURE;
   }
 
-  Headset headset(&context);
+  Headset headset(&context, inputRate);
   if (!headset.isValid())
   {
     return EXIT_FAILURE;
   }
 
-  Renderer renderer(&context, &headset);
+  Renderer renderer(&context, &headset, framesInFlight, recordingThreadCount, staticCommandBuffers,
+                    shaderOverrideDirectory);
   if (!renderer.isValid())
   {
     return EXIT_FAILURE;
   }
 
+  if (benchmark)
+  {
+    benchmarkRecording(renderer);
+    context.sync();
+    return EXIT_SUCCESS;
+  }
+
   if (!mirrorView.connect(&headset, &renderer))
   {
     return EXIT_FAILURE;
   }
 
+  // This thread is the frame thread, it waits for and begins the frames and samples the input
+  if ((frameThreadCore >= 0 || highPriorityThreads) && !util::setThreadPlacement(frameThreadCore, highPriorityThreads))
+  {
+    std::cout << "Frame thread placement was refused, it runs wherever the scheduler puts it\n";
+  }
+
+  // The render thread records, submits and ends the frames, so that waiting for the next frame overlaps with the CPU
+  // work of the previous one
+  RenderThread renderThread(renderThreadCore, highPriorityThreads);
+
+  // Frame pacing statistics, a frame is late if the previous one was only ended a display period after it was ready
+  size_t frameCount = 0u, lateFrameCount = 0u;
+  float frameWaitTimeSum = 0.0f, frameWaitTimeMax = 0.0f, startDelaySum = 0.0f, slackSum = 0.0f;
+
+  // Estimates the render cost of the frames, only touched by one thread at a time as the frame thread waits for the
+  // render thread first
+  FrameScheduler frameScheduler(justInTime);
+
+  // Doubles while the session is not running, as OpenXR events cannot be waited for
+  float idleTimeout = minIdleTimeout;
+
   // Main loop
   while (!headset.isExitRequested() && !mirrorView.isExitRequested())
   {
     mirrorView.processWindowEvents();
 
-    uint32_t swapchainImageIndex;
-    const Headset::BeginFrameResult frameResult = headset.beginFrame(swapchainImageIndex);
-    if (frameResult == Headset::BeginFrameResult::Error)
+    // Wait for the next frame while the render thread may still be busy with the previous one
+    const Headset::BeginFrameResult waitResult = headset.waitFrame();
+    if (waitResult == Headset::BeginFrameResult::Error)
+    {
+      return EXIT_FAILURE;
+    }
+    const std::chrono::steady_clock::time_point waitEnd = std::chrono::steady_clock::now();
+
+    // Only handle session state changes and begin the frame once the previous one is ended, the render thread usually
+    // still works on it at this point
+    renderThread.wait();
+
+    // The frame is late if the previous one took so long to end that a whole display period has passed since the frame
+    // was ready, it is still rendered so that the runtime has a layer to reproject, but begun without a start delay
+    const bool late = (waitResult == Headset::BeginFrameResult::RenderFully &&
+                       std::chrono::duration<float>(std::chrono::steady_clock::now() - waitEnd).count() >
+                         headset.getDisplayPeriod());
+    if (renderThread.isFailed() || !headset.pollEvents())
     {
       return EXIT_FAILURE;
     }
-    else if (frameResult == Headset::BeginFrameResult::RenderFully)
+
+    // The render thread only flags an outdated mirror view swapchain, window functions are for the main thread only
+    if (!mirrorView.updateSwapchain())
     {
-      renderer.render(swapchainImageIndex);
+      return EXIT_FAILURE;
+    }
 
-      const MirrorView::RenderResult mirrorResult = mirrorView.render(swapchainImageIndex);
-      if (mirrorResult == MirrorView::RenderResult::Error)
+    if (waitResult != Headset::BeginFrameResult::RenderFully || !headset.isSessionRunning())
+    {
+      // Keep the mirror view alive at a low rate and block on window events instead of spinning until the session
+      // runs again
+      if (mirrorView.renderIdle() == MirrorView::RenderResult::Error)
       {
         return EXIT_FAILURE;
       }
 
-      const bool mirrorViewVisible = (mirrorResult == MirrorView::RenderResult::Visible);
-      renderer.submit(mirrorViewVisible);
-
-      if (mirrorViewVisible)
+      if (!headset.isSessionRunning())
       {
-        mirrorView.present();
+        mirrorView.waitWindowEvents(idleTimeout);
+        idleTimeout = std::min(idleTimeout * 2.0f, maxIdleTimeout);
       }
+      continue;
     }
+    idleTimeout = minIdleTimeout;
 
-    if (frameResult == Headset::BeginFrameResult::RenderFully || frameResult == Headset::BeginFrameResult::SkipRender)
+    // Begin the frame at the latest moment that still leaves enough time to render it, so that the views and input
+    // are sampled as close to the display time as possible
+    if (late)
     {
-      headset.endFrame();
+      frameScheduler.addLateFrame();
     }
+    frameScheduler.scheduleFrame(headset.getDisplayPeriod());
+    const float startDelay = frameScheduler.getDelay(), slack = frameScheduler.getSlack();
+    if (startDelay > 0.0f)
+    {
+      std::this_thread::sleep_until(waitEnd + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                std::chrono::duration<float>(startDelay)));
+    }
+
+    uint32_t swapchainImageIndex;
+    const Headset::BeginFrameResult frameResult = headset.beginFrame(swapchainImageIndex);
+    if (frameResult == Headset::BeginFrameResult::Error)
+    {
+      return EXIT_FAILURE;
+    }
+
+    // Frames that are not visible are only ended, the mirror view is refreshed at a low rate in the meantime
+    if (frameResult == Headset::BeginFrameResult::SkipRender &&
+        mirrorView.renderIdle() == MirrorView::RenderResult::Error)
+    {
+      return EXIT_FAILURE;
+    }
+
+    if (late)
+    {
+      ++lateFrameCount;
+    }
+
+    const bool render = (frameResult == Headset::BeginFrameResult::RenderFully);
+    renderThread.start(
+      [&, swapchainImageIndex, render, startDelay, slack]()
+      {
+        // A frame that could not be recorded or latched is never submitted and ended without its layer
+        const std::chrono::steady_clock::time_point renderBegin = std::chrono::steady_clock::now();
+        bool rendered = render && renderer.render(swapchainImageIndex);
+        if (rendered)
+        {
+          // Report how long the CPU waited for frames in flight and how many frames were late
+          frameWaitTimeSum += renderer.getFrameWaitTime();
+          frameWaitTimeMax = std::max(frameWaitTimeMax, renderer.getFrameWaitTime());
+          startDelaySum += startDelay;
+          slackSum += slack;
+          if (++frameCount == frameStatisticsInterval)
+          {
+            std::cout << "Frames in flight: " << renderer.getFramesInFlight()
+                      << ", CPU frame wait: " << frameWaitTimeSum / static_cast<float>(frameCount) * 1000.0f
+                      << " ms average, " << frameWaitTimeMax * 1000.0f << " ms max, " << lateFrameCount
+                      << " late frames, frame start delay: "
+                      << startDelaySum / static_cast<float>(frameCount) * 1000.0f
+                      << " ms average, slack: " << slackSum / static_cast<float>(frameCount) * 1000.0f
+                      << " ms average, pipeline registry: " << renderer.getPipelineHitCount() << " hits, "
+                      << renderer.getPipelineMissCount() << " misses in total, descriptor allocator: "
+                      << renderer.getDescriptorPoolCount() << " pools, " << renderer.getDescriptorSetHitCount()
+                      << " hits, " << renderer.getDescriptorSetMissCount() << " misses in total\n";
+            frameCount = lateFrameCount = 0u;
+            frameWaitTimeSum = frameWaitTimeMax = startDelaySum = slackSum = 0.0f;
+          }
+
+          // Locate the eyes and read the input once more right before the GPU consumes the frame, but before the mirror
+          // view acquires an image that would have to be presented even if latching fails
+          if (lateLatching)
+          {
+            if (!headset.locateViews())
+            {
+              return false;
+            }
+
+            rendered = renderer.latch();
+          }
+        }
+
+        if (rendered)
+        {
+          const MirrorView::RenderResult mirrorResult = mirrorView.render(swapchainImageIndex);
+          if (mirrorResult == MirrorView::RenderResult::Error)
+          {
+            return false;
+          }
+
+          const bool mirrorViewVisible = (mirrorResult == MirrorView::RenderResult::Visible);
+          renderer.submit(mirrorViewVisible);
+
+          // The render cost of the frame counts up to its submission, without waiting for earlier frames on the GPU or
+          // for the mirror view, as the GPU time is added on top. The GPU time is of an earlier frame
+          const float cpuTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - renderBegin).count() -
+                                renderer.getFrameWaitTime() - mirrorView.getAcquireTime();
+          frameScheduler.addFrameTime(std::max(cpuTime, 0.0f), renderer.getGpuTime());
+
+          if (mirrorViewVisible)
+          {
+            mirrorView.present();
+          }
+        }
+
+        if (render)
+        {
+          headset.applyHapticFeedback();
+        }
+
+        headset.endFrame(rendered);
+        return true;
+      });
   }
 
+  renderThread.wait();
+  printHeapStats(*context.getMemoryAllocator());
   context.sync(); // Sync before destroying so that resources are free
   return EXIT_SUCCESS;
 }
\ No newline at end of file
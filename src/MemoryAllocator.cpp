@@ -0,0 +1,438 @@
+#include "MemoryAllocator.h"
+
+#include "Util.h"
+
+#include <algorithm>
+#include <sstream>
+
+// A single device memory allocation that is sub-allocated with one strategy
+struct MemoryBlock final
+{
+  VkDeviceMemory memory = nullptr;
+  VkDeviceSize size = 0u;
+  void* mappedData = nullptr;
+  uint32_t memoryTypeIndex = 0u;
+  bool image = false;
+  MemoryAllocator::Strategy strategy = MemoryAllocator::Strategy::Buddy;
+  size_t allocationCount = 0u;
+
+  VkDeviceSize head = 0u;                           // Linear strategy, next free offset
+  std::vector<std::vector<VkDeviceSize>> freeNodes; // Buddy strategy, free node offsets per order
+};
+
+namespace
+{
+constexpr VkDeviceSize maxBlockSize = 64u * 1024u * 1024u; // Largest block, smaller on small heaps
+constexpr VkDeviceSize minNodeSize = 256u;                 // Smallest node of the buddy strategy
+
+VkDeviceSize nextPowerOfTwo(VkDeviceSize value)
+{
+  VkDeviceSize powerOfTwo = 1u;
+  while (powerOfTwo < value)
+  {
+    powerOfTwo <<= 1u;
+  }
+
+  return powerOfTwo;
+}
+
+uint32_t powerOfTwoExponent(VkDeviceSize powerOfTwo)
+{
+  uint32_t exponent = 0u;
+  while (powerOfTwo > 1u)
+  {
+    powerOfTwo >>= 1u;
+    ++exponent;
+  }
+
+  return exponent;
+}
+
+bool allocateBuddy(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset, uint32_t& order)
+{
+  // Nodes are aligned to their own size within the block
+  const VkDeviceSize nodeSize = std::max({ nextPowerOfTwo(size), nextPowerOfTwo(alignment), minNodeSize });
+  const uint32_t requiredOrder = powerOfTwoExponent(nodeSize / minNodeSize);
+
+  // Find the smallest free node that is large enough
+  uint32_t freeOrder = requiredOrder;
+  while (freeOrder < block.freeNodes.size() && block.freeNodes.at(freeOrder).empty())
+  {
+    ++freeOrder;
+  }
+
+  if (freeOrder >= block.freeNodes.size())
+  {
+    return false;
+  }
+
+  offset = block.freeNodes.at(freeOrder).back();
+  block.freeNodes.at(freeOrder).pop_back();
+
+  // Split the node down to the required order, the upper halves become free
+  while (freeOrder > requiredOrder)
+  {
+    --freeOrder;
+    block.freeNodes.at(freeOrder).push_back(offset + (minNodeSize << freeOrder));
+  }
+
+  order = requiredOrder;
+  return true;
+}
+
+void freeBuddy(MemoryBlock& block, VkDeviceSize offset, uint32_t order)
+{
+  // Merge the node with its buddy for as long as the buddy is free as well
+  while (order + 1u < block.freeNodes.size())
+  {
+    const VkDeviceSize buddy = offset ^ (minNodeSize << order);
+    std::vector<VkDeviceSize>& freeNodes = block.freeNodes.at(order);
+    const std::vector<VkDeviceSize>::iterator it = std::find(freeNodes.begin(), freeNodes.end(), buddy);
+    if (it == freeNodes.end())
+    {
+      break;
+    }
+
+    freeNodes.erase(it);
+    offset = std::min(offset, buddy);
+    ++order;
+  }
+
+  block.freeNodes.at(order).push_back(offset);
+}
+
+bool allocateLinear(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+{
+  offset = (block.head + alignment - 1u) / alignment * alignment;
+  if (offset + size > block.size)
+  {
+    return false;
+  }
+
+  block.head = offset + size;
+  return true;
+}
+
+bool allocateFromBlock(MemoryBlock& block, VkDeviceSize alignment, MemoryAllocation& allocation)
+{
+  if (block.strategy == MemoryAllocator::Strategy::Buddy)
+  {
+    return allocateBuddy(block, allocation.size, alignment, allocation.offset, allocation.order);
+  }
+
+  return allocateLinear(block, allocation.size, alignment, allocation.offset);
+}
+} // namespace
+
+MemoryAllocator::MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice) : device(device)
+{
+  vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+  heapStats.resize(memoryProperties.memoryHeapCount);
+
+  VkPhysicalDeviceProperties physicalDeviceProperties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+  nonCoherentAtomSize = std::max<VkDeviceSize>(physicalDeviceProperties.limits.nonCoherentAtomSize, 1u);
+}
+
+MemoryAllocator::~MemoryAllocator()
+{
+  for (MemoryBlock* block : blocks)
+  {
+    vkFreeMemory(device, block->memory, nullptr);
+    delete block;
+  }
+}
+
+bool MemoryAllocator::findMemoryType(uint32_t typeFilter,
+                                     VkMemoryPropertyFlags memoryProperties,
+                                     uint32_t& memoryTypeIndex) const
+{
+  for (uint32_t i = 0u; i < this->memoryProperties.memoryTypeCount; ++i)
+  {
+    const VkMemoryPropertyFlags propertyFlags = this->memoryProperties.memoryTypes[i].propertyFlags;
+    if (typeFilter & (1 << i) && (propertyFlags & memoryProperties) == memoryProperties)
+    {
+      memoryTypeIndex = i;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool MemoryAllocator::allocate(const VkMemoryRequirements& memoryRequirements,
+                               VkMemoryPropertyFlags memoryProperties,
+                               bool image,
+                               Strategy strategy,
+                               MemoryAllocation& allocation)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+
+  allocation = MemoryAllocation();
+  allocation.size = memoryRequirements.size;
+  if (!findMemoryType(memoryRequirements.memoryTypeBits, memoryProperties, allocation.memoryTypeIndex))
+  {
+    util::error(Error::FeatureNotSupported, "Suitable memory type");
+    return false;
+  }
+
+  const VkMemoryType& memoryType = this->memoryProperties.memoryTypes[allocation.memoryTypeIndex];
+  HeapStats& stats = heapStats.at(memoryType.heapIndex);
+
+  // Keep non-coherent allocations apart so that flushing one never touches another
+  VkDeviceSize alignment = std::max<VkDeviceSize>(memoryRequirements.alignment, 1u);
+  if ((memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) &&
+      !(memoryType.propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+  {
+    alignment = std::max(alignment, nonCoherentAtomSize);
+  }
+
+  // Give resources that would take up more than half of a block of their heap a dedicated allocation
+  if (memoryRequirements.size > getBlockSize(memoryType.heapIndex) / 2u)
+  {
+    VkMemoryAllocateInfo memoryAllocateInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+    memoryAllocateInfo.allocationSize = memoryRequirements.size;
+    memoryAllocateInfo.memoryTypeIndex = allocation.memoryTypeIndex;
+    if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &allocation.memory) != VK_SUCCESS)
+    {
+      std::stringstream s;
+      s << memoryRequirements.size << " bytes for dedicated allocation";
+      util::error(Error::OutOfMemory, s.str());
+      return false;
+    }
+
+    if (!mapMemory(allocation.memory, allocation.memoryTypeIndex, allocation.mappedData))
+    {
+      vkFreeMemory(device, allocation.memory, nullptr);
+      allocation.memory = nullptr;
+      return false;
+    }
+
+    ++stats.blockCount;
+    stats.blockBytes += allocation.size;
+    ++stats.allocationCount;
+    stats.allocationBytes += allocation.size;
+    return true;
+  }
+
+  // Place the allocation in the first block of the same kind that has room, or in a new block
+  MemoryBlock* block = nullptr;
+  for (MemoryBlock* candidate : blocks)
+  {
+    if (candidate->memoryTypeIndex != allocation.memoryTypeIndex || candidate->image != image ||
+        candidate->strategy != strategy)
+    {
+      continue;
+    }
+
+    if (allocateFromBlock(*candidate, alignment, allocation))
+    {
+      block = candidate;
+      break;
+    }
+  }
+
+  if (!block)
+  {
+    block = createBlock(allocation.memoryTypeIndex, image, strategy);
+    if (!block)
+    {
+      return false;
+    }
+
+    if (!allocateFromBlock(*block, alignment, allocation))
+    {
+      util::error(Error::OutOfMemory, "Allocation does not fit into a new memory block");
+      return false;
+    }
+  }
+
+  ++block->allocationCount;
+  allocation.block = block;
+  allocation.memory = block->memory;
+  if (block->mappedData)
+  {
+    allocation.mappedData = static_cast<char*>(block->mappedData) + allocation.offset;
+  }
+
+  ++stats.allocationCount;
+  stats.allocationBytes += allocation.size;
+  return true;
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation)
+{
+  if (!allocation.memory)
+  {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  HeapStats& stats = heapStats.at(memoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex);
+  --stats.allocationCount;
+  stats.allocationBytes -= allocation.size;
+
+  MemoryBlock* block = allocation.block;
+  if (!block)
+  {
+    // Freeing memory implicitly unmaps it
+    vkFreeMemory(device, allocation.memory, nullptr);
+    --stats.blockCount;
+    stats.blockBytes -= allocation.size;
+  }
+  else
+  {
+    if (block->strategy == Strategy::Buddy)
+    {
+      freeBuddy(*block, allocation.offset, allocation.order);
+    }
+
+    if (--block->allocationCount == 0u)
+    {
+      block->head = 0u;
+
+      // Keep one empty block of each kind around to avoid allocating it again right away
+      for (const MemoryBlock* other : blocks)
+      {
+        if (other != block && other->allocationCount == 0u && other->memoryTypeIndex == block->memoryTypeIndex &&
+            other->image == block->image && other->strategy == block->strategy)
+        {
+          destroyBlock(block);
+          break;
+        }
+      }
+    }
+  }
+
+  allocation = MemoryAllocation();
+}
+
+bool MemoryAllocator::flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const
+{
+  // Coherent memory does not need to be flushed
+  if (memoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+  {
+    return true;
+  }
+
+  // Flushed ranges are relative to the memory object and have to be aligned to the atom size
+  const VkDeviceSize begin = allocation.offset + offset;
+  const VkDeviceSize end = (begin + size + nonCoherentAtomSize - 1u) / nonCoherentAtomSize * nonCoherentAtomSize;
+  const VkDeviceSize memorySize = allocation.block ? allocation.block->size : allocation.size;
+
+  VkMappedMemoryRange mappedMemoryRange{ VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE };
+  mappedMemoryRange.memory = allocation.memory;
+  mappedMemoryRange.offset = begin / nonCoherentAtomSize * nonCoherentAtomSize;
+  mappedMemoryRange.size = end >= memorySize ? VK_WHOLE_SIZE : end - mappedMemoryRange.offset;
+  if (vkFlushMappedMemoryRanges(device, 1u, &mappedMemoryRange) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return false;
+  }
+
+  return true;
+}
+
+bool MemoryAllocator::isValid() const
+{
+  return valid;
+}
+
+uint32_t MemoryAllocator::getHeapCount() const
+{
+  return memoryProperties.memoryHeapCount;
+}
+
+MemoryAllocator::HeapStats MemoryAllocator::getHeapStats(uint32_t heapIndex) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return heapStats.at(heapIndex);
+}
+
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t heapIndex) const
+{
+  // Use smaller blocks on small heaps, buddy blocks have to be a power of two multiple of the smallest node
+  const VkDeviceSize heapSize = memoryProperties.memoryHeaps[heapIndex].size;
+  VkDeviceSize size = maxBlockSize;
+  while (size > minNodeSize && size > heapSize / 8u)
+  {
+    size >>= 1u;
+  }
+
+  return size;
+}
+
+MemoryBlock* MemoryAllocator::createBlock(uint32_t memoryTypeIndex, bool image, Strategy strategy)
+{
+  const uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+  const VkDeviceSize size = getBlockSize(heapIndex);
+
+  MemoryBlock* block = new MemoryBlock();
+  block->size = size;
+  block->memoryTypeIndex = memoryTypeIndex;
+  block->image = image;
+  block->strategy = strategy;
+
+  if (strategy == Strategy::Buddy)
+  {
+    block->freeNodes.resize(powerOfTwoExponent(size / minNodeSize) + 1u);
+    block->freeNodes.back().push_back(0u);
+  }
+
+  VkMemoryAllocateInfo memoryAllocateInfo{ VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+  memoryAllocateInfo.allocationSize = size;
+  memoryAllocateInfo.memoryTypeIndex = memoryTypeIndex;
+  if (vkAllocateMemory(device, &memoryAllocateInfo, nullptr, &block->memory) != VK_SUCCESS)
+  {
+    std::stringstream s;
+    s << size << " bytes for memory block";
+    util::error(Error::OutOfMemory, s.str());
+    delete block;
+    return nullptr;
+  }
+
+  // Host visible blocks stay mapped as the same memory can not be mapped twice
+  if (!mapMemory(block->memory, memoryTypeIndex, block->mappedData))
+  {
+    vkFreeMemory(device, block->memory, nullptr);
+    delete block;
+    return nullptr;
+  }
+
+  blocks.push_back(block);
+
+  HeapStats& stats = heapStats.at(heapIndex);
+  ++stats.blockCount;
+  stats.blockBytes += size;
+
+  return block;
+}
+
+void MemoryAllocator::destroyBlock(MemoryBlock* block)
+{
+  HeapStats& stats = heapStats.at(memoryProperties.memoryTypes[block->memoryTypeIndex].heapIndex);
+  --stats.blockCount;
+  stats.blockBytes -= block->size;
+
+  blocks.erase(std::find(blocks.begin(), blocks.end(), block));
+  vkFreeMemory(device, block->memory, nullptr);
+  delete block;
+}
+
+bool MemoryAllocator::mapMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex, void*& mappedData) const
+{
+  mappedData = nullptr;
+  if (!(memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+  {
+    return true;
+  }
+
+  if (vkMapMemory(device, memory, 0u, VK_WHOLE_SIZE, 0, &mappedData) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return false;
+  }
+
+  return true;
+}
\ No newline at end of file
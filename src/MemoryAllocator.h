@@ -0,0 +1,68 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <vector>
+
+struct MemoryBlock;
+
+// A range of device memory handed out by the memory allocator
+struct MemoryAllocation final
+{
+  VkDeviceMemory memory = nullptr;
+  VkDeviceSize offset = 0u, size = 0u;
+  void* mappedData = nullptr; // Only set for host visible memory, already offset to the start of the allocation
+  uint32_t memoryTypeIndex = 0u;
+  MemoryBlock* block = nullptr; // Null for dedicated allocations
+  uint32_t order = 0u;          // Node order in the buddy strategy
+};
+
+class MemoryAllocator final
+{
+public:
+  MemoryAllocator(VkDevice device, VkPhysicalDevice physicalDevice);
+  ~MemoryAllocator();
+
+  enum class Strategy
+  {
+    Buddy, // Power of two nodes that can be freed and merged in any order
+    Linear // Bump allocation for short-lived resources, a block is reset once all its allocations are freed
+  };
+
+  struct HeapStats final
+  {
+    size_t blockCount = 0u, allocationCount = 0u;
+    VkDeviceSize blockBytes = 0u, allocationBytes = 0u;
+  };
+
+  bool findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags memoryProperties, uint32_t& memoryTypeIndex) const;
+
+  bool allocate(const VkMemoryRequirements& memoryRequirements,
+                VkMemoryPropertyFlags memoryProperties,
+                bool image,
+                Strategy strategy,
+                MemoryAllocation& allocation);
+  void free(MemoryAllocation& allocation);
+  bool flush(const MemoryAllocation& allocation, VkDeviceSize offset, VkDeviceSize size) const;
+
+  bool isValid() const;
+  uint32_t getHeapCount() const;
+  HeapStats getHeapStats(uint32_t heapIndex) const;
+
+private:
+  bool valid = true;
+
+  VkDevice device = nullptr;
+  VkPhysicalDeviceMemoryProperties memoryProperties;
+  VkDeviceSize nonCoherentAtomSize = 1u;
+
+  mutable std::mutex mutex;
+  std::vector<MemoryBlock*> blocks;
+  std::vector<HeapStats> heapStats;
+
+  VkDeviceSize getBlockSize(uint32_t heapIndex) const;
+  MemoryBlock* createBlock(uint32_t memoryTypeIndex, bool image, Strategy strategy);
+  void destroyBlock(MemoryBlock* block);
+  bool mapMemory(VkDeviceMemory memory, uint32_t memoryTypeIndex, void*& mappedData) const;
+};
\ No newline at end of file
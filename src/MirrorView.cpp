@@ -2,6 +2,7 @@
 
 #include "Context.h"
 #include "Headset.h"
+#include "RenderGraph.h"
 #include "RenderTarget.h"
 #include "Renderer.h"
 #include "Util.h"
@@ -17,6 +18,10 @@ constexpr VkFormat colorFormat = VK_FORMAT_B8G8R8A8_SRGB;
 constexpr VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
 constexpr size_t mirrorEyeIndex = 1u; // Eye index to mirror, 0 = left, 1 = right
 
+// The mirror view is cleared at a low rate while the headset is not rendering
+constexpr std::chrono::milliseconds idleRenderInterval(250);
+constexpr VkClearColorValue idleClearColor = { { 0.05f, 0.05f, 0.05f, 1.0f } };
+
 void framebufferSizeCallback(GLFWwindow* window, int width, int height)
 {
   MirrorView* mirrorView = reinterpret_cast<MirrorView*>(glfwGetWindowUserPointer(window));
@@ -80,6 +85,14 @@ MirrorView::MirrorView(const Context* context) : context(context)
 
 MirrorView::~MirrorView()
 {
+  const VkDevice vkDevice = context->getVkDevice();
+  delete idleRenderGraph;
+  vkDestroyFence(vkDevice, idleFence, nullptr);
+  vkDestroySemaphore(vkDevice, idlePresentableSemaphore, nullptr);
+  vkDestroySemaphore(vkDevice, idleDrawableSemaphore, nullptr);
+  vkDestroyCommandPool(vkDevice, idleCommandPool, nullptr);
+
+  delete renderGraph;
   vkDestroySwapchainKHR(context->getVkDevice(), swapchain, nullptr);
   vkDestroySurfaceKHR(context->getVkInstance(), surface, nullptr);
 
@@ -102,87 +115,131 @@ bool MirrorView::connect(const Headset* headset, const Renderer* renderer)
     return false;
   }
 
+  // Create a render graph that blits one eye into the mirror view, the scene leaves the eye as a color attachment
+  renderGraph = new RenderGraph(context);
+  eyeImageResource =
+    renderGraph->importImage("Eye", VK_IMAGE_ASPECT_COLOR_BIT, static_cast<uint32_t>(mirrorEyeIndex), 1u,
+                             RenderGraph::Access::ColorAttachmentWrite, true,
+                             RenderGraph::Access::ColorAttachmentWrite);
+
+  // The acquire semaphore is waited for at the color attachment output stage, which the first barrier chains to
+  mirrorImageResource =
+    renderGraph->importImage("Mirror", VK_IMAGE_ASPECT_COLOR_BIT, 0u, 1u, RenderGraph::Access::ColorAttachmentWrite,
+                             false, RenderGraph::Access::Present);
+
+  const size_t blitPass =
+    renderGraph->addPass("Blit", [this](VkCommandBuffer commandBuffer) { recordBlit(commandBuffer); });
+  renderGraph->read(blitPass, eyeImageResource, RenderGraph::Access::TransferRead);
+  renderGraph->write(blitPass, mirrorImageResource, RenderGraph::Access::TransferWrite);
+
+  if (!renderGraph->compile())
+  {
+    return false;
+  }
+
+  const VkDevice vkDevice = context->getVkDevice();
+
+  // Create a command pool with a command buffer for the idle frames
+  VkCommandPoolCreateInfo commandPoolCreateInfo{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+  commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  commandPoolCreateInfo.queueFamilyIndex = context->getVkDrawQueueFamilyIndex();
+  if (vkCreateCommandPool(vkDevice, &commandPoolCreateInfo, nullptr, &idleCommandPool) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return false;
+  }
+
+  VkCommandBufferAllocateInfo commandBufferAllocateInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+  commandBufferAllocateInfo.commandPool = idleCommandPool;
+  commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+  commandBufferAllocateInfo.commandBufferCount = 1u;
+  if (vkAllocateCommandBuffers(vkDevice, &commandBufferAllocateInfo, &idleCommandBuffer) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return false;
+  }
+
+  // Create the semaphores and a signaled fence for the idle frames
+  VkSemaphoreCreateInfo semaphoreCreateInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+  if (vkCreateSemaphore(vkDevice, &semaphoreCreateInfo, nullptr, &idleDrawableSemaphore) != VK_SUCCESS ||
+      vkCreateSemaphore(vkDevice, &semaphoreCreateInfo, nullptr, &idlePresentableSemaphore) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return false;
+  }
+
+  VkFenceCreateInfo fenceCreateInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+  fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+  if (vkCreateFence(vkDevice, &fenceCreateInfo, nullptr, &idleFence) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return false;
+  }
+
+  // Create a render graph that clears the mirror view
+  idleRenderGraph = new RenderGraph(context);
+  idleMirrorImageResource =
+    idleRenderGraph->importImage("Mirror", VK_IMAGE_ASPECT_COLOR_BIT, 0u, 1u,
+                                 RenderGraph::Access::ColorAttachmentWrite, false, RenderGraph::Access::Present);
+
+  const size_t clearPass =
+    idleRenderGraph->addPass("Clear", [this](VkCommandBuffer commandBuffer) { recordIdleClear(commandBuffer); });
+  idleRenderGraph->write(clearPass, idleMirrorImageResource, RenderGraph::Access::TransferWrite);
+
+  if (!idleRenderGraph->compile())
+  {
+    return false;
+  }
+
   return true;
 }
 
+bool MirrorView::updateSwapchain()
+{
+  // Recreate an outdated swapchain, and check for maximizing as long as the window is minimized
+  const bool minimized = (swapchainResolution.width == 0u || swapchainResolution.height == 0u);
+  if (!swapchainOutdated && !(minimized && resizeDetected))
+  {
+    return true;
+  }
+
+  swapchainOutdated = resizeDetected = false;
+  return recreateSwapchain();
+}
+
 void MirrorView::processWindowEvents() const
 {
   glfwPollEvents();
 }
 
+void MirrorView::waitWindowEvents(float timeout) const
+{
+  glfwWaitEventsTimeout(static_cast<double>(timeout));
+}
+
 MirrorView::RenderResult MirrorView::render(uint32_t swapchainImageIndex)
 {
-  if (swapchainResolution.width == 0u || swapchainResolution.height == 0u)
+  const RenderResult result = acquireImage(renderer->getCurrentDrawableSemaphore());
+  if (result != RenderResult::Visible)
   {
-    // Just check for maximizing as long as the window is minimized
-    if (resizeDetected)
-    {
-      resizeDetected = false;
-      if (!recreateSwapchain())
-      {
-        return RenderResult::Error;
-      }
-    }
-    else
-    {
-      // Otherwise skip minimized frames
-      return RenderResult::Invisible;
-    }
+    return result;
   }
 
-  const VkResult result =
-    vkAcquireNextImageKHR(context->getVkDevice(), swapchain, UINT64_MAX, renderer->getCurrentDrawableSemaphore(),
-                          VK_NULL_HANDLE, &destinationImageIndex);
-  if (result == VK_ERROR_OUT_OF_DATE_KHR)
-  {
-    // Recreate the swapchain and then stop rendering this frame as it is out of date already
-    if (!recreateSwapchain())
-    {
-      return RenderResult::Error;
-    }
+  // The render graph transitions both images around the blit
+  const RenderTarget* renderTarget = headset->getRenderTarget(swapchainImageIndex);
+  renderGraph->setImage(eyeImageResource, renderTarget->getImage(), renderTarget->getImageView());
+  renderGraph->setImage(mirrorImageResource, swapchainImages.at(destinationImageIndex), nullptr);
+  renderGraph->execute(renderer->getCurrentCommandBuffer());
 
-    return RenderResult::Invisible;
-  }
-  else if (result != VK_SUBOPTIMAL_KHR && result != VK_SUCCESS)
-  {
-    // Treat a suboptimal like a successful frame
-    return RenderResult::Invisible;
-  }
+  return RenderResult::Visible;
+}
 
-  const VkCommandBuffer commandBuffer = renderer->getCurrentCommandBuffer();
-  const VkImage sourceImage = headset->getRenderTarget(swapchainImageIndex)->getImage();
-  const VkImage destinationImage = swapchainImages.at(destinationImageIndex);
+void MirrorView::recordBlit(VkCommandBuffer commandBuffer) const
+{
+  const VkImage sourceImage = renderGraph->getImage(eyeImageResource);
+  const VkImage destinationImage = renderGraph->getImage(mirrorImageResource);
   const VkExtent2D eyeResolution = headset->getEyeResolution(mirrorEyeIndex);
 
-  // Convert the source image layout from undefined to transfer source
-  VkImageMemoryBarrier imageMemoryBarrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
-  imageMemoryBarrier.image = sourceImage;
-  imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-  imageMemoryBarrier.srcAccessMask = 0u;
-  imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-  imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  imageMemoryBarrier.subresourceRange.layerCount = 1u;
-  imageMemoryBarrier.subresourceRange.baseArrayLayer = mirrorEyeIndex;
-  imageMemoryBarrier.subresourceRange.levelCount = 1u;
-  imageMemoryBarrier.subresourceRange.baseMipLevel = 0u;
-  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0u, 0u, nullptr,
-                       0u, nullptr, 1u, &imageMemoryBarrier);
-
-  // Convert the destination image layout from undefined to transfer destination
-  imageMemoryBarrier.image = destinationImage;
-  imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-  imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  imageMemoryBarrier.srcAccessMask = 0u;
-  imageMemoryBarrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  imageMemoryBarrier.subresourceRange.layerCount = 1u;
-  imageMemoryBarrier.subresourceRange.baseArrayLayer = 0u;
-  imageMemoryBarrier.subresourceRange.levelCount = 1u;
-  imageMemoryBarrier.subresourceRange.baseMipLevel = 0u;
-  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0u, 0u, nullptr,
-                       0u, nullptr, 1u, &imageMemoryBarrier);
-
   // We need to crop the source image region to preserve the aspect ratio of the mirror view window
   const glm::vec2 sourceResolution = { static_cast<float>(eyeResolution.width),
                                        static_cast<float>(eyeResolution.height) };
@@ -223,62 +280,79 @@ MirrorView::RenderResult MirrorView::render(uint32_t swapchainImageIndex)
 
   vkCmdBlitImage(commandBuffer, sourceImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, destinationImage,
                  VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1u, &imageBlit, VK_FILTER_NEAREST);
-
-  // Convert the source image layout from transfer source to color attachment
-  imageMemoryBarrier.image = sourceImage;
-  imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-  imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-  imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-  imageMemoryBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-  imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  imageMemoryBarrier.subresourceRange.layerCount = 1u;
-  imageMemoryBarrier.subresourceRange.baseArrayLayer = mirrorEyeIndex;
-  imageMemoryBarrier.subresourceRange.levelCount = 1u;
-  imageMemoryBarrier.subresourceRange.baseMipLevel = 0u;
-  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0u,
-                       0u, nullptr, 0u, nullptr, 1u, &imageMemoryBarrier);
-
-  // Convert the destination image layout from transfer destination to present
-  imageMemoryBarrier.image = destinationImage;
-  imageMemoryBarrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-  imageMemoryBarrier.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-  imageMemoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-  imageMemoryBarrier.dstAccessMask = 0u;
-  imageMemoryBarrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  imageMemoryBarrier.subresourceRange.layerCount = 1u;
-  imageMemoryBarrier.subresourceRange.baseArrayLayer = 0u;
-  imageMemoryBarrier.subresourceRange.levelCount = 1u;
-  imageMemoryBarrier.subresourceRange.baseMipLevel = 0u;
-  vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0u, 0u, nullptr,
-                       0u, nullptr, 1u, &imageMemoryBarrier);
-
-  return RenderResult::Visible;
 }
 
 void MirrorView::present()
 {
-  const VkSemaphore presentableSemaphore = renderer->getCurrentPresentableSemaphore();
+  presentImage(renderer->getCurrentPresentableSemaphore());
+}
 
-  VkPresentInfoKHR presentInfo{ VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
-  presentInfo.waitSemaphoreCount = 1u;
-  presentInfo.pWaitSemaphores = &presentableSemaphore;
-  presentInfo.swapchainCount = 1u;
-  presentInfo.pSwapchains = &swapchain;
-  presentInfo.pImageIndices = &destinationImageIndex;
+MirrorView::RenderResult MirrorView::renderIdle()
+{
+  // Only refresh the mirror view at a low rate
+  const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (now - idleRenderTime < idleRenderInterval)
+  {
+    return RenderResult::Invisible;
+  }
+  idleRenderTime = now;
 
-  const VkResult result = vkQueuePresentKHR(context->getVkPresentQueue(), &presentInfo);
-  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+  // Wait for the last idle frame before reusing its command buffer
+  const VkDevice vkDevice = context->getVkDevice();
+  if (vkWaitForFences(vkDevice, 1u, &idleFence, VK_TRUE, UINT64_MAX) != VK_SUCCESS)
   {
-    // Recreate the swapchain for the next frame if necessary
-    if (!recreateSwapchain())
-    {
-      return;
-    }
+    util::error(Error::GenericVulkan);
+    return RenderResult::Error;
   }
-  else if (result != VK_SUCCESS)
+
+  const RenderResult result = acquireImage(idleDrawableSemaphore);
+  if (result != RenderResult::Visible)
   {
-    return;
+    return result;
+  }
+
+  if (vkResetFences(vkDevice, 1u, &idleFence) != VK_SUCCESS ||
+      vkResetCommandBuffer(idleCommandBuffer, 0u) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return RenderResult::Error;
+  }
+
+  VkCommandBufferBeginInfo commandBufferBeginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+  commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(idleCommandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return RenderResult::Error;
+  }
+
+  idleRenderGraph->setImage(idleMirrorImageResource, swapchainImages.at(destinationImageIndex), nullptr);
+  idleRenderGraph->execute(idleCommandBuffer);
+
+  if (vkEndCommandBuffer(idleCommandBuffer) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return RenderResult::Error;
   }
+
+  // The render graph chains its first barrier to the color attachment output stage like the blit does
+  const VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+  VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+  submitInfo.waitSemaphoreCount = 1u;
+  submitInfo.pWaitSemaphores = &idleDrawableSemaphore;
+  submitInfo.pWaitDstStageMask = &waitStage;
+  submitInfo.commandBufferCount = 1u;
+  submitInfo.pCommandBuffers = &idleCommandBuffer;
+  submitInfo.signalSemaphoreCount = 1u;
+  submitInfo.pSignalSemaphores = &idlePresentableSemaphore;
+  if (vkQueueSubmit(context->getVkDrawQueue(), 1u, &submitInfo, idleFence) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return RenderResult::Error;
+  }
+
+  presentImage(idlePresentableSemaphore);
+  return RenderResult::Visible;
 }
 
 bool MirrorView::isValid() const
@@ -286,6 +360,11 @@ bool MirrorView::isValid() const
   return valid;
 }
 
+float MirrorView::getAcquireTime() const
+{
+  return acquireTime;
+}
+
 bool MirrorView::isExitRequested() const
 {
   return static_cast<bool>(glfwWindowShouldClose(window));
@@ -423,4 +502,61 @@ bool MirrorView::recreateSwapchain()
   }
 
   return true;
+}
+
+MirrorView::RenderResult MirrorView::acquireImage(VkSemaphore drawableSemaphore)
+{
+  acquireTime = 0.0f;
+
+  // Skip minimized frames and frames until an outdated swapchain is recreated
+  if (swapchainOutdated || swapchainResolution.width == 0u || swapchainResolution.height == 0u)
+  {
+    return RenderResult::Invisible;
+  }
+
+  const std::chrono::steady_clock::time_point acquireBegin = std::chrono::steady_clock::now();
+  const VkResult result = vkAcquireNextImageKHR(context->getVkDevice(), swapchain, UINT64_MAX, drawableSemaphore,
+                                                VK_NULL_HANDLE, &destinationImageIndex);
+  acquireTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - acquireBegin).count();
+  if (result == VK_ERROR_OUT_OF_DATE_KHR)
+  {
+    // Have the swapchain recreated and stop rendering this frame as it is out of date already
+    swapchainOutdated = true;
+    return RenderResult::Invisible;
+  }
+  else if (result != VK_SUBOPTIMAL_KHR && result != VK_SUCCESS)
+  {
+    // Treat a suboptimal like a successful frame
+    return RenderResult::Invisible;
+  }
+
+  return RenderResult::Visible;
+}
+
+void MirrorView::presentImage(VkSemaphore presentableSemaphore)
+{
+  VkPresentInfoKHR presentInfo{ VK_STRUCTURE_TYPE_PRESENT_INFO_KHR };
+  presentInfo.waitSemaphoreCount = 1u;
+  presentInfo.pWaitSemaphores = &presentableSemaphore;
+  presentInfo.swapchainCount = 1u;
+  presentInfo.pSwapchains = &swapchain;
+  presentInfo.pImageIndices = &destinationImageIndex;
+
+  const VkResult result = vkQueuePresentKHR(context->getVkPresentQueue(), &presentInfo);
+  if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR)
+  {
+    // Have the swapchain recreated for the next frame if necessary
+    swapchainOutdated = true;
+  }
+}
+
+void MirrorView::recordIdleClear(VkCommandBuffer commandBuffer) const
+{
+  VkImageSubresourceRange imageSubresourceRange{};
+  imageSubresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+  imageSubresourceRange.levelCount = 1u;
+  imageSubresourceRange.layerCount = 1u;
+
+  vkCmdClearColorImage(commandBuffer, idleRenderGraph->getImage(idleMirrorImageResource),
+                       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &idleClearColor, 1u, &imageSubresourceRange);
 }
\ No newline at end of file
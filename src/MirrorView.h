@@ -2,11 +2,13 @@
 
 #include <vulkan/vulkan.h>
 
+#include <chrono>
 #include <vector>
 
 class Context;
 struct GLFWwindow;
 class Headset;
+class RenderGraph;
 class Renderer;
 
 class MirrorView final
@@ -18,7 +20,9 @@ public:
   void onWindowResize();
 
   bool connect(const Headset* headset, const Renderer* renderer);
+  bool updateSwapchain(); // Recreates the swapchain if needed, only on the main thread between frames
   void processWindowEvents() const;
+  void waitWindowEvents(float timeout) const; // In seconds, blocks until an event arrives or the timeout passes
 
   enum class RenderResult
   {
@@ -29,9 +33,14 @@ public:
   RenderResult render(uint32_t swapchainImageIndex);
   void present();
 
+  // Clears and presents the mirror view at a low rate on its own while the headset is not rendering, skipped calls
+  // return invisible
+  RenderResult renderIdle();
+
   bool isValid() const;
   bool isExitRequested() const;
   VkSurfaceKHR getSurface() const;
+  float getAcquireTime() const; // In seconds, spent waiting for a swapchain image in the last rendered frame
 
 private:
   bool valid = true;
@@ -48,7 +57,25 @@ private:
   VkExtent2D swapchainResolution = { 0u, 0u };
 
   uint32_t destinationImageIndex = 0u;
-  bool resizeDetected = false;
+  float acquireTime = 0.0f;
+  bool resizeDetected = false;    // Set by the window events
+  bool swapchainOutdated = false; // Set by the render thread, the main thread recreates the swapchain between frames
+
+  RenderGraph* renderGraph = nullptr;
+  size_t eyeImageResource = 0u, mirrorImageResource = 0u;
+
+  // Only used while the headset is not rendering
+  VkCommandPool idleCommandPool = nullptr;
+  VkCommandBuffer idleCommandBuffer = nullptr;
+  VkSemaphore idleDrawableSemaphore = nullptr, idlePresentableSemaphore = nullptr;
+  VkFence idleFence = nullptr; // Signaled once the last idle frame is done
+  RenderGraph* idleRenderGraph = nullptr;
+  size_t idleMirrorImageResource = 0u;
+  std::chrono::steady_clock::time_point idleRenderTime;
 
   bool recreateSwapchain();
+  RenderResult acquireImage(VkSemaphore drawableSemaphore); // Visible once an image is acquired
+  void presentImage(VkSemaphore presentableSemaphore);
+  void recordBlit(VkCommandBuffer commandBuffer) const;
+  void recordIdleClear(VkCommandBuffer commandBuffer) const;
 };
\ No newline at end of file
@@ -1,47 +1,35 @@
 #include "Pipeline.h"
 
+#include "DynamicState.h"
 #include "Util.h"
 
-#include <array>
-#include <sstream>
+#include <chrono>
+#include <iostream>
 
 Pipeline::Pipeline(VkDevice device,
+                   VkPipelineCache pipelineCache,
                    VkPipelineLayout pipelineLayout,
                    VkRenderPass renderPass,
-                   const std::string& vertexFilename,
-                   const std::string& fragmentFilename,
+                   const RenderingFormats& renderingFormats,
+                   VkShaderModule vertexShaderModule,
+                   const VkSpecializationInfo* vertexSpecializationInfo,
+                   VkShaderModule fragmentShaderModule,
+                   const VkSpecializationInfo* fragmentSpecializationInfo,
                    const std::vector<VkVertexInputBindingDescription>& vertexInputBindingDescriptions,
-                   const std::vector<VkVertexInputAttributeDescription>& vertexInputAttributeDescriptions)
-: device(device)
+                   const std::vector<VkVertexInputAttributeDescription>& vertexInputAttributeDescriptions,
+                   const RenderState& renderState,
+                   const std::vector<VkDynamicState>& dynamicStates,
+                   VkGraphicsPipelineLibraryFlagsEXT libraryParts,
+                   bool creationFeedback)
+: device(device), creationFeedback(creationFeedback)
 {
-  // Load the vertex shader
-  VkShaderModule vertexShaderModule;
-  if (!util::loadShaderFromFile(device, vertexFilename, vertexShaderModule))
-  {
-    std::stringstream s;
-    s << "Vertex shader \"" << vertexFilename << "\"";
-    util::error(Error::FileMissing, s.str().c_str());
-    valid = false;
-    return;
-  }
-
-  // Load the fragment shader
-  VkShaderModule fragmentShaderModule;
-  if (!util::loadShaderFromFile(device, fragmentFilename, fragmentShaderModule))
-  {
-    std::stringstream s;
-    s << "Fragment shader \"" << fragmentFilename << "\"";
-    util::error(Error::FileMissing, s.str().c_str());
-    valid = false;
-    return;
-  }
-
   VkPipelineShaderStageCreateInfo pipelineShaderStageCreateInfoVertex{
     VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO
   };
   pipelineShaderStageCreateInfoVertex.module = vertexShaderModule;
   pipelineShaderStageCreateInfoVertex.stage = VK_SHADER_STAGE_VERTEX_BIT;
   pipelineShaderStageCreateInfoVertex.pName = "main";
+  pipelineShaderStageCreateInfoVertex.pSpecializationInfo = vertexSpecializationInfo;
 
   VkPipelineShaderStageCreateInfo pipelineShaderStageCreateInfoFragment{
     VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO
@@ -49,8 +37,19 @@ Pipeline::Pipeline(VkDevice device,
   pipelineShaderStageCreateInfoFragment.module = fragmentShaderModule;
   pipelineShaderStageCreateInfoFragment.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
   pipelineShaderStageCreateInfoFragment.pName = "main";
+  pipelineShaderStageCreateInfoFragment.pSpecializationInfo = fragmentSpecializationInfo;
+
+  // A library only contains the shader stages of its parts
+  std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
+  if (!libraryParts || (libraryParts & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT))
+  {
+    shaderStages.push_back(pipelineShaderStageCreateInfoVertex);
+  }
 
-  const std::array shaderStages = { pipelineShaderStageCreateInfoVertex, pipelineShaderStageCreateInfoFragment };
+  if (!libraryParts || (libraryParts & VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT))
+  {
+    shaderStages.push_back(pipelineShaderStageCreateInfoFragment);
+  }
 
   VkPipelineVertexInputStateCreateInfo pipelineVertexInputStateCreateInfo{
     VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO
@@ -66,7 +65,8 @@ Pipeline::Pipeline(VkDevice device,
   VkPipelineInputAssemblyStateCreateInfo pipelineInputAssemblyStateCreateInfo{
     VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO
   };
-  pipelineInputAssemblyStateCreateInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+  pipelineInputAssemblyStateCreateInfo.topology = renderState.topology;
+  pipelineInputAssemblyStateCreateInfo.primitiveRestartEnable = renderState.primitiveRestart ? VK_TRUE : VK_FALSE;
 
   VkPipelineViewportStateCreateInfo pipelineViewportStateCreateInfo{
     VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO
@@ -79,7 +79,8 @@ Pipeline::Pipeline(VkDevice device,
   };
   pipelineRasterizationStateCreateInfo.polygonMode = VK_POLYGON_MODE_FILL;
   pipelineRasterizationStateCreateInfo.lineWidth = 1.0f;
-  pipelineRasterizationStateCreateInfo.cullMode = VK_CULL_MODE_NONE;
+  pipelineRasterizationStateCreateInfo.cullMode = renderState.cullMode;
+  pipelineRasterizationStateCreateInfo.frontFace = renderState.frontFace;
 
   VkPipelineMultisampleStateCreateInfo pipelineMultisampleStateCreateInfo{
     VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO
@@ -92,7 +93,7 @@ Pipeline::Pipeline(VkDevice device,
   VkPipelineColorBlendAttachmentState pipelineColorBlendAttachmentState{};
   pipelineColorBlendAttachmentState.colorWriteMask =
     VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-  pipelineColorBlendAttachmentState.blendEnable = VK_TRUE;
+  pipelineColorBlendAttachmentState.blendEnable = renderState.blend ? VK_TRUE : VK_FALSE;
   pipelineColorBlendAttachmentState.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
   pipelineColorBlendAttachmentState.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
   pipelineColorBlendAttachmentState.colorBlendOp = VK_BLEND_OP_ADD;
@@ -106,16 +107,15 @@ Pipeline::Pipeline(VkDevice device,
   VkPipelineDynamicStateCreateInfo pipelineDynamicStateCreateInfo{
     VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO
   };
-  const std::array dynamicStates = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
   pipelineDynamicStateCreateInfo.dynamicStateCount = static_cast<uint32_t>(dynamicStates.size());
   pipelineDynamicStateCreateInfo.pDynamicStates = dynamicStates.data();
 
   VkPipelineDepthStencilStateCreateInfo pipelineDepthStencilStateCreateInfo{
     VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO
   };
-  pipelineDepthStencilStateCreateInfo.depthTestEnable = VK_TRUE;
-  pipelineDepthStencilStateCreateInfo.depthWriteEnable = VK_TRUE;
-  pipelineDepthStencilStateCreateInfo.depthCompareOp = VK_COMPARE_OP_LESS;
+  pipelineDepthStencilStateCreateInfo.depthTestEnable = renderState.depthTest ? VK_TRUE : VK_FALSE;
+  pipelineDepthStencilStateCreateInfo.depthWriteEnable = renderState.depthWrite ? VK_TRUE : VK_FALSE;
+  pipelineDepthStencilStateCreateInfo.depthCompareOp = renderState.depthCompareOp;
 
   VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
   graphicsPipelineCreateInfo.layout = pipelineLayout;
@@ -130,16 +130,156 @@ Pipeline::Pipeline(VkDevice device,
   graphicsPipelineCreateInfo.pDynamicState = &pipelineDynamicStateCreateInfo;
   graphicsPipelineCreateInfo.pDepthStencilState = &pipelineDepthStencilStateCreateInfo;
   graphicsPipelineCreateInfo.renderPass = renderPass;
-  if (vkCreateGraphicsPipelines(device, nullptr, 1u, &graphicsPipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS)
+
+  // Ask the driver how long the pipeline took to create and whether it came from the pipeline cache
+  VkPipelineCreationFeedbackEXT pipelineCreationFeedback{};
+  std::vector<VkPipelineCreationFeedbackEXT> pipelineStageCreationFeedbacks(shaderStages.size()); // One per stage
+  VkPipelineCreationFeedbackCreateInfoEXT pipelineCreationFeedbackCreateInfo{
+    VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT
+  };
+  pipelineCreationFeedbackCreateInfo.pPipelineCreationFeedback = &pipelineCreationFeedback;
+  pipelineCreationFeedbackCreateInfo.pipelineStageCreationFeedbackCount =
+    static_cast<uint32_t>(pipelineStageCreationFeedbacks.size());
+  pipelineCreationFeedbackCreateInfo.pPipelineStageCreationFeedbacks = pipelineStageCreationFeedbacks.data();
+  if (creationFeedback)
+  {
+    graphicsPipelineCreateInfo.pNext = &pipelineCreationFeedbackCreateInfo;
+  }
+
+  // Only create the given parts as a library that is linked into complete pipelines later, keeping the information
+  // needed for a link time optimized link
+  VkGraphicsPipelineLibraryCreateInfoEXT graphicsPipelineLibraryCreateInfo{
+    VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT
+  };
+  if (libraryParts)
+  {
+    graphicsPipelineLibraryCreateInfo.flags = libraryParts;
+    graphicsPipelineLibraryCreateInfo.pNext = creationFeedback ? &pipelineCreationFeedbackCreateInfo : nullptr;
+    graphicsPipelineCreateInfo.pNext = &graphicsPipelineLibraryCreateInfo;
+    graphicsPipelineCreateInfo.flags =
+      VK_PIPELINE_CREATE_LIBRARY_BIT_KHR | VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+  }
+
+  // Without a render pass the attachment formats and view mask are given directly
+  VkPipelineRenderingCreateInfoKHR pipelineRenderingCreateInfo{ VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO_KHR };
+  if (!renderPass)
+  {
+    pipelineRenderingCreateInfo.viewMask = renderingFormats.viewMask;
+    pipelineRenderingCreateInfo.colorAttachmentCount = 1u;
+    pipelineRenderingCreateInfo.pColorAttachmentFormats = &renderingFormats.colorFormat;
+    pipelineRenderingCreateInfo.depthAttachmentFormat = renderingFormats.depthFormat;
+    pipelineRenderingCreateInfo.pNext = graphicsPipelineCreateInfo.pNext;
+    graphicsPipelineCreateInfo.pNext = &pipelineRenderingCreateInfo;
+  }
+
+  const std::chrono::steady_clock::time_point creationBegin = std::chrono::steady_clock::now();
+  if (vkCreateGraphicsPipelines(device, pipelineCache, 1u, &graphicsPipelineCreateInfo, nullptr, &pipeline) !=
+      VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    valid = false;
+    return;
+  }
+
+  readCreationFeedback(pipelineCreationFeedback,
+                       std::chrono::duration<float>(std::chrono::steady_clock::now() - creationBegin).count());
+}
+
+Pipeline::Pipeline(VkDevice device,
+                   VkPipelineCache pipelineCache,
+                   VkPipelineLayout pipelineLayout,
+                   VkShaderModule computeShaderModule,
+                   const VkSpecializationInfo* computeSpecializationInfo,
+                   bool creationFeedback)
+: device(device), bindPoint(VK_PIPELINE_BIND_POINT_COMPUTE), creationFeedback(creationFeedback)
+{
+  VkPipelineShaderStageCreateInfo pipelineShaderStageCreateInfoCompute{
+    VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO
+  };
+  pipelineShaderStageCreateInfoCompute.module = computeShaderModule;
+  pipelineShaderStageCreateInfoCompute.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+  pipelineShaderStageCreateInfoCompute.pName = "main";
+  pipelineShaderStageCreateInfoCompute.pSpecializationInfo = computeSpecializationInfo;
+
+  VkComputePipelineCreateInfo computePipelineCreateInfo{ VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+  computePipelineCreateInfo.layout = pipelineLayout;
+  computePipelineCreateInfo.stage = pipelineShaderStageCreateInfoCompute;
+
+  // Ask the driver how long the pipeline took to create and whether it came from the pipeline cache
+  VkPipelineCreationFeedbackEXT pipelineCreationFeedback{}, pipelineStageCreationFeedback{};
+  VkPipelineCreationFeedbackCreateInfoEXT pipelineCreationFeedbackCreateInfo{
+    VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT
+  };
+  pipelineCreationFeedbackCreateInfo.pPipelineCreationFeedback = &pipelineCreationFeedback;
+  pipelineCreationFeedbackCreateInfo.pipelineStageCreationFeedbackCount = 1u;
+  pipelineCreationFeedbackCreateInfo.pPipelineStageCreationFeedbacks = &pipelineStageCreationFeedback;
+  if (creationFeedback)
+  {
+    computePipelineCreateInfo.pNext = &pipelineCreationFeedbackCreateInfo;
+  }
+
+  const std::chrono::steady_clock::time_point creationBegin = std::chrono::steady_clock::now();
+  if (vkCreateComputePipelines(device, pipelineCache, 1u, &computePipelineCreateInfo, nullptr, &pipeline) !=
+      VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    valid = false;
+    return;
+  }
+
+  readCreationFeedback(pipelineCreationFeedback,
+                       std::chrono::duration<float>(std::chrono::steady_clock::now() - creationBegin).count());
+}
+
+Pipeline::Pipeline(VkDevice device,
+                   VkPipelineCache pipelineCache,
+                   VkPipelineLayout pipelineLayout,
+                   const std::vector<const Pipeline*>& libraries,
+                   bool linkTimeOptimization,
+                   bool creationFeedback)
+: device(device), creationFeedback(creationFeedback)
+{
+  std::vector<VkPipeline> libraryPipelines;
+  for (const Pipeline* library : libraries)
+  {
+    libraryPipelines.push_back(library->pipeline);
+  }
+
+  VkPipelineLibraryCreateInfoKHR pipelineLibraryCreateInfo{ VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR };
+  pipelineLibraryCreateInfo.libraryCount = static_cast<uint32_t>(libraryPipelines.size());
+  pipelineLibraryCreateInfo.pLibraries = libraryPipelines.data();
+
+  // A link without optimization only stitches the compiled parts together and is fast enough for the frame loop
+  VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo{ VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+  graphicsPipelineCreateInfo.pNext = &pipelineLibraryCreateInfo;
+  graphicsPipelineCreateInfo.layout = pipelineLayout;
+  if (linkTimeOptimization)
+  {
+    graphicsPipelineCreateInfo.flags = VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT;
+  }
+
+  // Ask the driver how long the link took and whether it came from the pipeline cache
+  VkPipelineCreationFeedbackEXT pipelineCreationFeedback{};
+  VkPipelineCreationFeedbackCreateInfoEXT pipelineCreationFeedbackCreateInfo{
+    VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO_EXT
+  };
+  pipelineCreationFeedbackCreateInfo.pPipelineCreationFeedback = &pipelineCreationFeedback;
+  if (creationFeedback)
+  {
+    pipelineLibraryCreateInfo.pNext = &pipelineCreationFeedbackCreateInfo;
+  }
+
+  const std::chrono::steady_clock::time_point creationBegin = std::chrono::steady_clock::now();
+  if (vkCreateGraphicsPipelines(device, pipelineCache, 1u, &graphicsPipelineCreateInfo, nullptr, &pipeline) !=
+      VK_SUCCESS)
   {
     util::error(Error::GenericVulkan);
     valid = false;
     return;
   }
 
-  // These shader modules can now be destroyed
-  vkDestroyShaderModule(device, vertexShaderModule, nullptr);
-  vkDestroyShaderModule(device, fragmentShaderModule, nullptr);
+  readCreationFeedback(pipelineCreationFeedback,
+                       std::chrono::duration<float>(std::chrono::steady_clock::now() - creationBegin).count());
 }
 
 Pipeline::~Pipeline()
@@ -149,10 +289,43 @@ Pipeline::~Pipeline()
 
 void Pipeline::bind(VkCommandBuffer commandBuffer) const
 {
-  vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+  vkCmdBindPipeline(commandBuffer, bindPoint, pipeline);
+}
+
+void Pipeline::report(const std::string& name) const
+{
+  std::cout << "Pipeline \"" << name << "\": " << creationTime * 1000.0f << " ms";
+  if (creationFeedback)
+  {
+    std::cout << (cacheHit ? ", cache hit" : ", cache miss");
+  }
+  std::cout << "\n";
 }
 
 bool Pipeline::isValid() const
 {
   return valid;
+}
+
+float Pipeline::getCreationTime() const
+{
+  return creationTime;
+}
+
+bool Pipeline::isCacheHit() const
+{
+  return cacheHit;
+}
+
+void Pipeline::readCreationFeedback(const VkPipelineCreationFeedbackEXT& feedback, float measuredCreationTime)
+{
+  // Fall back to the time measured on the CPU if the driver did not provide any feedback
+  if (!(feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT_EXT))
+  {
+    creationTime = measuredCreationTime;
+    return;
+  }
+
+  creationTime = static_cast<float>(feedback.duration) * 1e-9f;
+  cacheHit = (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT_EXT) != 0u;
 }
\ No newline at end of file
@@ -5,25 +5,62 @@
 #include <string>
 #include <vector>
 
+struct RenderState;
+
+// The attachments a graphics pipeline renders to with dynamic rendering, where there is no render pass to describe them
+struct RenderingFormats final
+{
+  uint32_t viewMask = 0u;
+  VkFormat colorFormat = VK_FORMAT_UNDEFINED, depthFormat = VK_FORMAT_UNDEFINED;
+};
+
 class Pipeline final
 {
 public:
   Pipeline(VkDevice device,
+           VkPipelineCache pipelineCache,
            VkPipelineLayout pipelineLayout,
            VkRenderPass renderPass,
-           const std::string& vertexFilename,
-           const std::string& fragmentFilename,
+           const RenderingFormats& renderingFormats, // Only used without a render pass
+           VkShaderModule vertexShaderModule,
+           const VkSpecializationInfo* vertexSpecializationInfo,
+           VkShaderModule fragmentShaderModule,
+           const VkSpecializationInfo* fragmentSpecializationInfo,
            const std::vector<VkVertexInputBindingDescription>& vertexInputBindingDescriptions,
-           const std::vector<VkVertexInputAttributeDescription>& vertexInputAttributeDescriptions);
+           const std::vector<VkVertexInputAttributeDescription>& vertexInputAttributeDescriptions,
+           const RenderState& renderState,
+           const std::vector<VkDynamicState>& dynamicStates,
+           VkGraphicsPipelineLibraryFlagsEXT libraryParts, // Zero for a complete pipeline
+           bool creationFeedback);
+  Pipeline(VkDevice device,
+           VkPipelineCache pipelineCache,
+           VkPipelineLayout pipelineLayout,
+           const std::vector<const Pipeline*>& libraries, // Together they have to cover all parts
+           bool linkTimeOptimization,
+           bool creationFeedback);
+  Pipeline(VkDevice device,
+           VkPipelineCache pipelineCache,
+           VkPipelineLayout pipelineLayout,
+           VkShaderModule computeShaderModule,
+           const VkSpecializationInfo* computeSpecializationInfo,
+           bool creationFeedback);
   ~Pipeline();
 
   void bind(VkCommandBuffer commandBuffer) const;
+  void report(const std::string& name) const; // Prints the creation time and whether the cache was hit
 
   bool isValid() const;
+  float getCreationTime() const; // In seconds, reported by the driver if creation feedback is enabled
+  bool isCacheHit() const;       // Only known if creation feedback is enabled
 
 private:
   bool valid = true;
 
   VkDevice device = nullptr;
   VkPipeline pipeline = nullptr;
+  VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+  float creationTime = 0.0f;
+  bool creationFeedback = false, cacheHit = false;
+
+  void readCreationFeedback(const VkPipelineCreationFeedbackEXT& feedback, float measuredCreationTime);
 };
\ No newline at end of file
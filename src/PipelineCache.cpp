@@ -0,0 +1,159 @@
+#include "PipelineCache.h"
+
+#include "Util.h"
+
+#include <vulkan/vk_enum_string_helper.h>
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+constexpr uint32_t fileMagic = 0x48435058u; // "XPCH"
+constexpr uint32_t fileVersion = 1u;
+
+// Written in front of the pipeline cache data to detect other drivers, truncated files and corruption
+struct FileHeader final
+{
+  uint32_t magic, version;
+  uint8_t driverUuid[VK_UUID_SIZE];
+  uint64_t dataSize, dataHash;
+};
+} // namespace
+
+PipelineCache::PipelineCache(VkDevice device, VkPhysicalDevice physicalDevice, const std::string& filename)
+: device(device), filename(filename)
+{
+  // Get the identity of the device and driver that cache data has to match
+  VkPhysicalDeviceIDProperties physicalDeviceIdProperties{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES };
+  VkPhysicalDeviceProperties2 physicalDeviceProperties2{ VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+  physicalDeviceProperties2.pNext = &physicalDeviceIdProperties;
+  vkGetPhysicalDeviceProperties2(physicalDevice, &physicalDeviceProperties2);
+  physicalDeviceProperties = physicalDeviceProperties2.properties;
+  memcpy(driverUuid, physicalDeviceIdProperties.driverUUID, VK_UUID_SIZE);
+
+  // Load the cache data from disk, a missing or incompatible file results in an empty cache
+  std::vector<char> data;
+  std::ifstream file(filename, std::ios::ate | std::ios::binary);
+  if (file.is_open())
+  {
+    const size_t fileSize = static_cast<size_t>(file.tellg());
+    FileHeader fileHeader;
+    if (fileSize >= sizeof(fileHeader))
+    {
+      file.seekg(0);
+      file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
+
+      if (fileHeader.magic == fileMagic && fileHeader.version == fileVersion &&
+          memcmp(fileHeader.driverUuid, driverUuid, VK_UUID_SIZE) == 0 &&
+          fileHeader.dataSize == fileSize - sizeof(fileHeader))
+      {
+        data.resize(static_cast<size_t>(fileHeader.dataSize));
+        file.read(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!file || util::hashData(data.data(), data.size()) != fileHeader.dataHash ||
+            !isCompatible(data.data(), data.size()))
+        {
+          data.clear();
+        }
+      }
+    }
+    file.close();
+  }
+
+  // Create the pipeline cache
+  VkPipelineCacheCreateInfo pipelineCacheCreateInfo{ VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+  pipelineCacheCreateInfo.initialDataSize = data.size();
+  pipelineCacheCreateInfo.pInitialData = data.empty() ? nullptr : data.data();
+  VkResult result;
+  if ((result = vkCreatePipelineCache(device, &pipelineCacheCreateInfo, nullptr, &pipelineCache)) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan, string_VkResult(result));
+    valid = false;
+    return;
+  }
+
+  warm = !data.empty();
+}
+
+PipelineCache::~PipelineCache()
+{
+  vkDestroyPipelineCache(device, pipelineCache, nullptr);
+}
+
+bool PipelineCache::save() const
+{
+  // Get the cache data
+  size_t dataSize;
+  if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, nullptr) != VK_SUCCESS)
+  {
+    return false;
+  }
+
+  std::vector<char> data(dataSize);
+  if (vkGetPipelineCacheData(device, pipelineCache, &dataSize, data.data()) != VK_SUCCESS)
+  {
+    return false;
+  }
+  data.resize(dataSize);
+
+  FileHeader fileHeader;
+  fileHeader.magic = fileMagic;
+  fileHeader.version = fileVersion;
+  memcpy(fileHeader.driverUuid, driverUuid, VK_UUID_SIZE);
+  fileHeader.dataSize = static_cast<uint64_t>(data.size());
+  fileHeader.dataHash = util::hashData(data.data(), data.size());
+
+  // Write to a temporary file first so that an interrupted save never leaves a partial cache behind
+  const std::string temporaryFilename = filename + ".tmp";
+  std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+  file.write(data.data(), static_cast<std::streamsize>(data.size()));
+  file.close();
+  std::error_code errorCode;
+  if (!file)
+  {
+    std::filesystem::remove(temporaryFilename, errorCode);
+    return false;
+  }
+
+  // Replace the previous cache in one step
+  std::filesystem::rename(temporaryFilename, filename, errorCode);
+  return !errorCode;
+}
+
+bool PipelineCache::isValid() const
+{
+  return valid;
+}
+
+bool PipelineCache::isWarm() const
+{
+  return warm;
+}
+
+VkPipelineCache PipelineCache::getVkPipelineCache() const
+{
+  return pipelineCache;
+}
+
+bool PipelineCache::isCompatible(const char* data, size_t size) const
+{
+  // Check the header that every Vulkan implementation writes in front of its cache data
+  VkPipelineCacheHeaderVersionOne header;
+  if (size < sizeof(header))
+  {
+    return false;
+  }
+
+  memcpy(&header, data, sizeof(header));
+  return header.headerSize >= sizeof(header) && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+         header.vendorID == physicalDeviceProperties.vendorID && header.deviceID == physicalDeviceProperties.deviceID &&
+         memcmp(header.pipelineCacheUUID, physicalDeviceProperties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
\ No newline at end of file
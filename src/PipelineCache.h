@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+
+// A pipeline cache that is loaded from and saved to disk, data from another device or driver is discarded
+class PipelineCache final
+{
+public:
+  PipelineCache(VkDevice device, VkPhysicalDevice physicalDevice, const std::string& filename);
+  ~PipelineCache();
+
+  bool save() const;
+
+  bool isValid() const;
+  bool isWarm() const; // Whether the cache was filled from disk
+  VkPipelineCache getVkPipelineCache() const;
+
+private:
+  bool valid = true;
+  bool warm = false;
+
+  VkDevice device = nullptr;
+  std::string filename;
+  VkPhysicalDeviceProperties physicalDeviceProperties;
+  uint8_t driverUuid[VK_UUID_SIZE];
+  VkPipelineCache pipelineCache = nullptr;
+
+  bool isCompatible(const char* data, size_t size) const;
+};
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "PipelineCompiler.h"
+
+#include "Pipeline.h"
+
+#include <algorithm>
+
+PipelineCompiler::PipelineCompiler(size_t threadCount)
+{
+  // Start the worker threads
+  for (size_t threadIndex = 0u; threadIndex < std::max(threadCount, static_cast<size_t>(1u)); ++threadIndex)
+  {
+    workerThreads.emplace_back(&PipelineCompiler::work, this);
+  }
+}
+
+PipelineCompiler::~PipelineCompiler()
+{
+  // Let the worker threads finish the pipelines they are creating but skip the rest
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    exitRequested = true;
+  }
+  jobCondition.notify_all();
+
+  for (std::thread& workerThread : workerThreads)
+  {
+    workerThread.join();
+  }
+
+  // Destroy the pipelines nobody took
+  for (const Job* job : jobs)
+  {
+    if (!job->taken)
+    {
+      delete job->pipeline;
+    }
+
+    delete job;
+  }
+}
+
+size_t PipelineCompiler::compile(const CreateFunction& createFunction)
+{
+  Job* job = new Job;
+  job->createFunction = createFunction;
+
+  size_t jobIndex;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    jobIndex = jobs.size();
+    jobs.push_back(job);
+  }
+  jobCondition.notify_one();
+
+  return jobIndex;
+}
+
+Pipeline* PipelineCompiler::wait(size_t jobIndex)
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  Job* job = jobs.at(jobIndex);
+  doneCondition.wait(lock, [job] { return job->done; });
+  return handOver(job);
+}
+
+Pipeline* PipelineCompiler::take(size_t jobIndex)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  Job* job = jobs.at(jobIndex);
+  if (!job->done)
+  {
+    return nullptr;
+  }
+
+  return handOver(job);
+}
+
+void PipelineCompiler::work()
+{
+  while (true)
+  {
+    Job* job;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      jobCondition.wait(lock, [this] { return exitRequested || nextJobIndex < jobs.size(); });
+      if (exitRequested)
+      {
+        return;
+      }
+
+      job = jobs.at(nextJobIndex++);
+    }
+
+    // Create the pipeline without holding the lock, the pipeline cache is safe to use from several threads
+    Pipeline* pipeline = job->createFunction();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      job->pipeline = pipeline;
+      job->done = true;
+    }
+    doneCondition.notify_all();
+  }
+}
+
+Pipeline* PipelineCompiler::handOver(Job* job)
+{
+  // A pipeline can only be handed over once
+  if (job->taken)
+  {
+    return nullptr;
+  }
+
+  job->taken = true;
+  return job->pipeline;
+}
\ No newline at end of file
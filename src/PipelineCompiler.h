@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class Pipeline;
+
+// Creates pipelines on a pool of worker threads in the order they were requested, finished pipelines are handed over
+// to the caller which owns them from then on
+class PipelineCompiler final
+{
+public:
+  PipelineCompiler(size_t threadCount);
+  ~PipelineCompiler();
+
+  using CreateFunction = std::function<Pipeline*()>;
+
+  size_t compile(const CreateFunction& createFunction); // Returns the job index
+  Pipeline* wait(size_t jobIndex);                      // Blocks until the pipeline is created
+  Pipeline* take(size_t jobIndex);                      // Returns null if the pipeline is not created yet
+
+private:
+  struct Job final
+  {
+    CreateFunction createFunction;
+    Pipeline* pipeline = nullptr;
+    bool done = false, taken = false;
+  };
+
+  std::vector<std::thread> workerThreads;
+
+  // Guarded by the mutex
+  std::mutex mutex;
+  std::condition_variable jobCondition, doneCondition;
+  std::vector<Job*> jobs;
+  size_t nextJobIndex = 0u; // Jobs before this index have been started
+  bool exitRequested = false;
+
+  void work();
+  Pipeline* handOver(Job* job);
+};
\ No newline at end of file
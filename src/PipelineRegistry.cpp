@@ -0,0 +1,364 @@
+#include "PipelineRegistry.h"
+
+#include "PipelineCompiler.h"
+#include "Util.h"
+
+#include <cstring>
+
+namespace
+{
+// Hashes the pipeline relevant fields of a description, the flags of a pipeline library part are hashed first
+uint64_t hashDescription(const PipelineRegistry::Description& description, VkGraphicsPipelineLibraryFlagsEXT flags)
+{
+  uint64_t hash = util::hashData(reinterpret_cast<const char*>(&flags), sizeof(flags));
+  const auto hashValue = [&hash](const auto& value)
+  {
+    hash = util::hashData(reinterpret_cast<const char*>(&value), sizeof(value), hash);
+  };
+
+  hashValue(description.renderPass);
+  hashValue(description.renderingFormats.viewMask);
+  hashValue(description.renderingFormats.colorFormat);
+  hashValue(description.renderingFormats.depthFormat);
+  hashValue(description.vertexShaderModule);
+  hashValue(description.fragmentShaderModule);
+  hashValue(description.fragmentSpecialization);
+  for (const VkVertexInputBindingDescription& binding : description.vertexInputBindingDescriptions)
+  {
+    hashValue(binding);
+  }
+
+  for (const VkVertexInputAttributeDescription& attribute : description.vertexInputAttributeDescriptions)
+  {
+    hashValue(attribute);
+  }
+
+  const RenderState& renderState = description.renderState;
+  hashValue(renderState.topology);
+  hashValue(renderState.cullMode);
+  hashValue(renderState.frontFace);
+  hashValue(renderState.depthTest);
+  hashValue(renderState.depthWrite);
+  hashValue(renderState.depthCompareOp);
+  hashValue(renderState.primitiveRestart);
+  hashValue(renderState.blend);
+  return hash;
+}
+
+bool isEqual(const PipelineRegistry::Description& a, const PipelineRegistry::Description& b)
+{
+  const auto isEqualVector = [](const auto& vectorA, const auto& vectorB)
+  {
+    return vectorA.size() == vectorB.size() &&
+           (vectorA.empty() || memcmp(vectorA.data(), vectorB.data(), vectorA.size() * sizeof(vectorA.front())) == 0);
+  };
+
+  return a.renderPass == b.renderPass && a.renderingFormats.viewMask == b.renderingFormats.viewMask &&
+         a.renderingFormats.colorFormat == b.renderingFormats.colorFormat &&
+         a.renderingFormats.depthFormat == b.renderingFormats.depthFormat &&
+         a.vertexShaderModule == b.vertexShaderModule &&
+         a.fragmentShaderModule == b.fragmentShaderModule && a.fragmentSpecialization == b.fragmentSpecialization &&
+         isEqualVector(a.vertexInputBindingDescriptions, b.vertexInputBindingDescriptions) &&
+         isEqualVector(a.vertexInputAttributeDescriptions, b.vertexInputAttributeDescriptions) &&
+         a.renderState == b.renderState;
+}
+
+// The part of a description a pipeline library part depends on, everything else is left at its defaults so that more
+// pipelines can share the part
+PipelineRegistry::Description getPartDescription(VkGraphicsPipelineLibraryFlagsEXT flags,
+                                                 const PipelineRegistry::Description& description)
+{
+  PipelineRegistry::Description partDescription;
+  const RenderState& renderState = description.renderState;
+  RenderState& partRenderState = partDescription.renderState;
+  switch (flags)
+  {
+  case VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT:
+    partDescription.vertexInputBindingDescriptions = description.vertexInputBindingDescriptions;
+    partDescription.vertexInputAttributeDescriptions = description.vertexInputAttributeDescriptions;
+    partRenderState.topology = renderState.topology;
+    partRenderState.primitiveRestart = renderState.primitiveRestart;
+    break;
+  case VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT:
+    partDescription.renderPass = description.renderPass;
+    partDescription.renderingFormats = description.renderingFormats;
+    partDescription.vertexShaderModule = description.vertexShaderModule;
+    partRenderState.cullMode = renderState.cullMode;
+    partRenderState.frontFace = renderState.frontFace;
+    break;
+  case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT:
+    partDescription.renderPass = description.renderPass;
+    partDescription.renderingFormats = description.renderingFormats;
+    partDescription.fragmentShaderModule = description.fragmentShaderModule;
+    partDescription.fragmentSpecialization = description.fragmentSpecialization;
+    partRenderState.depthTest = renderState.depthTest;
+    partRenderState.depthWrite = renderState.depthWrite;
+    partRenderState.depthCompareOp = renderState.depthCompareOp;
+    break;
+  case VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT:
+    partDescription.renderPass = description.renderPass;
+    partDescription.renderingFormats = description.renderingFormats;
+    partRenderState.blend = renderState.blend;
+    break;
+  }
+  return partDescription;
+}
+} // namespace
+
+PipelineRegistry::PipelineRegistry(VkDevice device,
+                                   VkPipelineCache pipelineCache,
+                                   VkPipelineLayout pipelineLayout,
+                                   const DynamicState* dynamicState,
+                                   PipelineCompiler* pipelineCompiler,
+                                   bool graphicsPipelineLibrary,
+                                   bool creationFeedback)
+: device(device),
+  pipelineCache(pipelineCache),
+  pipelineLayout(pipelineLayout),
+  dynamicState(dynamicState),
+  pipelineCompiler(pipelineCompiler),
+  graphicsPipelineLibrary(graphicsPipelineLibrary),
+  creationFeedback(creationFeedback)
+{
+}
+
+PipelineRegistry::~PipelineRegistry()
+{
+  for (const Entry* entry : entries)
+  {
+    delete entry->pipeline;
+    delete entry->fastLinkedPipeline;
+    delete entry;
+  }
+
+  for (const std::pair<const uint64_t, Part*>& part : parts)
+  {
+    delete part.second->pipeline;
+    delete part.second;
+  }
+}
+
+size_t PipelineRegistry::acquire(const Description& description)
+{
+  // Render states that only differ in dynamic parts share a pipeline
+  Description key = description;
+  key.renderState = dynamicState->getPipelineState(description.renderState);
+
+  // Look for a pipeline with the same description
+  const uint64_t hash = hashDescription(key, 0u);
+  const auto range = entryIndices.equal_range(hash);
+  for (auto iterator = range.first; iterator != range.second; ++iterator)
+  {
+    if (isEqual(entries.at(iterator->second)->description, key))
+    {
+      ++hitCount;
+      return iterator->second;
+    }
+  }
+
+  // Start creating a new one
+  ++missCount;
+  Entry* entry = new Entry;
+  entry->description = key;
+  const size_t handle = entries.size();
+  entries.push_back(entry);
+  entryIndices.emplace(hash, handle);
+  compile(entry);
+  return handle;
+}
+
+const Pipeline* PipelineRegistry::get(size_t handle)
+{
+  return update(entries.at(handle), false);
+}
+
+const Pipeline* PipelineRegistry::wait(size_t handle)
+{
+  return update(entries.at(handle), true);
+}
+
+uint32_t PipelineRegistry::getGeneration() const
+{
+  return generation;
+}
+
+size_t PipelineRegistry::getHitCount() const
+{
+  return hitCount;
+}
+
+size_t PipelineRegistry::getMissCount() const
+{
+  return missCount;
+}
+
+PipelineRegistry::Part* PipelineRegistry::acquirePart(VkGraphicsPipelineLibraryFlagsEXT flags,
+                                                      const Description& description)
+{
+  // Reuse a part that was compiled for another pipeline
+  const Description partDescription = getPartDescription(flags, description);
+  const uint64_t hash = hashDescription(partDescription, flags);
+  const auto range = parts.equal_range(hash);
+  for (auto iterator = range.first; iterator != range.second; ++iterator)
+  {
+    if (iterator->second->flags == flags && isEqual(iterator->second->description, partDescription))
+    {
+      return iterator->second;
+    }
+  }
+
+  Part* part = new Part{ flags, partDescription };
+  parts.emplace(hash, part);
+
+  // Compile the part as a library, only the shader stage of the part is included
+  const VkDevice vkDevice = device;
+  const VkPipelineCache vkPipelineCache = pipelineCache;
+  const VkPipelineLayout vkPipelineLayout = pipelineLayout;
+  const VkSpecializationInfo specializationInfo =
+    util::makeSpecializationInfo(part->description.fragmentSpecialization);
+  const std::vector<VkDynamicState> dynamicStates = dynamicState->getDynamicStates();
+  const bool feedback = creationFeedback;
+  part->job = pipelineCompiler->compile(
+    [vkDevice, vkPipelineCache, vkPipelineLayout, partDescription, specializationInfo, dynamicStates, flags, feedback]
+    {
+      return new Pipeline(vkDevice, vkPipelineCache, vkPipelineLayout, partDescription.renderPass,
+                          partDescription.renderingFormats, partDescription.vertexShaderModule, nullptr,
+                          partDescription.fragmentShaderModule, &specializationInfo,
+                          partDescription.vertexInputBindingDescriptions,
+                          partDescription.vertexInputAttributeDescriptions, partDescription.renderState,
+                          dynamicStates, flags, feedback);
+    });
+
+  return part;
+}
+
+void PipelineRegistry::compile(Entry* entry)
+{
+  if (graphicsPipelineLibrary)
+  {
+    // Compile the parts that no other pipeline has needed yet, linking waits until the pipeline is requested
+    entry->parts = { acquirePart(VK_GRAPHICS_PIPELINE_LIBRARY_VERTEX_INPUT_INTERFACE_BIT_EXT, entry->description),
+                     acquirePart(VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT, entry->description),
+                     acquirePart(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_SHADER_BIT_EXT, entry->description),
+                     acquirePart(VK_GRAPHICS_PIPELINE_LIBRARY_FRAGMENT_OUTPUT_INTERFACE_BIT_EXT, entry->description) };
+    return;
+  }
+
+  // Compile a complete pipeline
+  const VkDevice vkDevice = device;
+  const VkPipelineCache vkPipelineCache = pipelineCache;
+  const VkPipelineLayout vkPipelineLayout = pipelineLayout;
+  const Description description = entry->description;
+  const VkSpecializationInfo specializationInfo =
+    util::makeSpecializationInfo(entry->description.fragmentSpecialization);
+  const std::vector<VkDynamicState> dynamicStates = dynamicState->getDynamicStates();
+  const bool feedback = creationFeedback;
+  entry->job = pipelineCompiler->compile(
+    [vkDevice, vkPipelineCache, vkPipelineLayout, description, specializationInfo, dynamicStates, feedback]
+    {
+      return new Pipeline(vkDevice, vkPipelineCache, vkPipelineLayout, description.renderPass,
+                          description.renderingFormats, description.vertexShaderModule, nullptr,
+                          description.fragmentShaderModule, &specializationInfo,
+                          description.vertexInputBindingDescriptions, description.vertexInputAttributeDescriptions,
+                          description.renderState, dynamicStates, 0u, feedback);
+    });
+  entry->jobPending = true;
+}
+
+const Pipeline* PipelineRegistry::update(Entry* entry, bool block)
+{
+  // Take the complete or optimized pipeline once it is ready, only a complete pipeline is ever waited for
+  if (entry->jobPending)
+  {
+    Pipeline* pipeline = (block && !graphicsPipelineLibrary) ? pipelineCompiler->wait(entry->job) :
+                                                                pipelineCompiler->take(entry->job);
+    if (pipeline)
+    {
+      entry->jobPending = false;
+      if (pipeline->isValid())
+      {
+        entry->pipeline = pipeline;
+        pipeline->report(entry->description.name + (graphicsPipelineLibrary ? " (optimized link)" : ""));
+      }
+      else
+      {
+        // Keep using the fast link if there is one
+        delete pipeline;
+        entry->failed = !entry->fastLinkedPipeline;
+      }
+    }
+  }
+
+  if (entry->pipeline)
+  {
+    return select(entry, entry->pipeline);
+  }
+
+  if (entry->fastLinkedPipeline)
+  {
+    return select(entry, entry->fastLinkedPipeline);
+  }
+
+  if (entry->failed || !graphicsPipelineLibrary)
+  {
+    return nullptr;
+  }
+
+  // Gather the parts, the pipeline cannot be linked before all of them are compiled
+  std::vector<const Pipeline*> libraries;
+  for (Part* part : entry->parts)
+  {
+    if (!part->pipeline)
+    {
+      part->pipeline = block ? pipelineCompiler->wait(part->job) : pipelineCompiler->take(part->job);
+      if (!part->pipeline)
+      {
+        return nullptr;
+      }
+    }
+
+    if (!part->pipeline->isValid())
+    {
+      entry->failed = true;
+      return nullptr;
+    }
+
+    libraries.push_back(part->pipeline);
+  }
+
+  // Fast-link the parts right away, this is cheap enough to happen in the frame loop
+  Pipeline* fastLinkedPipeline =
+    new Pipeline(device, pipelineCache, pipelineLayout, libraries, false, creationFeedback);
+  if (!fastLinkedPipeline->isValid())
+  {
+    delete fastLinkedPipeline;
+    entry->failed = true;
+    return nullptr;
+  }
+
+  entry->fastLinkedPipeline = fastLinkedPipeline;
+  fastLinkedPipeline->report(entry->description.name + " (fast link)");
+
+  // Build an optimized link in the background that replaces the fast one once it is ready
+  const VkDevice vkDevice = device;
+  const VkPipelineCache vkPipelineCache = pipelineCache;
+  const VkPipelineLayout vkPipelineLayout = pipelineLayout;
+  const bool feedback = creationFeedback;
+  entry->job = pipelineCompiler->compile(
+    [vkDevice, vkPipelineCache, vkPipelineLayout, libraries, feedback]
+    { return new Pipeline(vkDevice, vkPipelineCache, vkPipelineLayout, libraries, true, feedback); });
+  entry->jobPending = true;
+
+  return select(entry, entry->fastLinkedPipeline);
+}
+
+const Pipeline* PipelineRegistry::select(Entry* entry, const Pipeline* pipeline)
+{
+  if (pipeline != entry->currentPipeline)
+  {
+    entry->currentPipeline = pipeline;
+    ++generation;
+  }
+
+  return pipeline;
+}
\ No newline at end of file
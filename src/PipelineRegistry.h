@@ -0,0 +1,90 @@
+#pragma once
+
+#include "DynamicState.h"
+#include "Pipeline.h"
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class PipelineCompiler;
+
+// Hands out shared handles to graphics pipelines by their full description, a pipeline is only created the first
+// time its description is acquired and identical descriptions always share one pipeline. With graphics pipeline
+// libraries the vertex input, pre-rasterization, fragment shader and fragment output parts are compiled once and
+// shared between pipelines, each pipeline is fast-linked as soon as its parts are ready and later replaced by an
+// optimized link from the background. Without them every pipeline is compiled as a whole. All pipelines are owned by
+// the registry and stay alive until it is destroyed, so replaced ones can still be used by recorded command buffers
+class PipelineRegistry final
+{
+public:
+  PipelineRegistry(VkDevice device,
+                   VkPipelineCache pipelineCache,
+                   VkPipelineLayout pipelineLayout,
+                   const DynamicState* dynamicState,
+                   PipelineCompiler* pipelineCompiler,
+                   bool graphicsPipelineLibrary,
+                   bool creationFeedback);
+  ~PipelineRegistry(); // Destroy the pipeline compiler first so that no job is still using the pipeline parts
+
+  // Everything that makes up a graphics pipeline, the render state is reduced to the parts that are not dynamic
+  struct Description final
+  {
+    std::string name; // Only used in messages, not part of the key
+    VkRenderPass renderPass = nullptr;
+    RenderingFormats renderingFormats; // Only used without a render pass
+    VkShaderModule vertexShaderModule = nullptr, fragmentShaderModule = nullptr;
+    uint32_t fragmentSpecialization = 0u; // Value of the fragment shader's specialization constant
+    std::vector<VkVertexInputBindingDescription> vertexInputBindingDescriptions;
+    std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescriptions;
+    RenderState renderState;
+  };
+
+  size_t acquire(const Description& description); // Returns the handle, starts creating the pipeline on a miss
+  const Pipeline* get(size_t handle);             // Returns the best pipeline that is ready, null if there is none yet
+  const Pipeline* wait(size_t handle);            // Blocks until there is a pipeline, returns null if it failed
+  uint32_t getGeneration() const;                 // Changes whenever a handle switches to a different pipeline
+  size_t getHitCount() const;                     // Acquired descriptions that already had a pipeline
+  size_t getMissCount() const;                    // Acquired descriptions that needed a new pipeline
+
+private:
+  struct Part final
+  {
+    VkGraphicsPipelineLibraryFlagsEXT flags;
+    Description description; // Reduced to what the part depends on
+    size_t job = 0u;
+    Pipeline* pipeline = nullptr; // Set once the compiler handed it over
+  };
+
+  struct Entry final
+  {
+    Description description;
+    std::vector<Part*> parts;
+    size_t job = 0u;         // Creates the complete pipeline or the optimized link
+    bool jobPending = false; // The job has been started but its pipeline has not been taken
+    bool failed = false;     // No pipeline can be created for this entry
+    Pipeline* fastLinkedPipeline = nullptr;
+    Pipeline* pipeline = nullptr; // Complete or optimized
+    const Pipeline* currentPipeline = nullptr;
+  };
+
+  VkDevice device = nullptr;
+  VkPipelineCache pipelineCache = nullptr;
+  VkPipelineLayout pipelineLayout = nullptr;
+  const DynamicState* dynamicState = nullptr;
+  PipelineCompiler* pipelineCompiler = nullptr;
+  bool graphicsPipelineLibrary = false, creationFeedback = false;
+
+  std::vector<Entry*> entries;                            // Indexed by handle
+  std::unordered_multimap<uint64_t, size_t> entryIndices; // By description hash
+  std::unordered_multimap<uint64_t, Part*> parts;         // By part flags and description hash
+  uint32_t generation = 0u;
+  size_t hitCount = 0u, missCount = 0u;
+
+  Part* acquirePart(VkGraphicsPipelineLibraryFlagsEXT flags, const Description& description);
+  void compile(Entry* entry);
+  const Pipeline* update(Entry* entry, bool block);
+  const Pipeline* select(Entry* entry, const Pipeline* pipeline);
+};
\ No newline at end of file
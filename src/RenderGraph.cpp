@@ -0,0 +1,615 @@
+#include "RenderGraph.h"
+
+#include "Context.h"
+#include "ImageViewCache.h"
+#include "Util.h"
+
+#include <algorithm>
+
+namespace
+{
+constexpr VkAccessFlags2KHR writeAccessMask =
+  VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR |
+  VK_ACCESS_2_SHADER_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR;
+
+// Only stages and accesses that also exist without synchronization2 are used, so they can be passed to either
+struct AccessInfo final
+{
+  VkPipelineStageFlags2KHR stageMask;
+  VkAccessFlags2KHR accessMask;
+  VkImageLayout layout;    // Ignored for buffers
+  VkImageUsageFlags usage; // Needed by transient images
+};
+
+AccessInfo getAccessInfo(RenderGraph::Access access)
+{
+  switch (access)
+  {
+  case RenderGraph::Access::ColorAttachmentWrite:
+    return { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
+             VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR,
+             VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT };
+  case RenderGraph::Access::DepthAttachmentWrite:
+    return { VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT_KHR | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT_KHR,
+             VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR,
+             VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT };
+  case RenderGraph::Access::ComputeShaderRead:
+    return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR, VK_IMAGE_LAYOUT_GENERAL,
+             VK_IMAGE_USAGE_STORAGE_BIT };
+  case RenderGraph::Access::ComputeShaderWrite:
+    return { VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_GENERAL,
+             VK_IMAGE_USAGE_STORAGE_BIT };
+  case RenderGraph::Access::IndirectRead:
+    return { VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR,
+             VK_IMAGE_LAYOUT_UNDEFINED, 0u };
+  case RenderGraph::Access::TransferRead:
+    return { VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR,
+             VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT };
+  case RenderGraph::Access::TransferWrite:
+    return { VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR,
+             VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT };
+  case RenderGraph::Access::Present:
+    return { VK_PIPELINE_STAGE_2_NONE_KHR, VK_ACCESS_2_NONE_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0u };
+  default:
+    return { VK_PIPELINE_STAGE_2_NONE_KHR, VK_ACCESS_2_NONE_KHR, VK_IMAGE_LAYOUT_UNDEFINED, 0u };
+  }
+}
+
+// A range of memory that transient images with disjoint lifetimes take turns in
+struct MemorySlot final
+{
+  VkMemoryRequirements memoryRequirements;
+  std::vector<std::pair<size_t, size_t>> lifetimes; // First and last step of each image in the slot
+};
+
+bool isOverlapping(const MemorySlot& memorySlot, size_t firstStep, size_t lastStep)
+{
+  return std::any_of(memorySlot.lifetimes.begin(), memorySlot.lifetimes.end(),
+                     [firstStep, lastStep](const std::pair<size_t, size_t>& lifetime)
+                     { return firstStep <= lifetime.second && lifetime.first <= lastStep; });
+}
+} // namespace
+
+RenderGraph::RenderGraph(const Context* context)
+: context(context), memoryAllocator(context->getMemoryAllocator())
+{
+  imageViewCache = new ImageViewCache(context->getVkDevice());
+}
+
+RenderGraph::~RenderGraph()
+{
+  delete imageViewCache;
+
+  const VkDevice device = context->getVkDevice();
+  for (const Resource& resource : resources)
+  {
+    if (resource.transient)
+    {
+      vkDestroyImage(device, resource.vkImage, nullptr);
+    }
+  }
+
+  for (MemoryAllocation& memorySlot : memorySlots)
+  {
+    memoryAllocator->free(memorySlot);
+  }
+}
+
+size_t RenderGraph::importImage(const std::string& name,
+                                VkImageAspectFlags aspectMask,
+                                uint32_t baseLayer,
+                                uint32_t layerCount,
+                                Access previousAccess,
+                                bool preserveContents,
+                                Access finalAccess)
+{
+  Resource resource;
+  resource.name = name;
+  resource.image = true;
+  resource.aspectMask = aspectMask;
+  resource.baseLayer = baseLayer;
+  resource.layerCount = layerCount;
+  resource.previousAccess = previousAccess;
+  resource.preserveContents = preserveContents;
+  resource.finalAccess = finalAccess;
+  resources.push_back(resource);
+  return resources.size() - 1u;
+}
+
+size_t RenderGraph::importBuffer(const std::string& name, Access previousAccess, Access finalAccess)
+{
+  Resource resource;
+  resource.name = name;
+  resource.previousAccess = previousAccess;
+  resource.preserveContents = true;
+  resource.finalAccess = finalAccess;
+  resources.push_back(resource);
+  return resources.size() - 1u;
+}
+
+size_t RenderGraph::createImage(const std::string& name,
+                                VkFormat format,
+                                VkExtent2D extent,
+                                uint32_t layerCount,
+                                VkImageAspectFlags aspectMask)
+{
+  Resource resource;
+  resource.name = name;
+  resource.image = true;
+  resource.transient = true;
+  resource.aspectMask = aspectMask;
+  resource.layerCount = layerCount;
+  resource.format = format;
+  resource.extent = extent;
+  resources.push_back(resource);
+  return resources.size() - 1u;
+}
+
+size_t RenderGraph::addPass(const std::string& name, const RecordFunction& recordFunction, bool sideEffects)
+{
+  Pass pass;
+  pass.name = name;
+  pass.recordFunction = recordFunction;
+  pass.sideEffects = sideEffects;
+  passes.push_back(pass);
+  return passes.size() - 1u;
+}
+
+void RenderGraph::read(size_t pass, size_t resource, Access access)
+{
+  use(pass, resource, access, false);
+}
+
+void RenderGraph::write(size_t pass, size_t resource, Access access)
+{
+  use(pass, resource, access, true);
+}
+
+bool RenderGraph::compile()
+{
+  if (!valid)
+  {
+    return false;
+  }
+
+  // Only record the passes that contribute to an imported resource or have side effects, in declaration order
+  cullPasses();
+  steps.clear();
+  for (size_t passIndex = 0u; passIndex < passes.size(); ++passIndex)
+  {
+    if (!passes.at(passIndex).culled)
+    {
+      steps.push_back({ passIndex, {} });
+    }
+  }
+
+  if (!createTransientImages())
+  {
+    return false;
+  }
+
+  // Start each resource in the state it was left in before the graph, a transient image may still be used by the
+  // images it shares memory with and by the previous execution
+  std::vector<State> states(resources.size());
+  for (size_t resourceIndex = 0u; resourceIndex < resources.size(); ++resourceIndex)
+  {
+    const Resource& resource = resources.at(resourceIndex);
+    State& state = states.at(resourceIndex);
+    if (resource.transient)
+    {
+      for (const Pass& pass : passes)
+      {
+        for (const Usage& usage : pass.usages)
+        {
+          const Resource& other = resources.at(usage.resource);
+          if (!pass.culled && other.transient && other.memorySlot == resource.memorySlot)
+          {
+            state.stageMask |= usage.state.stageMask;
+            state.accessMask |= usage.state.accessMask;
+          }
+        }
+      }
+    }
+    else
+    {
+      const AccessInfo accessInfo = getAccessInfo(resource.previousAccess);
+      state = { accessInfo.stageMask, accessInfo.accessMask, accessInfo.layout };
+    }
+
+    if (resource.image && !resource.preserveContents)
+    {
+      state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    }
+  }
+
+  // Add a barrier wherever a resource changes its layout, is accessed after a write or is written after a read
+  for (Step& step : steps)
+  {
+    for (const Usage& usage : passes.at(step.pass).usages)
+    {
+      State& state = states.at(usage.resource);
+      const bool layoutChange = resources.at(usage.resource).image && state.layout != usage.state.layout;
+      const bool afterWrite = (state.accessMask & writeAccessMask) != 0u;
+      if (!layoutChange && !afterWrite && (!usage.write || state.stageMask == 0u))
+      {
+        // Reads can happen in any order, later writes wait for all of them
+        state.stageMask |= usage.state.stageMask;
+        state.accessMask |= usage.state.accessMask;
+        state.layout = usage.state.layout;
+        continue;
+      }
+
+      // Only writes have to be made available, a write after reads only has to wait for them to execute
+      Barrier barrier{ usage.resource, state, usage.state };
+      barrier.source.accessMask &= writeAccessMask;
+      if (!layoutChange && !afterWrite)
+      {
+        barrier.destination.accessMask = 0u;
+      }
+
+      step.barriers.push_back(barrier);
+      state = usage.state;
+    }
+  }
+
+  // Leave the imported images in the layout their next user expects
+  finalBarriers.clear();
+  for (size_t resourceIndex = 0u; resourceIndex < resources.size(); ++resourceIndex)
+  {
+    const Resource& resource = resources.at(resourceIndex);
+    if (!resource.image || resource.transient || resource.finalAccess == Access::None)
+    {
+      continue;
+    }
+
+    const AccessInfo accessInfo = getAccessInfo(resource.finalAccess);
+    const State& state = states.at(resourceIndex);
+    if (state.layout != accessInfo.layout)
+    {
+      Barrier barrier{ resourceIndex, state, { accessInfo.stageMask, accessInfo.accessMask, accessInfo.layout } };
+      barrier.source.accessMask &= writeAccessMask;
+      finalBarriers.push_back(barrier);
+    }
+  }
+
+  compiled = true;
+  return true;
+}
+
+void RenderGraph::setImage(size_t resource, VkImage image, VkImageView imageView)
+{
+  Resource& importedResource = resources.at(resource);
+  importedResource.vkImage = image;
+  importedResource.vkImageView = imageView;
+}
+
+void RenderGraph::setBuffer(size_t resource, VkBuffer buffer)
+{
+  resources.at(resource).vkBuffer = buffer;
+}
+
+void RenderGraph::execute(VkCommandBuffer commandBuffer) const
+{
+  if (!compiled)
+  {
+    return;
+  }
+
+  for (const Step& step : steps)
+  {
+    recordBarriers(commandBuffer, step.barriers);
+    passes.at(step.pass).recordFunction(commandBuffer);
+  }
+
+  recordBarriers(commandBuffer, finalBarriers);
+}
+
+VkImage RenderGraph::getImage(size_t resource) const
+{
+  return resources.at(resource).vkImage;
+}
+
+VkImageView RenderGraph::getImageView(size_t resource) const
+{
+  return resources.at(resource).vkImageView;
+}
+
+VkBuffer RenderGraph::getBuffer(size_t resource) const
+{
+  return resources.at(resource).vkBuffer;
+}
+
+size_t RenderGraph::getCulledPassCount() const
+{
+  return static_cast<size_t>(
+    std::count_if(passes.begin(), passes.end(), [](const Pass& pass) { return pass.culled; }));
+}
+
+VkDeviceSize RenderGraph::getTransientMemorySize() const
+{
+  VkDeviceSize size = 0u;
+  for (const MemoryAllocation& memorySlot : memorySlots)
+  {
+    size += memorySlot.size;
+  }
+  return size;
+}
+
+void RenderGraph::use(size_t pass, size_t resource, Access access, bool write)
+{
+  const AccessInfo accessInfo = getAccessInfo(access);
+  const State state = { accessInfo.stageMask, accessInfo.accessMask, accessInfo.layout };
+
+  // Merge the accesses of a pass to the same resource, which only works as long as they share an image layout
+  std::vector<Usage>& usages = passes.at(pass).usages;
+  for (Usage& usage : usages)
+  {
+    if (usage.resource == resource)
+    {
+      if (resources.at(resource).image && usage.state.layout != state.layout)
+      {
+        util::error(Error::InvalidRenderGraph, "Pass \"" + passes.at(pass).name + "\" uses image \"" +
+                                                 resources.at(resource).name + "\" in two layouts");
+        valid = false;
+      }
+
+      usage.state.stageMask |= state.stageMask;
+      usage.state.accessMask |= state.accessMask;
+      usage.imageUsage |= accessInfo.usage;
+      usage.write = usage.write || write;
+      return;
+    }
+  }
+
+  usages.push_back({ resource, state, accessInfo.usage, write });
+}
+
+void RenderGraph::cullPasses()
+{
+  // Walk the passes backwards, a pass is needed if it writes an imported resource or one read by a later needed pass
+  std::vector<bool> neededResources(resources.size());
+  for (size_t resourceIndex = 0u; resourceIndex < resources.size(); ++resourceIndex)
+  {
+    neededResources.at(resourceIndex) = !resources.at(resourceIndex).transient;
+  }
+
+  for (size_t passIndex = passes.size(); passIndex > 0u; --passIndex)
+  {
+    Pass& pass = passes.at(passIndex - 1u);
+    pass.culled = !pass.sideEffects && std::none_of(pass.usages.begin(), pass.usages.end(),
+                                                    [&neededResources](const Usage& usage)
+                                                    { return usage.write && neededResources.at(usage.resource); });
+    if (pass.culled)
+    {
+      continue;
+    }
+
+    for (const Usage& usage : pass.usages)
+    {
+      if (!usage.write)
+      {
+        neededResources.at(usage.resource) = true;
+      }
+    }
+  }
+}
+
+bool RenderGraph::createTransientImages()
+{
+  const VkDevice device = context->getVkDevice();
+
+  // Find the first and last step each transient image is used in and how it is used
+  std::vector<size_t> firstSteps(resources.size(), steps.size()), lastSteps(resources.size(), 0u);
+  std::vector<VkImageUsageFlags> usageFlags(resources.size(), 0u);
+  for (size_t stepIndex = 0u; stepIndex < steps.size(); ++stepIndex)
+  {
+    for (const Usage& usage : passes.at(steps.at(stepIndex).pass).usages)
+    {
+      firstSteps.at(usage.resource) = std::min(firstSteps.at(usage.resource), stepIndex);
+      lastSteps.at(usage.resource) = std::max(lastSteps.at(usage.resource), stepIndex);
+    }
+  }
+
+  for (const Pass& pass : passes)
+  {
+    for (const Usage& usage : pass.usages)
+    {
+      usageFlags.at(usage.resource) |= usage.imageUsage;
+    }
+  }
+
+  // Create the images that are still used after culling
+  std::vector<size_t> transientResources;
+  std::vector<VkMemoryRequirements> memoryRequirements(resources.size());
+  for (size_t resourceIndex = 0u; resourceIndex < resources.size(); ++resourceIndex)
+  {
+    Resource& resource = resources.at(resourceIndex);
+    if (!resource.transient || firstSteps.at(resourceIndex) == steps.size())
+    {
+      continue;
+    }
+
+    VkImageCreateInfo imageCreateInfo{ VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.extent = { resource.extent.width, resource.extent.height, 1u };
+    imageCreateInfo.mipLevels = 1u;
+    imageCreateInfo.arrayLayers = resource.layerCount;
+    imageCreateInfo.format = resource.format;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageCreateInfo.usage = usageFlags.at(resourceIndex);
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateImage(device, &imageCreateInfo, nullptr, &resource.vkImage) != VK_SUCCESS)
+    {
+      util::error(Error::GenericVulkan);
+      return false;
+    }
+
+    vkGetImageMemoryRequirements(device, resource.vkImage, &memoryRequirements.at(resourceIndex));
+    transientResources.push_back(resourceIndex);
+  }
+
+  // Place the largest images first, each one goes into the first slot it fits into without overlapping lifetimes
+  std::sort(transientResources.begin(), transientResources.end(),
+            [&memoryRequirements](size_t a, size_t b)
+            { return memoryRequirements.at(a).size > memoryRequirements.at(b).size; });
+
+  std::vector<MemorySlot> slots;
+  for (size_t resourceIndex : transientResources)
+  {
+    const VkMemoryRequirements& requirements = memoryRequirements.at(resourceIndex);
+    const size_t firstStep = firstSteps.at(resourceIndex), lastStep = lastSteps.at(resourceIndex);
+
+    size_t slotIndex = 0u;
+    while (slotIndex < slots.size() &&
+           (isOverlapping(slots.at(slotIndex), firstStep, lastStep) ||
+            (slots.at(slotIndex).memoryRequirements.memoryTypeBits & requirements.memoryTypeBits) == 0u))
+    {
+      ++slotIndex;
+    }
+
+    if (slotIndex == slots.size())
+    {
+      slots.push_back({ requirements, {} });
+    }
+
+    MemorySlot& slot = slots.at(slotIndex);
+    slot.memoryRequirements.size = std::max(slot.memoryRequirements.size, requirements.size);
+    slot.memoryRequirements.alignment = std::max(slot.memoryRequirements.alignment, requirements.alignment);
+    slot.memoryRequirements.memoryTypeBits &= requirements.memoryTypeBits;
+    slot.lifetimes.emplace_back(firstStep, lastStep);
+    resources.at(resourceIndex).memorySlot = slotIndex;
+  }
+
+  // Allocate the slots and bind the images to them
+  for (const MemorySlot& slot : slots)
+  {
+    MemoryAllocation memoryAllocation;
+    if (!memoryAllocator->allocate(slot.memoryRequirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, true,
+                                   MemoryAllocator::Strategy::Buddy, memoryAllocation))
+    {
+      return false;
+    }
+
+    memorySlots.push_back(memoryAllocation);
+  }
+
+  for (size_t resourceIndex : transientResources)
+  {
+    Resource& resource = resources.at(resourceIndex);
+    const MemoryAllocation& memorySlot = memorySlots.at(resource.memorySlot);
+    if (vkBindImageMemory(device, resource.vkImage, memorySlot.memory, memorySlot.offset) != VK_SUCCESS)
+    {
+      util::error(Error::GenericVulkan);
+      return false;
+    }
+
+    resource.vkImageView = imageViewCache->get(resource.vkImage, resource.format, resource.aspectMask,
+                                               resource.layerCount);
+    if (!resource.vkImageView)
+    {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+void RenderGraph::recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers) const
+{
+  if (barriers.empty())
+  {
+    return;
+  }
+
+  std::vector<VkImageMemoryBarrier2KHR> imageMemoryBarriers;
+  std::vector<VkBufferMemoryBarrier2KHR> bufferMemoryBarriers;
+  for (const Barrier& barrier : barriers)
+  {
+    const Resource& resource = resources.at(barrier.resource);
+    if (resource.image)
+    {
+      VkImageMemoryBarrier2KHR imageMemoryBarrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR };
+      imageMemoryBarrier.srcStageMask = barrier.source.stageMask;
+      imageMemoryBarrier.srcAccessMask = barrier.source.accessMask;
+      imageMemoryBarrier.dstStageMask = barrier.destination.stageMask;
+      imageMemoryBarrier.dstAccessMask = barrier.destination.accessMask;
+      imageMemoryBarrier.oldLayout = barrier.source.layout;
+      imageMemoryBarrier.newLayout = barrier.destination.layout;
+      imageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      imageMemoryBarrier.image = resource.vkImage;
+      imageMemoryBarrier.subresourceRange = { resource.aspectMask, 0u, 1u, resource.baseLayer, resource.layerCount };
+      imageMemoryBarriers.push_back(imageMemoryBarrier);
+    }
+    else
+    {
+      VkBufferMemoryBarrier2KHR bufferMemoryBarrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR };
+      bufferMemoryBarrier.srcStageMask = barrier.source.stageMask;
+      bufferMemoryBarrier.srcAccessMask = barrier.source.accessMask;
+      bufferMemoryBarrier.dstStageMask = barrier.destination.stageMask;
+      bufferMemoryBarrier.dstAccessMask = barrier.destination.accessMask;
+      bufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+      bufferMemoryBarrier.buffer = resource.vkBuffer;
+      bufferMemoryBarrier.offset = 0u;
+      bufferMemoryBarrier.size = VK_WHOLE_SIZE;
+      bufferMemoryBarriers.push_back(bufferMemoryBarrier);
+    }
+  }
+
+  if (context->isSynchronization2Supported())
+  {
+    VkDependencyInfoKHR dependencyInfo{ VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR };
+    dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferMemoryBarriers.size());
+    dependencyInfo.pBufferMemoryBarriers = bufferMemoryBarriers.data();
+    dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(imageMemoryBarriers.size());
+    dependencyInfo.pImageMemoryBarriers = imageMemoryBarriers.data();
+    context->vkCmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+    return;
+  }
+
+  // Without synchronization2 all barriers of a batch share one set of stage masks
+  VkPipelineStageFlags sourceStageMask = 0u, destinationStageMask = 0u;
+  std::vector<VkImageMemoryBarrier> legacyImageMemoryBarriers;
+  for (const VkImageMemoryBarrier2KHR& imageMemoryBarrier : imageMemoryBarriers)
+  {
+    sourceStageMask |= static_cast<VkPipelineStageFlags>(imageMemoryBarrier.srcStageMask);
+    destinationStageMask |= static_cast<VkPipelineStageFlags>(imageMemoryBarrier.dstStageMask);
+
+    VkImageMemoryBarrier legacyImageMemoryBarrier{ VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+    legacyImageMemoryBarrier.srcAccessMask = static_cast<VkAccessFlags>(imageMemoryBarrier.srcAccessMask);
+    legacyImageMemoryBarrier.dstAccessMask = static_cast<VkAccessFlags>(imageMemoryBarrier.dstAccessMask);
+    legacyImageMemoryBarrier.oldLayout = imageMemoryBarrier.oldLayout;
+    legacyImageMemoryBarrier.newLayout = imageMemoryBarrier.newLayout;
+    legacyImageMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    legacyImageMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    legacyImageMemoryBarrier.image = imageMemoryBarrier.image;
+    legacyImageMemoryBarrier.subresourceRange = imageMemoryBarrier.subresourceRange;
+    legacyImageMemoryBarriers.push_back(legacyImageMemoryBarrier);
+  }
+
+  std::vector<VkBufferMemoryBarrier> legacyBufferMemoryBarriers;
+  for (const VkBufferMemoryBarrier2KHR& bufferMemoryBarrier : bufferMemoryBarriers)
+  {
+    sourceStageMask |= static_cast<VkPipelineStageFlags>(bufferMemoryBarrier.srcStageMask);
+    destinationStageMask |= static_cast<VkPipelineStageFlags>(bufferMemoryBarrier.dstStageMask);
+
+    VkBufferMemoryBarrier legacyBufferMemoryBarrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+    legacyBufferMemoryBarrier.srcAccessMask = static_cast<VkAccessFlags>(bufferMemoryBarrier.srcAccessMask);
+    legacyBufferMemoryBarrier.dstAccessMask = static_cast<VkAccessFlags>(bufferMemoryBarrier.dstAccessMask);
+    legacyBufferMemoryBarrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    legacyBufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    legacyBufferMemoryBarrier.buffer = bufferMemoryBarrier.buffer;
+    legacyBufferMemoryBarrier.offset = bufferMemoryBarrier.offset;
+    legacyBufferMemoryBarrier.size = bufferMemoryBarrier.size;
+    legacyBufferMemoryBarriers.push_back(legacyBufferMemoryBarrier);
+  }
+
+  vkCmdPipelineBarrier(commandBuffer, sourceStageMask ? sourceStageMask : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                       destinationStageMask ? destinationStageMask : VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0u, 0u,
+                       nullptr, static_cast<uint32_t>(legacyBufferMemoryBarriers.size()),
+                       legacyBufferMemoryBarriers.data(), static_cast<uint32_t>(legacyImageMemoryBarriers.size()),
+                       legacyImageMemoryBarriers.data());
+}
\ No newline at end of file
@@ -0,0 +1,146 @@
+#pragma once
+
+#include "MemoryAllocator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+class Context;
+class ImageViewCache;
+
+// Records a fixed set of passes with the barriers between them. Passes declare the resources they read and write,
+// compiling culls passes whose results are never used, derives the minimal layout transitions and memory dependencies
+// and batches them into one barrier per pass. Transient images are owned by the graph and share memory with other
+// transient images whose lifetimes do not overlap. Imported resources are bound before each execution and their
+// accesses before and after the graph are declared, so they can be handed between graphs and command buffers
+class RenderGraph final
+{
+public:
+  RenderGraph(const Context* context);
+  ~RenderGraph(); // Only destroy the graph once the device no longer uses its transient images
+
+  // The ways a pass can use a resource, each one implies the pipeline stages, access and image layout
+  enum class Access
+  {
+    None,                 // Not used, for resources without any access before or after the graph
+    ColorAttachmentWrite, // Written as a color attachment
+    DepthAttachmentWrite, // Read and written as a depth attachment during depth testing
+    ComputeShaderRead,    // Read as a storage buffer by a compute shader
+    ComputeShaderWrite,   // Written as a storage buffer by a compute shader
+    IndirectRead,         // Read as indirect draw commands or counts
+    TransferRead,         // Read as the source of a copy or blit
+    TransferWrite,        // Written as the destination of a copy, blit or fill
+    Present               // Presented to a window surface
+  };
+
+  using RecordFunction = std::function<void(VkCommandBuffer commandBuffer)>;
+
+  // Imported resources are bound by the caller, the previous access is what happened before the graph and the final
+  // access is what the resource is left in, image contents are discarded unless they are preserved
+  size_t importImage(const std::string& name,
+                     VkImageAspectFlags aspectMask,
+                     uint32_t baseLayer,
+                     uint32_t layerCount,
+                     Access previousAccess,
+                     bool preserveContents,
+                     Access finalAccess);
+  size_t importBuffer(const std::string& name, Access previousAccess, Access finalAccess);
+  size_t createImage(const std::string& name,
+                     VkFormat format,
+                     VkExtent2D extent,
+                     uint32_t layerCount,
+                     VkImageAspectFlags aspectMask); // Transient, its contents never survive an execution
+
+  size_t addPass(const std::string& name, const RecordFunction& recordFunction, bool sideEffects = false);
+  void read(size_t pass, size_t resource, Access access);
+  void write(size_t pass, size_t resource, Access access);
+
+  bool compile(); // Once after all passes are added, creates the transient images
+
+  void setImage(size_t resource, VkImage image, VkImageView imageView);
+  void setBuffer(size_t resource, VkBuffer buffer);
+  void execute(VkCommandBuffer commandBuffer) const; // Records all passes that were not culled
+
+  VkImage getImage(size_t resource) const;
+  VkImageView getImageView(size_t resource) const;
+  VkBuffer getBuffer(size_t resource) const;
+  size_t getCulledPassCount() const;
+  VkDeviceSize getTransientMemorySize() const; // In bytes, after aliasing
+
+private:
+  // The pipeline stages and accesses of a resource together with its image layout
+  struct State final
+  {
+    VkPipelineStageFlags2KHR stageMask = 0u;
+    VkAccessFlags2KHR accessMask = 0u;
+    VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+  };
+
+  struct Resource final
+  {
+    std::string name;
+    bool image = false, transient = false;
+    VkImageAspectFlags aspectMask = 0u;
+    uint32_t baseLayer = 0u, layerCount = 1u;
+    Access previousAccess = Access::None, finalAccess = Access::None;
+    bool preserveContents = false;
+
+    // Only for transient images
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    VkExtent2D extent = { 0u, 0u };
+    size_t memorySlot = 0u;
+
+    VkImage vkImage = nullptr;
+    VkImageView vkImageView = nullptr;
+    VkBuffer vkBuffer = nullptr;
+  };
+
+  struct Usage final
+  {
+    size_t resource;
+    State state;
+    VkImageUsageFlags imageUsage; // Needed by transient images
+    bool write;
+  };
+
+  struct Pass final
+  {
+    std::string name;
+    RecordFunction recordFunction;
+    bool sideEffects = false, culled = false;
+    std::vector<Usage> usages; // At most one per resource
+  };
+
+  struct Barrier final
+  {
+    size_t resource;
+    State source, destination;
+  };
+
+  struct Step final
+  {
+    size_t pass;
+    std::vector<Barrier> barriers; // Recorded before the pass
+  };
+
+  bool valid = true; // Cleared by invalid declarations, reported when compiling
+
+  const Context* context = nullptr;
+  MemoryAllocator* memoryAllocator = nullptr;
+  ImageViewCache* imageViewCache = nullptr;
+
+  std::vector<Resource> resources;
+  std::vector<Pass> passes;
+  std::vector<Step> steps;
+  std::vector<Barrier> finalBarriers; // Recorded after the last pass
+  std::vector<MemoryAllocation> memorySlots;
+  bool compiled = false;
+
+  void use(size_t pass, size_t resource, Access access, bool write);
+  void cullPasses();
+  bool createTransientImages();
+  void recordBarriers(VkCommandBuffer commandBuffer, const std::vector<Barrier>& barriers) const;
+};
\ No newline at end of file
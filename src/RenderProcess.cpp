@@ -1,25 +1,34 @@
 #include "RenderProcess.h"
 
 #include "Buffer.h"
+#include "DescriptorAllocator.h"
+#include "RingBuffer.h"
 #include "Util.h"
 #include <vulkan/vk_enum_string_helper.h>
 
+#include <algorithm>
+
 RenderProcess::RenderProcess(VkDevice device,
-                             VkPhysicalDevice physicalDevice,
+                             MemoryAllocator* memoryAllocator,
                              VkCommandPool commandPool,
-                             VkDescriptorPool descriptorPool,
-                             VkDescriptorSetLayout descriptorSetLayout)
-: device(device)
+                             DescriptorAllocator* descriptorAllocator,
+                             VkDescriptorSetLayout descriptorSetLayout,
+                             RingBuffer* dynamicDataBuffer,
+                             size_t objectCapacity,
+                             size_t batchCapacity,
+                             size_t swapchainImageCount)
+: device(device), dynamicDataBuffer(dynamicDataBuffer), objectCapacity(objectCapacity)
 {
   VkResult result = VK_SUCCESS;
   // Initialize the uniform buffer data
   uniformBufferData.world = glm::mat4(1.0f);
-  for (int i = 0; i < 64; i++)
-  {
-    //uniformBufferData.tracked_points[i] = glm::mat4(1.0f);
-  }
   uniformBufferData.viewProjection[0] = glm::mat4(1.0f);
   uniformBufferData.viewProjection[1] = glm::mat4(1.0f);
+  for (glm::vec4& frustumPlane : uniformBufferData.frustumPlanes)
+  {
+    frustumPlane = glm::vec4(0.0f);
+  }
+  uniformBufferData.objectCount = 0u;
 
   // Allocate a command buffer
   VkCommandBufferAllocateInfo commandBufferAllocateInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
@@ -33,6 +42,27 @@ RenderProcess::RenderProcess(VkDevice device,
     return;
   }
 
+  // Allocate an epilogue command buffer
+  if ((result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &epilogueCommandBuffer)) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan, string_VkResult(result));
+    valid = false;
+    return;
+  }
+
+  // Allocate a scene command buffer for each swapchain image
+  sceneRecordings.resize(swapchainImageCount);
+  for (SceneRecording& sceneRecording : sceneRecordings)
+  {
+    if ((result = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &sceneRecording.commandBuffer)) !=
+        VK_SUCCESS)
+    {
+      util::error(Error::GenericVulkan, string_VkResult(result));
+      valid = false;
+      return;
+    }
+  }
+
   // Create semaphores
   VkSemaphoreCreateInfo semaphoreCreateInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
   if ((result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &drawableSemaphore)) != VK_SUCCESS)
@@ -49,65 +79,72 @@ RenderProcess::RenderProcess(VkDevice device,
     return;
   }
 
-  // Create a memory fence
-  VkFenceCreateInfo fenceCreateInfo{ VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-  fenceCreateInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT; // Make sure the fence starts off signaled
-  if ((result = vkCreateFence(device, &fenceCreateInfo, nullptr, &busyFence)) != VK_SUCCESS)
+  // Create an empty storage buffer for the object data
+  const VkDeviceSize objectBufferSize = static_cast<VkDeviceSize>(sizeof(ObjectData) * objectCapacity);
+  objectBuffer =
+    new Buffer(device, memoryAllocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, objectBufferSize);
+  if (!objectBuffer->isValid())
   {
-    util::error(Error::GenericVulkan, string_VkResult(result));
     valid = false;
     return;
   }
 
-  // Create an empty uniform buffer
-  constexpr VkDeviceSize uniformBufferSize = static_cast<VkDeviceSize>(sizeof(UniformBufferData));
-  uniformBuffer =
-    new Buffer(device, physicalDevice, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBufferSize);
-  if (!uniformBuffer->isValid())
+  // The object buffer stays mapped for its whole lifetime
+  objectBufferData = objectBuffer->getMappedData();
+  if (!objectBufferData)
   {
     valid = false;
     return;
   }
 
-  // Allocate a descriptor set
-  VkDescriptorSetAllocateInfo descriptorSetAllocateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
-  descriptorSetAllocateInfo.descriptorPool = descriptorPool;
-  descriptorSetAllocateInfo.descriptorSetCount = 1u;
-  descriptorSetAllocateInfo.pSetLayouts = &descriptorSetLayout;
-  result = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &descriptorSet);
-  if (result != VK_SUCCESS)
+  // Create an empty draw buffer with room for one indirect draw command per object
+  const VkDeviceSize drawBufferSize = static_cast<VkDeviceSize>(sizeof(VkDrawIndexedIndirectCommand) * objectCapacity);
+  drawBuffer =
+    new Buffer(device, memoryAllocator, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, drawBufferSize);
+  if (!drawBuffer->isValid())
+  {
+    valid = false;
+    return;
+  }
+
+  // Create an empty count buffer with one draw count per batch
+  const VkDeviceSize countBufferSize = static_cast<VkDeviceSize>(sizeof(uint32_t) * batchCapacity);
+  countBuffer = new Buffer(device, memoryAllocator,
+                           VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+                             VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, countBufferSize);
+  if (!countBuffer->isValid())
   {
-    util::error(Error::GenericVulkan, string_VkResult(result));
     valid = false;
     return;
   }
 
-  // Associate the descriptor set with the uniform buffer
-  VkDescriptorBufferInfo descriptorBufferInfo;
-  descriptorBufferInfo.buffer = uniformBuffer->getVkBuffer();
-  descriptorBufferInfo.offset = 0u;
-  descriptorBufferInfo.range = VK_WHOLE_SIZE;
-
-  VkWriteDescriptorSet writeDescriptorSet;
-  writeDescriptorSet.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-  writeDescriptorSet.pNext = nullptr;
-  writeDescriptorSet.dstSet = descriptorSet;
-  writeDescriptorSet.dstBinding = 0u;
-  writeDescriptorSet.dstArrayElement = 0u;
-  writeDescriptorSet.descriptorCount = 1u;
-  writeDescriptorSet.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  writeDescriptorSet.pBufferInfo = &descriptorBufferInfo;
-  writeDescriptorSet.pImageInfo = nullptr;
-  writeDescriptorSet.pTexelBufferView = nullptr;
-  vkUpdateDescriptorSets(device, 1u, &writeDescriptorSet, 0u, nullptr);
+  // Acquire a descriptor set for the dynamic data buffer and the object, draw and count storage buffers, the uniform
+  // buffer data is located by dynamic offset
+  const std::vector<DescriptorAllocator::BufferBinding> bindings = {
+    { 0u, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, dynamicDataBuffer->getVkBuffer(), 0u,
+      static_cast<VkDeviceSize>(sizeof(UniformBufferData)) },
+    { 1u, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, objectBuffer->getVkBuffer(), 0u, VK_WHOLE_SIZE },
+    { 2u, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, drawBuffer->getVkBuffer(), 0u, VK_WHOLE_SIZE },
+    { 3u, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, countBuffer->getVkBuffer(), 0u, VK_WHOLE_SIZE }
+  };
+
+  descriptorSet = descriptorAllocator->acquire(descriptorSetLayout, bindings);
+  if (!descriptorSet)
+  {
+    valid = false;
+    return;
+  }
 }
 
 RenderProcess::~RenderProcess()
 {
-  delete uniformBuffer;
+  delete countBuffer;
+  delete drawBuffer;
+  delete objectBuffer;
 
-  vkDestroyFence(device, busyFence, nullptr);
   vkDestroySemaphore(device, presentableSemaphore, nullptr);
   vkDestroySemaphore(device, drawableSemaphore, nullptr);
 }
@@ -122,6 +159,11 @@ VkCommandBuffer RenderProcess::getCommandBuffer() const
   return commandBuffer;
 }
 
+VkCommandBuffer RenderProcess::getEpilogueCommandBuffer() const
+{
+  return epilogueCommandBuffer;
+}
+
 VkSemaphore RenderProcess::getDrawableSemaphore() const
 {
   return drawableSemaphore;
@@ -132,26 +174,51 @@ VkSemaphore RenderProcess::getPresentableSemaphore() const
   return presentableSemaphore;
 }
 
-VkFence RenderProcess::getBusyFence() const
+VkDescriptorSet RenderProcess::getDescriptorSet() const
+{
+  return descriptorSet;
+}
+
+uint32_t RenderProcess::getUniformBufferOffset() const
 {
-  return busyFence;
+  return uniformBufferOffset;
 }
 
-VkDescriptorSet RenderProcess::getDescriptorSet() const
+VkBuffer RenderProcess::getDrawBuffer() const
 {
-  return descriptorSet;
+  return drawBuffer->getVkBuffer();
 }
 
-bool RenderProcess::updateUniformBufferData() const
+VkBuffer RenderProcess::getCountBuffer() const
 {
-  void* data = uniformBuffer->map();
-  if (!data)
+  return countBuffer->getVkBuffer();
+}
+
+bool RenderProcess::updateUniformBufferData()
+{
+  // The uniform buffer data is allocated first so it keeps its offset and only changed blocks are written
+  if (!dynamicDataBuffer->allocate(static_cast<VkDeviceSize>(sizeof(UniformBufferData)), uniformBufferOffset))
   {
     return false;
   }
 
-  memcpy(data, &uniformBufferData, sizeof(UniformBufferData));
-  uniformBuffer->unmap();
+  dynamicDataBuffer->write(uniformBufferOffset, &uniformBufferData, sizeof(UniformBufferData));
+  return true;
+}
+
+void RenderProcess::latchUniformBufferData() const
+{
+  dynamicDataBuffer->write(uniformBufferOffset, &uniformBufferData, sizeof(UniformBufferData));
+}
+
+bool RenderProcess::updateObjectData() const
+{
+  if (objectData.empty())
+  {
+    return true;
+  }
 
+  const size_t count = std::min(objectData.size(), objectCapacity);
+  memcpy(objectBufferData, objectData.data(), sizeof(ObjectData) * count);
   return true;
 }
\ No newline at end of file
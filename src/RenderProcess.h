@@ -4,41 +4,83 @@
 
 #include <vulkan/vulkan.h>
 
+#include <vector>
+
 class Buffer;
+class DescriptorAllocator;
+class MemoryAllocator;
+class RingBuffer;
 
 class RenderProcess final
 {
 public:
   RenderProcess(VkDevice device,
-                VkPhysicalDevice physicalDevice,
+                MemoryAllocator* memoryAllocator,
                 VkCommandPool commandPool,
-                VkDescriptorPool descriptorPool,
-                VkDescriptorSetLayout descriptorSetLayout);
+                DescriptorAllocator* descriptorAllocator,
+                VkDescriptorSetLayout descriptorSetLayout,
+                RingBuffer* dynamicDataBuffer,
+                size_t objectCapacity,
+                size_t batchCapacity,
+                size_t swapchainImageCount);
   ~RenderProcess();
 
   struct UniformBufferData final
   {
     glm::mat4 world;
-    glm::mat4 tracked_points[64];
     glm::mat4 viewProjection[2];
+    glm::vec4 frustumPlanes[12]; // Six planes per eye
+    uint32_t objectCount;
   } uniformBufferData;
 
+  struct ObjectData final
+  {
+    glm::mat4 transform;
+    glm::vec4 boundingSphere; // Center and radius in object space
+    uint32_t firstIndex, indexCount;
+    uint32_t batchIndex, drawOffset; // Draw offset is the first draw command of the batch
+  };
+
+  // Objects grouped by batch, capped at the object capacity
+  std::vector<ObjectData> objectData;
+
+  // Value of the frame timeline semaphore once the GPU is done with this render process
+  uint64_t frameValue = 0u;
+
+  // A command buffer that draws the scene into one swapchain image, only recorded again when the draw list changes
+  struct SceneRecording final
+  {
+    VkCommandBuffer commandBuffer = nullptr;
+    uint64_t drawListVersion = 0u; // Zero if never recorded
+    uint32_t uniformBufferOffset = 0u;
+  };
+  std::vector<SceneRecording> sceneRecordings; // One per swapchain image
+
   bool isValid() const;
   VkCommandBuffer getCommandBuffer() const;
+  VkCommandBuffer getEpilogueCommandBuffer() const;
   VkSemaphore getDrawableSemaphore() const;
   VkSemaphore getPresentableSemaphore() const;
-  VkFence getBusyFence() const;
   VkDescriptorSet getDescriptorSet() const;
+  uint32_t getUniformBufferOffset() const;
+  VkBuffer getDrawBuffer() const;
+  VkBuffer getCountBuffer() const;
 
-  bool updateUniformBufferData() const;
+  bool updateUniformBufferData();
+  void latchUniformBufferData() const; // Writes the data again at the offset the frame was recorded with
+  bool updateObjectData() const;
 
 private:
   bool valid = true;
 
   VkDevice device = nullptr;
   VkCommandBuffer commandBuffer = nullptr;
+  VkCommandBuffer epilogueCommandBuffer = nullptr; // Recorded after the scene recordings
   VkSemaphore drawableSemaphore = nullptr, presentableSemaphore = nullptr;
-  VkFence busyFence = nullptr;
-  Buffer* uniformBuffer = nullptr;
+  RingBuffer* dynamicDataBuffer = nullptr;
+  uint32_t uniformBufferOffset = 0u; // Dynamic offset into the dynamic data buffer
+  Buffer *objectBuffer = nullptr, *drawBuffer = nullptr, *countBuffer = nullptr;
+  void* objectBufferData = nullptr;
+  size_t objectCapacity = 0u;
   VkDescriptorSet descriptorSet = nullptr;
 };
\ No newline at end of file
@@ -2,31 +2,19 @@
 
 #include "Util.h"
 
+#include <vector>
+
 RenderTarget::RenderTarget(VkDevice device,
                            VkImage image,
+                           VkImageView imageView,
                            VkImageView depthImageView,
                            VkExtent2D size,
-                           VkFormat format,
-                           VkRenderPass renderPass,
-                           uint32_t layerCount)
-: device(device), image(image)
+                           VkRenderPass renderPass)
+: device(device), image(image), imageView(imageView)
 {
-  // Create an image view
-  VkImageViewCreateInfo imageViewCreateInfo{ VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-  imageViewCreateInfo.image = image;
-  imageViewCreateInfo.format = format;
-  imageViewCreateInfo.viewType = (layerCount == 1u ? VK_IMAGE_VIEW_TYPE_2D : VK_IMAGE_VIEW_TYPE_2D_ARRAY);
-  imageViewCreateInfo.components = { VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY,
-                                     VK_COMPONENT_SWIZZLE_IDENTITY, VK_COMPONENT_SWIZZLE_IDENTITY };
-  imageViewCreateInfo.subresourceRange.layerCount = layerCount;
-  imageViewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-  imageViewCreateInfo.subresourceRange.baseArrayLayer = 0u;
-  imageViewCreateInfo.subresourceRange.baseMipLevel = 0u;
-  imageViewCreateInfo.subresourceRange.levelCount = 1u;
-  if (vkCreateImageView(device, &imageViewCreateInfo, nullptr, &imageView) != VK_SUCCESS)
+  // Dynamic rendering takes the image views directly
+  if (!renderPass)
   {
-    util::error(Error::GenericVulkan);
-    valid = false;
     return;
   }
 
@@ -55,7 +43,6 @@ RenderTarget::RenderTarget(VkDevice device,
 RenderTarget::~RenderTarget()
 {
   vkDestroyFramebuffer(device, framebuffer, nullptr);
-  vkDestroyImageView(device, imageView, nullptr);
 }
 
 bool RenderTarget::isValid() const
@@ -68,7 +55,12 @@ VkImage RenderTarget::getImage() const
   return image;
 }
 
+VkImageView RenderTarget::getImageView() const
+{
+  return imageView;
+}
+
 VkFramebuffer RenderTarget::getFramebuffer() const
 {
   return framebuffer;
-}
+}
\ No newline at end of file
@@ -7,15 +7,15 @@ class RenderTarget final
 public:
   RenderTarget(VkDevice device,
                VkImage image,
+               VkImageView imageView,
                VkImageView depthImageView,
                VkExtent2D size,
-               VkFormat format,
-               VkRenderPass renderPass,
-               uint32_t layerCount);
+               VkRenderPass renderPass); // No framebuffer is created without a render pass
   ~RenderTarget();
 
   bool isValid() const;
   VkImage getImage() const;
+  VkImageView getImageView() const;
   VkFramebuffer getFramebuffer() const;
 
 private:
@@ -23,6 +23,6 @@ private:
 
   VkDevice device = nullptr;
   VkImage image = nullptr;
-  VkImageView imageView = nullptr;
+  VkImageView imageView = nullptr; // Owned by the image view cache
   VkFramebuffer framebuffer = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "RenderThread.h"
+
+#include "Util.h"
+
+#include <iostream>
+
+RenderThread::RenderThread(int core, bool highPriority)
+{
+  // Start the thread
+  thread = std::thread(&RenderThread::work, this, core, highPriority);
+}
+
+RenderThread::~RenderThread()
+{
+  // Let the thread finish the frame in progress
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    exitRequested = true;
+  }
+  frameCondition.notify_one();
+
+  thread.join();
+}
+
+void RenderThread::start(const FrameFunction& frameFunction)
+{
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    doneCondition.wait(lock, [this] { return !busy; });
+    if (failed)
+    {
+      return;
+    }
+
+    this->frameFunction = frameFunction;
+    busy = true;
+  }
+  frameCondition.notify_one();
+}
+
+void RenderThread::wait()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  doneCondition.wait(lock, [this] { return !busy; });
+}
+
+bool RenderThread::isFailed()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return failed;
+}
+
+void RenderThread::work(int core, bool highPriority)
+{
+  if ((core >= 0 || highPriority) && !util::setThreadPlacement(core, highPriority))
+  {
+    std::cout << "Render thread placement was refused, it runs wherever the scheduler puts it\n";
+  }
+
+  while (true)
+  {
+    FrameFunction function;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      frameCondition.wait(lock, [this] { return busy || exitRequested; });
+      if (!busy)
+      {
+        return;
+      }
+
+      function = frameFunction;
+    }
+
+    // Run the frame without holding the lock, the frame thread only checks whether it is done meanwhile
+    const bool success = function();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      failed = failed || !success;
+      busy = false;
+    }
+    doneCondition.notify_all();
+  }
+}
\ No newline at end of file
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+// Runs one frame at a time on a dedicated thread, so that the thread handing out the frames can already wait for the
+// next frame while the previous one is still recorded, submitted and ended
+class RenderThread final
+{
+public:
+  RenderThread(int core, bool highPriority); // A negative core leaves the placement to the scheduler
+  ~RenderThread();                           // Finishes the frame in progress
+
+  // Renders and ends a frame, returns false on error
+  using FrameFunction = std::function<bool()>;
+
+  void start(const FrameFunction& frameFunction); // Waits for the frame in progress first
+  void wait();                                    // Blocks until no frame is in progress
+
+  bool isFailed(); // A frame function returned false, no further frames are run
+
+private:
+  std::thread thread;
+
+  // Guarded by the mutex
+  std::mutex mutex;
+  std::condition_variable frameCondition, doneCondition;
+  FrameFunction frameFunction;
+  bool busy = false, failed = false, exitRequested = false;
+
+  void work(int core, bool highPriority);
+};
\ No newline at end of file
@@ -1,22 +1,49 @@
 #include "Renderer.h"
 
 #include "Buffer.h"
+#include "CommandRecorder.h"
 #include "Context.h"
+#include "DescriptorAllocator.h"
+#include "DynamicState.h"
 #include "Headset.h"
+#include "InputSampler.h"
 #include "Pipeline.h"
+#include "PipelineCache.h"
+#include "PipelineCompiler.h"
+#include "PipelineRegistry.h"
+#include "RenderGraph.h"
 #include "RenderProcess.h"
 #include "RenderTarget.h"
+#include "RingBuffer.h"
+#include "ShaderRegistry.h"
+#include "Uploader.h"
 #include "Util.h"
 
 #include <vulkan/vk_enum_string_helper.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <iostream>
+#include <thread>
 
 namespace
 {
-constexpr size_t numFramesInFlight = 2u;
+constexpr size_t maxObjectCount = 262144u;             // Capacity of the object and draw buffers per frame in flight
+constexpr size_t maxBatchCount = 16u;                  // Capacity of the count buffer per frame in flight
+constexpr uint32_t cullWorkgroupSize = 64u;            // Specialized into Cull.comp as its local size
+constexpr VkDeviceSize dynamicDataRegionSize = 65536u; // Capacity of the dynamic data buffer per frame in flight
+constexpr const char* pipelineCacheFilename = "pipelines.cache";
+
+// Materials of the Basic.frag variants, must match the material constants in the shader
+constexpr uint32_t cubeMaterial = 0u;
+constexpr uint32_t gridMaterial = 1u;
+
+// Fixed function state of the materials, cubes are opaque while the grid fades out with alpha blending
+constexpr RenderState cubeRenderState = { .blend = false };
+constexpr RenderState gridRenderState = {};
 
 struct Vertex final
 {
@@ -58,12 +85,59 @@ constexpr std::array<uint16_t, 42u> indices = { 0u,  1u,  2u,  1u,  2u,  3u,  4u
                                                 8u,  9u,  10u, 9u,  10u, 11u, 12u, 13u, 14u, 13u, 14u, 15u,
                                                 16u, 17u, 18u, 17u, 18u, 19u, 20u, 21u, 22u, 20u, 22u, 23u,
                                                 24u, 25u, 26u, 24u, 26u, 27u };
+
+// A range of the index buffer with a bounding sphere in object space
+struct Mesh final
+{
+  uint32_t firstIndex, indexCount;
+  glm::vec4 boundingSphere;
+};
+
+constexpr Mesh gridMesh = { 0u, 6u, { 0.0f, 0.0f, 0.0f, 28.3f } };
+constexpr Mesh cubeMesh = { 6u, 36u, { 0.0f, 0.7f, -3.0f, 1.25f } };
+
+RenderProcess::ObjectData makeObject(const Mesh& mesh, const glm::mat4& transform, uint32_t batchIndex)
+{
+  RenderProcess::ObjectData object;
+  object.transform = transform;
+  object.boundingSphere = mesh.boundingSphere;
+  object.firstIndex = mesh.firstIndex;
+  object.indexCount = mesh.indexCount;
+  object.batchIndex = batchIndex;
+  object.drawOffset = 0u;
+  return object;
+}
+
+constexpr size_t firstTrackedPointObject = 2u; // The tracked points follow the grid and cube
+
+// Place a cube at a tracked point, the controllers are drawn larger than the hand joints
+glm::mat4 makeTrackedPointTransform(const XrPosef& pose, size_t pointIndex)
+{
+  float handScaleAll1 = 0.1;
+  float handScaleAll2 = 0.01;
+  glm::vec3 handScale1 = glm::vec3(handScaleAll1 * (1.0 / 2.0), handScaleAll1 * (1.0 / 2.0), handScaleAll1 * (1.0 / 2.0));
+  glm::vec3 handScale2 = glm::vec3(handScaleAll2 * (1.0 / 2.0), handScaleAll2 * (1.0 / 2.0), handScaleAll2 * (1.0 / 2.0));
+
+  glm::mat4 trans1 = glm::translate(glm::mat4(1.0f), { 0.0f, -1.4f/2.0, 2.0f });
+  glm::mat4 scale1 = glm::scale(glm::mat4(1.0f), pointIndex < 2 ? handScale1 : handScale2);
+  glm::mat4 trans2_l = glm::translate(glm::mat4(1.0f), { pose.position.x, pose.position.y, pose.position.z });
+  glm::quat rot_l_q = glm::quat(pose.orientation.w, pose.orientation.x, pose.orientation.y, pose.orientation.z);
+  glm::mat4 rot_l = glm::toMat4(rot_l_q);
+  return trans2_l * rot_l * scale1 * trans1;
+}
 } // namespace
 
-Renderer::Renderer(const Context* context, const Headset* headset) : context(context), headset(headset)
+Renderer::Renderer(const Context* context,
+                   const Headset* headset,
+                   size_t framesInFlight,
+                   size_t recordingThreadCount,
+                   bool staticCommandBuffers,
+                   const std::string& shaderOverrideDirectory)
+: context(context), headset(headset), staticCommandBuffers(staticCommandBuffers)
 {
   const VkPhysicalDevice vkPhysicalDevice = context->getVkPhysicalDevice();
   const VkDevice vkDevice = context->getVkDevice();
+  MemoryAllocator* memoryAllocator = context->getMemoryAllocator();
   VkResult result = VK_SUCCESS;
 
   // Create a command pool
@@ -77,32 +151,85 @@ Renderer::Renderer(const Context* context, const Headset* headset) : context(con
     return;
   }
 
-  // Create a descriptor pool
-  VkDescriptorPoolSize descriptorPoolSize;
-  descriptorPoolSize.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  descriptorPoolSize.descriptorCount = 16u;
+  // Create a command recorder for the secondary command buffers of each frame in flight
+  commandRecorder =
+    new CommandRecorder(vkDevice, context->getVkDrawQueueFamilyIndex(), framesInFlight, recordingThreadCount);
+  if (!commandRecorder->isValid())
+  {
+    valid = false;
+    return;
+  }
+
+  // Create a timeline semaphore that reaches the value of each frame once the GPU is done with it
+  VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+  semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  semaphoreTypeCreateInfo.initialValue = frameValue;
 
-  VkDescriptorPoolCreateInfo descriptorPoolCreateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
-  descriptorPoolCreateInfo.poolSizeCount = 16u;
-  descriptorPoolCreateInfo.pPoolSizes = &descriptorPoolSize;
-  descriptorPoolCreateInfo.maxSets = static_cast<uint32_t>(numFramesInFlight);
-  if ((result = vkCreateDescriptorPool(vkDevice, &descriptorPoolCreateInfo, nullptr, &descriptorPool)) != VK_SUCCESS)
+  VkSemaphoreCreateInfo semaphoreCreateInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+  semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+  if ((result = vkCreateSemaphore(vkDevice, &semaphoreCreateInfo, nullptr, &frameSemaphore)) != VK_SUCCESS)
   {
     util::error(Error::GenericVulkan, string_VkResult(result));
     valid = false;
     return;
   }
 
+  // Create a query pool with a timestamp at the beginning and end of each frame in flight, if timestamps are supported
+  VkPhysicalDeviceProperties physicalDeviceProperties;
+  vkGetPhysicalDeviceProperties(vkPhysicalDevice, &physicalDeviceProperties);
+
+  uint32_t queueFamilyCount = 0u;
+  vkGetPhysicalDeviceQueueFamilyProperties(vkPhysicalDevice, &queueFamilyCount, nullptr);
+  std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
+  vkGetPhysicalDeviceQueueFamilyProperties(vkPhysicalDevice, &queueFamilyCount, queueFamilies.data());
+  const uint32_t timestampValidBits = queueFamilies.at(context->getVkDrawQueueFamilyIndex()).timestampValidBits;
+
+  if (physicalDeviceProperties.limits.timestampComputeAndGraphics && timestampValidBits > 0u)
+  {
+    timestampPeriod = physicalDeviceProperties.limits.timestampPeriod;
+    timestampMask = (timestampValidBits >= 64u) ? ~0ull : ((1ull << timestampValidBits) - 1ull);
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo{ VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    queryPoolCreateInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolCreateInfo.queryCount = static_cast<uint32_t>(framesInFlight * 2u);
+    if ((result = vkCreateQueryPool(vkDevice, &queryPoolCreateInfo, nullptr, &timestampQueryPool)) != VK_SUCCESS)
+    {
+      util::error(Error::GenericVulkan, string_VkResult(result));
+      valid = false;
+      return;
+    }
+  }
+
+  // Create a descriptor allocator with one set of pools for each frame in flight
+  descriptorAllocator = new DescriptorAllocator(vkDevice, framesInFlight);
+
   // Create a descriptor set layout
-  VkDescriptorSetLayoutBinding descriptorSetLayoutBinding{};
-  descriptorSetLayoutBinding.binding = 0u;
-  descriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-  descriptorSetLayoutBinding.descriptorCount = 1u;
-  descriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+  VkDescriptorSetLayoutBinding uniformBufferDescriptorSetLayoutBinding{};
+  uniformBufferDescriptorSetLayoutBinding.binding = 0u;
+  uniformBufferDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+  uniformBufferDescriptorSetLayoutBinding.descriptorCount = 1u;
+  uniformBufferDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutBinding objectDescriptorSetLayoutBinding{};
+  objectDescriptorSetLayoutBinding.binding = 1u;
+  objectDescriptorSetLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+  objectDescriptorSetLayoutBinding.descriptorCount = 1u;
+  objectDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutBinding drawDescriptorSetLayoutBinding = objectDescriptorSetLayoutBinding;
+  drawDescriptorSetLayoutBinding.binding = 2u;
+  drawDescriptorSetLayoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+  VkDescriptorSetLayoutBinding countDescriptorSetLayoutBinding = drawDescriptorSetLayoutBinding;
+  countDescriptorSetLayoutBinding.binding = 3u;
+
+  const std::array descriptorSetLayoutBindings = { uniformBufferDescriptorSetLayoutBinding,
+                                                   objectDescriptorSetLayoutBinding, drawDescriptorSetLayoutBinding,
+                                                   countDescriptorSetLayoutBinding };
 
   VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo{ VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
-  descriptorSetLayoutCreateInfo.bindingCount = 1u;
-  descriptorSetLayoutCreateInfo.pBindings = &descriptorSetLayoutBinding;
+  descriptorSetLayoutCreateInfo.bindingCount = static_cast<uint32_t>(descriptorSetLayoutBindings.size());
+  descriptorSetLayoutCreateInfo.pBindings = descriptorSetLayoutBindings.data();
   if ((result = vkCreateDescriptorSetLayout(vkDevice, &descriptorSetLayoutCreateInfo, nullptr, &descriptorSetLayout)) !=
       VK_SUCCESS)
   {
@@ -122,11 +249,22 @@ Renderer::Renderer(const Context* context, const Headset* headset) : context(con
     return;
   }
 
+  // Create a dynamic data buffer with one region for each frame in flight
+  dynamicDataBuffer = new RingBuffer(vkDevice, vkPhysicalDevice, memoryAllocator, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                     dynamicDataRegionSize, framesInFlight);
+  if (!dynamicDataBuffer->isValid())
+  {
+    valid = false;
+    return;
+  }
+
   // Create a render process for each frame in flight
-  renderProcesses.resize(numFramesInFlight);
+  renderProcesses.resize(framesInFlight);
   for (RenderProcess*& renderProcess : renderProcesses)
   {
-    renderProcess = new RenderProcess(vkDevice, vkPhysicalDevice, commandPool, descriptorPool, descriptorSetLayout);
+    renderProcess =
+      new RenderProcess(vkDevice, memoryAllocator, commandPool, descriptorAllocator, descriptorSetLayout,
+                        dynamicDataBuffer, maxObjectCount, maxBatchCount, headset->getSwapchainImageCount());
     if (!renderProcess->isValid())
     {
       valid = false;
@@ -134,7 +272,31 @@ Renderer::Renderer(const Context* context, const Headset* headset) : context(con
     }
   }
 
-  // Create the grid pipeline
+  // Create a pipeline cache from the previous run
+  pipelineCache = new PipelineCache(vkDevice, vkPhysicalDevice, pipelineCacheFilename);
+  if (!pipelineCache->isValid())
+  {
+    valid = false;
+    return;
+  }
+
+  // Create a shader registry, all pipeline variants share its shader modules
+  shaderRegistry = new ShaderRegistry(vkDevice, shaderOverrideDirectory);
+  if (!shaderRegistry->isValid())
+  {
+    valid = false;
+    return;
+  }
+
+  // Determine which fixed function state can be set on the command buffer instead of being baked into pipelines
+  dynamicState = new DynamicState(vkDevice, context->isExtendedDynamicStateSupported(),
+                                  context->isExtendedDynamicState2Supported(),
+                                  context->isExtendedDynamicState3Supported());
+
+  // Create a pipeline compiler
+  pipelineCompiler = new PipelineCompiler(std::max(std::thread::hardware_concurrency(), 1u));
+
+  // Describe the vertex input shared by all graphics pipelines
   VkVertexInputBindingDescription vertexInputBindingDescription;
   vertexInputBindingDescription.binding = 0u;
   vertexInputBindingDescription.stride = sizeof(Vertex);
@@ -152,211 +314,678 @@ Renderer::Renderer(const Context* context, const Headset* headset) : context(con
   vertexInputAttributeDescriptionColor.format = VK_FORMAT_R32G32B32_SFLOAT;
   vertexInputAttributeDescriptionColor.offset = offsetof(Vertex, color);
 
-  gridPipeline = new Pipeline(vkDevice, pipelineLayout, headset->getRenderPass(), "shaders/Basic.vert.spv",
-                              "shaders/Grid.frag.spv", { vertexInputBindingDescription },
-                              { vertexInputAttributeDescriptionPosition, vertexInputAttributeDescriptionColor });
-  if (!gridPipeline->isValid())
+  const std::vector<VkVertexInputBindingDescription> vertexInputBindingDescriptions = { vertexInputBindingDescription };
+  const std::vector<VkVertexInputAttributeDescription> vertexInputAttributeDescriptions = {
+    vertexInputAttributeDescriptionPosition, vertexInputAttributeDescriptionColor
+  };
+
+  // Compile all pipelines at once, the ones the first frame needs are requested first
+  const VkPipelineCache vkPipelineCache = pipelineCache->getVkPipelineCache();
+  const VkPipelineLayout vkPipelineLayout = pipelineLayout;
+  const VkShaderModule vertexShaderModule = shaderRegistry->getShaderModule(ShaderRegistry::Shader::BasicVertex);
+  const VkShaderModule fragmentShaderModule = shaderRegistry->getShaderModule(ShaderRegistry::Shader::BasicFragment);
+  const VkShaderModule computeShaderModule = shaderRegistry->getShaderModule(ShaderRegistry::Shader::CullCompute);
+  const bool creationFeedback = context->isPipelineCreationFeedbackSupported();
+  const std::chrono::steady_clock::time_point pipelineCreationBegin = std::chrono::steady_clock::now();
+
+  // Create a pipeline registry for the graphics pipelines, identical descriptions share one pipeline
+  pipelineRegistry = new PipelineRegistry(vkDevice, vkPipelineCache, vkPipelineLayout, dynamicState, pipelineCompiler,
+                                          context->isGraphicsPipelineLibrarySupported(), creationFeedback);
+
+  // The cube pipeline is cheap to compile and stands in for the grid pipeline until that is ready
+  PipelineRegistry::Description pipelineDescription;
+  pipelineDescription.name = "Cube";
+  pipelineDescription.renderPass = headset->getRenderPass();
+  pipelineDescription.renderingFormats = { headset->getViewMask(), headset->getColorFormat(),
+                                           headset->getDepthFormat() };
+  pipelineDescription.vertexShaderModule = vertexShaderModule;
+  pipelineDescription.fragmentShaderModule = fragmentShaderModule;
+  pipelineDescription.fragmentSpecialization = cubeMaterial;
+  pipelineDescription.vertexInputBindingDescriptions = vertexInputBindingDescriptions;
+  pipelineDescription.vertexInputAttributeDescriptions = vertexInputAttributeDescriptions;
+  pipelineDescription.renderState = cubeRenderState;
+  cubePipelineHandle = pipelineRegistry->acquire(pipelineDescription);
+
+  // Without the cull pipeline objects are culled on the CPU and drawn one by one, the choice is made for the whole run
+  size_t cullPipelineJob = 0u;
+  if (context->isDrawIndirectCountSupported())
   {
-    valid = false;
-    return;
+    const VkSpecializationInfo cullSpecializationInfo = util::makeSpecializationInfo(cullWorkgroupSize);
+    cullPipelineJob = pipelineCompiler->compile(
+      [vkDevice, vkPipelineCache, vkPipelineLayout, computeShaderModule, cullSpecializationInfo, creationFeedback]
+      {
+        return new Pipeline(vkDevice, vkPipelineCache, vkPipelineLayout, computeShaderModule, &cullSpecializationInfo,
+                            creationFeedback);
+      });
   }
 
-  // Create the cube pipeline
-  cubePipeline = new Pipeline(vkDevice, pipelineLayout, headset->getRenderPass(), "shaders/Basic.vert.spv",
-                              "shaders/Cube.frag.spv", { vertexInputBindingDescription },
-                              { vertexInputAttributeDescriptionPosition, vertexInputAttributeDescriptionColor });
-  if (!cubePipeline->isValid())
+  pipelineDescription.name = "Grid";
+  pipelineDescription.fragmentSpecialization = gridMaterial;
+  pipelineDescription.renderState = gridRenderState;
+  gridPipelineHandle = pipelineRegistry->acquire(pipelineDescription);
+
+  // Wait for the pipelines the first frame needs
+  cubePipeline = pipelineRegistry->wait(cubePipelineHandle);
+  if (!cubePipeline)
   {
     valid = false;
     return;
   }
 
-  for (int i = 0; i < 64; i++) {
-    char tmp[256];
-    snprintf(tmp, 256, "shaders/Pt%u.vert.spv", i);
-    // Create the cube pipeline
-    trackedPipeline[i] = new Pipeline(vkDevice, pipelineLayout, headset->getRenderPass(), tmp,
-                                "shaders/Cube.frag.spv", { vertexInputBindingDescription },
-                                { vertexInputAttributeDescriptionPosition, vertexInputAttributeDescriptionColor });
-    if (!trackedPipeline[i]->isValid())
+  if (context->isDrawIndirectCountSupported())
+  {
+    cullPipeline = pipelineCompiler->wait(cullPipelineJob);
+    if (!cullPipeline || !cullPipeline->isValid())
     {
       valid = false;
       return;
     }
   }
 
-  // Create a vertex buffer
+  // Report how long the first frame waited for its pipelines, a warm cache is expected to be much faster
+  const float pipelineCreationTime =
+    std::chrono::duration<float>(std::chrono::steady_clock::now() - pipelineCreationBegin).count();
+  std::cout << "Pipeline cache: " << (pipelineCache->isWarm() ? "warm" : "cold")
+            << " start, first frame pipelines after " << pipelineCreationTime * 1000.0f << " ms\n";
+  if (cullPipeline)
   {
-    // Create a staging buffer and fill it with the vertex data
-    constexpr size_t size = sizeof(vertices);
-    Buffer* stagingBuffer = new Buffer(vkDevice, vkPhysicalDevice, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                       static_cast<VkDeviceSize>(size), static_cast<const void*>(vertices.data()));
-    if (!stagingBuffer->isValid())
-    {
-      valid = false;
-      return;
-    }
+    cullPipeline->report("Cull");
+  }
 
-    // Create an empty target buffer
-    vertexBuffer =
-      new Buffer(vkDevice, vkPhysicalDevice, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, static_cast<VkDeviceSize>(size));
-    if (!vertexBuffer->isValid())
-    {
-      valid = false;
-      return;
-    }
+  // Create a render graph for the scene, without GPU culling it is a single pass
+  renderGraph = new RenderGraph(context);
+  eyeImageResource = renderGraph->importImage("Eye", VK_IMAGE_ASPECT_COLOR_BIT, 0u, 2u,
+                                              RenderGraph::Access::ColorAttachmentWrite, false,
+                                              RenderGraph::Access::ColorAttachmentWrite);
+  if (headset->getRenderPass())
+  {
+    depthImageResource = renderGraph->importImage("Depth", VK_IMAGE_ASPECT_DEPTH_BIT, 0u, 2u,
+                                                  RenderGraph::Access::DepthAttachmentWrite, false,
+                                                  RenderGraph::Access::None);
+  }
+  else
+  {
+    // Dynamic rendering does not need the depth buffer before recording, so the render graph can own it
+    depthImageResource = renderGraph->createImage("Depth", headset->getDepthFormat(), headset->getEyeResolution(0u),
+                                                  2u, VK_IMAGE_ASPECT_DEPTH_BIT);
+  }
 
-    // Copy from the staging to the target buffer
-    if (!stagingBuffer->copyTo(*vertexBuffer, renderProcesses.at(0u)->getCommandBuffer(), context->getVkDrawQueue()))
-    {
-      valid = false;
-      return;
-    }
+  if (cullPipeline)
+  {
+    drawBufferResource =
+      renderGraph->importBuffer("Draws", RenderGraph::Access::None, RenderGraph::Access::IndirectRead);
+    countBufferResource =
+      renderGraph->importBuffer("Counts", RenderGraph::Access::None, RenderGraph::Access::IndirectRead);
+
+    // Reset the draw counts of all batches
+    const size_t resetPass = renderGraph->addPass(
+      "Reset counts", [this](VkCommandBuffer commandBuffer)
+      { vkCmdFillBuffer(commandBuffer, renderGraph->getBuffer(countBufferResource), 0u, VK_WHOLE_SIZE, 0u); });
+    renderGraph->write(resetPass, countBufferResource, RenderGraph::Access::TransferWrite);
+
+    // Cull the objects on the GPU into the draw and count buffers
+    const size_t cullPass = renderGraph->addPass("Cull",
+                                                 [this](VkCommandBuffer commandBuffer)
+                                                 {
+                                                   if (recordingContext.geometryAvailable)
+                                                   {
+                                                     recordCulling(commandBuffer, recordingContext.renderProcess);
+                                                   }
+                                                 });
+    renderGraph->read(cullPass, countBufferResource, RenderGraph::Access::ComputeShaderRead);
+    renderGraph->write(cullPass, countBufferResource, RenderGraph::Access::ComputeShaderWrite);
+    renderGraph->write(cullPass, drawBufferResource, RenderGraph::Access::ComputeShaderWrite);
+  }
 
-    // Clean up the staging buffer
-    delete stagingBuffer;
+  const size_t scenePass =
+    renderGraph->addPass("Scene", [this](VkCommandBuffer commandBuffer) { recordScenePass(commandBuffer); });
+  renderGraph->write(scenePass, eyeImageResource, RenderGraph::Access::ColorAttachmentWrite);
+  renderGraph->write(scenePass, depthImageResource, RenderGraph::Access::DepthAttachmentWrite);
+  if (cullPipeline)
+  {
+    renderGraph->read(scenePass, drawBufferResource, RenderGraph::Access::IndirectRead);
+    renderGraph->read(scenePass, countBufferResource, RenderGraph::Access::IndirectRead);
   }
 
-  // Create an index buffer
+  if (!renderGraph->compile())
   {
-    // Create a staging buffer and fill it with the index data
-    constexpr size_t size = sizeof(indices);
-    Buffer* stagingBuffer = new Buffer(vkDevice, vkPhysicalDevice, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                       VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                                       static_cast<VkDeviceSize>(size), static_cast<const void*>(indices.data()));
-    if (!stagingBuffer->isValid())
-    {
-      valid = false;
-      return;
-    }
+    valid = false;
+    return;
+  }
 
-    // Create an empty target buffer
-    indexBuffer =
-      new Buffer(vkDevice, vkPhysicalDevice, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, static_cast<VkDeviceSize>(size));
-    if (!indexBuffer->isValid())
-    {
-      valid = false;
-      return;
-    }
+  std::cout << "Render graph: " << renderGraph->getCulledPassCount() << " passes culled, "
+            << renderGraph->getTransientMemorySize() / 1024u << " KiB of transient memory\n";
 
-    // Copy from the staging to the target buffer
-    if (!stagingBuffer->copyTo(*indexBuffer, renderProcesses.at(0u)->getCommandBuffer(), context->getVkDrawQueue()))
-    {
-      valid = false;
-      return;
-    }
+  // Create an uploader
+  uploader = new Uploader(context);
+  if (!uploader->isValid())
+  {
+    valid = false;
+    return;
+  }
+
+  // Create an empty vertex buffer and upload the vertex data
+  vertexBuffer =
+    new Buffer(vkDevice, memoryAllocator, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, static_cast<VkDeviceSize>(sizeof(vertices)));
+  if (!vertexBuffer->isValid())
+  {
+    valid = false;
+    return;
+  }
+
+  if (!uploader->upload(*vertexBuffer, 0u, vertices.data(), static_cast<VkDeviceSize>(sizeof(vertices))))
+  {
+    valid = false;
+    return;
+  }
 
-    // Clean up the staging buffer
-    delete stagingBuffer;
+  // Create an empty index buffer and upload the index data
+  indexBuffer =
+    new Buffer(vkDevice, memoryAllocator, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+               VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, static_cast<VkDeviceSize>(sizeof(indices)));
+  if (!indexBuffer->isValid())
+  {
+    valid = false;
+    return;
+  }
+
+  if (!uploader->upload(*indexBuffer, 0u, indices.data(), static_cast<VkDeviceSize>(sizeof(indices))))
+  {
+    valid = false;
+    return;
+  }
+
+  // Submit both uploads at once, frames are rendered without geometry until they are available
+  geometryUploadToken = uploader->submit();
+  if (geometryUploadToken == UPLOAD_TOKEN_FAILED)
+  {
+    valid = false;
+    return;
   }
 }
 
 Renderer::~Renderer()
 {
+  // Let the pipelines being compiled finish so that they make it into the pipeline cache
+  delete pipelineCompiler;
+  if (pipelineCache)
+  {
+    pipelineCache->save();
+  }
+
   delete indexBuffer;
   delete vertexBuffer;
-  delete cubePipeline;
-  delete gridPipeline;
+  delete uploader;
+  delete cullPipeline;
+  delete renderGraph;
+  delete pipelineRegistry;
+  delete pipelineCache;
+  delete shaderRegistry;
+  delete dynamicState;
 
   const VkDevice vkDevice = context->getVkDevice();
 
   vkDestroyPipelineLayout(vkDevice, pipelineLayout, nullptr);
   vkDestroyDescriptorSetLayout(vkDevice, descriptorSetLayout, nullptr);
-  vkDestroyDescriptorPool(vkDevice, descriptorPool, nullptr);
+  delete descriptorAllocator;
 
   for (const RenderProcess* renderProcess : renderProcesses)
   {
     delete renderProcess;
   }
 
+  delete dynamicDataBuffer;
+
+  vkDestroyQueryPool(vkDevice, timestampQueryPool, nullptr);
+  vkDestroySemaphore(vkDevice, frameSemaphore, nullptr);
+  delete commandRecorder;
   vkDestroyCommandPool(vkDevice, commandPool, nullptr);
 }
 
-void Renderer::render(size_t swapchainImageIndex)
+bool Renderer::render(size_t swapchainImageIndex)
 {
   currentRenderProcessIndex = (currentRenderProcessIndex + 1u) % renderProcesses.size();
+  currentSwapchainImageIndex = swapchainImageIndex;
 
   RenderProcess* renderProcess = renderProcesses.at(currentRenderProcessIndex);
 
-  const VkFence busyFence = renderProcess->getBusyFence();
-  if (vkResetFences(context->getVkDevice(), 1u, &busyFence) != VK_SUCCESS)
+  // Wait for the frame that last used this render process to finish on the GPU before reusing its resources
+  VkSemaphoreWaitInfo semaphoreWaitInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+  semaphoreWaitInfo.semaphoreCount = 1u;
+  semaphoreWaitInfo.pSemaphores = &frameSemaphore;
+  semaphoreWaitInfo.pValues = &renderProcess->frameValue;
+
+  const std::chrono::steady_clock::time_point waitBegin = std::chrono::steady_clock::now();
+  if (vkWaitSemaphores(context->getVkDevice(), &semaphoreWaitInfo, UINT64_MAX) != VK_SUCCESS)
   {
-    return;
+    return false;
+  }
+  frameWaitTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - waitBegin).count();
+
+  // The frame value has been reached, so the sets this frame in flight allocated last time are no longer in use
+  descriptorAllocator->resetFrame(currentRenderProcessIndex);
+
+  // Read how long the GPU took for the frame it just finished
+  const uint32_t firstTimestamp = static_cast<uint32_t>(currentRenderProcessIndex * 2u);
+  if (timestampQueryPool && renderProcess->frameValue > 0u)
+  {
+    std::array<uint64_t, 2u> timestamps;
+    if (vkGetQueryPoolResults(context->getVkDevice(), timestampQueryPool, firstTimestamp, 2u, sizeof(timestamps),
+                              timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS)
+    {
+      const uint64_t ticks = (timestamps.at(1u) - timestamps.at(0u)) & timestampMask; // Survives a wrap around
+      gpuTime = static_cast<float>(static_cast<double>(ticks) * timestampPeriod * 1e-9);
+    }
   }
 
   const VkCommandBuffer commandBuffer = renderProcess->getCommandBuffer();
 
   if (vkResetCommandBuffer(commandBuffer, 0u) != VK_SUCCESS)
   {
-    return;
+    return false;
   }
 
   VkCommandBufferBeginInfo commandBufferBeginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
   if (vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
   {
-    return;
+    return false;
   }
 
-  // Update the uniform buffer data
-  float handScaleAll1 = 0.1;
-  float handScaleAll2 = 0.01;
-  glm::vec3 handScale1 = glm::vec3(handScaleAll1 * (1.0 / 2.0), handScaleAll1 * (1.0 / 2.0), handScaleAll1 * (1.0 / 2.0));
-  glm::vec3 handScale2 = glm::vec3(handScaleAll2 * (1.0 / 2.0), handScaleAll2 * (1.0 / 2.0), handScaleAll2 * (1.0 / 2.0));
+  if (timestampQueryPool)
+  {
+    vkCmdResetQueryPool(commandBuffer, timestampQueryPool, firstTimestamp, 2u);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, firstTimestamp);
+  }
 
+  // Take ownership of completed uploads before anything reads from them
+  uploader->recordAcquireBarriers(commandBuffer);
 
-  for (int i = 0; i < 64; i++)
+  // Draw the tracked points from the latest input snapshot, which the input sampler may have published mid-frame
+  const InputSnapshot& input = headset->getLatestInput();
+
+  // Gather the objects grouped by batch, the grid and cube come first, then all tracked points as cubes
+  std::vector<RenderProcess::ObjectData>& objects = renderProcess->objectData;
+  objects.clear();
+  objects.push_back(makeObject(gridMesh, glm::mat4(1.0f), 0u));
+  objects.push_back(makeObject(cubeMesh, glm::mat4(1.0f), 1u));
+  for (size_t i = 0u; i < TRACKED_POINT_COUNT; i++)
   {
-    glm::mat4 trans1 = glm::translate(glm::mat4(1.0f), { 0.0f, -1.4f/2.0, 2.0f });
-    glm::mat4 scale1 = glm::scale(glm::mat4(1.0f), i < 2 ? handScale1 : handScale2);
-    glm::mat4 trans2_l = glm::translate(glm::mat4(1.0f), { headset->tracked_locations[i].pose.position.x, headset->tracked_locations[i].pose.position.y, headset->tracked_locations[i].pose.position.z });
-    glm::quat rot_l_q = glm::quat(headset->tracked_locations[i].pose.orientation.w, headset->tracked_locations[i].pose.orientation.x, headset->tracked_locations[i].pose.orientation.y, headset->tracked_locations[i].pose.orientation.z);
-    glm::mat4 rot_l = glm::toMat4(rot_l_q);
-    glm::mat4 realMat_l = trans2_l * rot_l * scale1 * trans1;
+    objects.push_back(makeObject(cubeMesh, makeTrackedPointTransform(input.trackedLocations[i].pose, i), 2u));
+  }
+
+  if (objects.size() > maxObjectCount)
+  {
+    objects.resize(maxObjectCount);
+  }
 
-    renderProcess->uniformBufferData.tracked_points[i] = realMat_l;
+  // Swap in pipelines that were compiled or linked in the background, the grid falls back to the cube pipeline until
+  // it has one
+  cubePipeline = pipelineRegistry->get(cubePipelineHandle);
+  const Pipeline* gridPipeline = pipelineRegistry->get(gridPipelineHandle);
+
+  // Split the objects into batches, each batch owns the draw commands starting at its first object
+  const DrawBatch groundBatch = gridPipeline ? DrawBatch{ gridPipeline, &gridRenderState, 0u, 0u } :
+                                               DrawBatch{ cubePipeline, &cubeRenderState, 0u, 0u };
+  drawBatches = { groundBatch, { cubePipeline, &cubeRenderState, 0u, 0u }, { cubePipeline, &cubeRenderState, 0u, 0u } };
+  for (uint32_t objectIndex = 0u; objectIndex < static_cast<uint32_t>(objects.size()); ++objectIndex)
+  {
+    RenderProcess::ObjectData& object = objects.at(objectIndex);
+    DrawBatch& drawBatch = drawBatches.at(object.batchIndex);
+    if (drawBatch.objectCount == 0u)
+    {
+      drawBatch.firstObject = objectIndex;
+    }
+    ++drawBatch.objectCount;
+    object.drawOffset = drawBatch.firstObject;
   }
 
+  // Update the uniform buffer data
   renderProcess->uniformBufferData.world = glm::translate(glm::mat4(1.0f), { 0.0f, 0.0f, 0.0f });
+  updateViewData(renderProcess);
+  renderProcess->uniformBufferData.objectCount = static_cast<uint32_t>(objects.size());
+
+  dynamicDataBuffer->beginRegion(currentRenderProcessIndex);
+  if (!renderProcess->updateUniformBufferData())
+  {
+    return false;
+  }
+
+  if (!dynamicDataBuffer->flush())
+  {
+    return false;
+  }
+
+  if (!renderProcess->updateObjectData())
+  {
+    return false;
+  }
+
+  const bool geometryAvailable = uploader->isAvailable(geometryUploadToken);
+  if (!staticCommandBuffers)
+  {
+    recordScene(commandBuffer, renderProcess, swapchainImageIndex, geometryAvailable);
+    return true;
+  }
+
+  // The frame's own command buffer only holds the upload barriers, the scene is drawn by a recording that is kept
+  // for as long as the draw list stays the same
+  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+  {
+    return false;
+  }
+
+  updateDrawListVersion(geometryAvailable);
+
+  RenderProcess::SceneRecording& sceneRecording = renderProcess->sceneRecordings.at(swapchainImageIndex);
+  if (sceneRecording.drawListVersion != drawListVersion ||
+      sceneRecording.uniformBufferOffset != renderProcess->getUniformBufferOffset())
+  {
+    if (vkBeginCommandBuffer(sceneRecording.commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
+    {
+      return false;
+    }
+
+    recordScene(sceneRecording.commandBuffer, renderProcess, swapchainImageIndex, geometryAvailable);
+
+    if (vkEndCommandBuffer(sceneRecording.commandBuffer) != VK_SUCCESS)
+    {
+      return false;
+    }
+
+    sceneRecording.drawListVersion = drawListVersion;
+    sceneRecording.uniformBufferOffset = renderProcess->getUniformBufferOffset();
+  }
+
+  // Begin the epilogue for commands that follow the scene, like the mirror view blit
+  if (vkBeginCommandBuffer(renderProcess->getEpilogueCommandBuffer(), &commandBufferBeginInfo) != VK_SUCCESS)
+  {
+    return false;
+  }
+
+  return true;
+}
+
+bool Renderer::latch()
+{
+  RenderProcess* renderProcess = renderProcesses.at(currentRenderProcessIndex);
+
+  // Refine the views and tracked points of the recorded frame with the latest poses
+  updateViewData(renderProcess);
+  const InputSnapshot& input = headset->getLatestInput();
+  std::vector<RenderProcess::ObjectData>& objects = renderProcess->objectData;
+  for (size_t i = 0u; i < TRACKED_POINT_COUNT && firstTrackedPointObject + i < objects.size(); i++)
+  {
+    objects.at(firstTrackedPointObject + i).transform = makeTrackedPointTransform(input.trackedLocations[i].pose, i);
+  }
+
+  // The recorded commands read both from the same offsets, so they only need to be written before the submission.
+  // Objects culled on the CPU were chosen with the views the frame was recorded with
+  renderProcess->latchUniformBufferData();
+  if (!dynamicDataBuffer->flush())
+  {
+    return false;
+  }
+
+  return renderProcess->updateObjectData();
+}
+
+float Renderer::measureRecordingTime(size_t drawCount, size_t threadCount, size_t repetitionCount)
+{
+  // Fill the first render process with a row of objects that all pass culling, the frame loop has not started yet,
+  // alternating meshes keep neighbours from being merged into one instanced draw
+  RenderProcess* renderProcess = renderProcesses.front();
+  std::vector<RenderProcess::ObjectData>& objects = renderProcess->objectData;
+  objects.clear();
+  for (size_t objectIndex = 0u; objectIndex < std::min(drawCount, maxObjectCount); ++objectIndex)
+  {
+    const glm::mat4 transform = glm::translate(glm::mat4(1.0f), { static_cast<float>(objectIndex), 0.0f, 0.0f });
+    objects.push_back(makeObject(objectIndex % 2u == 0u ? cubeMesh : gridMesh, transform, 0u));
+  }
+
+  drawBatches = { { cubePipeline, &cubeRenderState, 0u, static_cast<uint32_t>(objects.size()) } };
+
+  renderProcess->uniformBufferData.world = glm::mat4(1.0f);
+  for (glm::vec4& frustumPlane : renderProcess->uniformBufferData.frustumPlanes)
+  {
+    frustumPlane = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f); // Every sphere is in front of this plane
+  }
+  renderProcess->uniformBufferData.objectCount = static_cast<uint32_t>(objects.size());
+
+  // The command buffers are never submitted, without a framebuffer the render pass is all they need
+  const std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+  for (size_t repetitionIndex = 0u; repetitionIndex < repetitionCount; ++repetitionIndex)
+  {
+    if (!recordObjectDrawsInParallel(0u, VK_NULL_HANDLE, renderProcess, threadCount))
+    {
+      return 0.0f;
+    }
+  }
+
+  const float time = std::chrono::duration<float>(std::chrono::steady_clock::now() - begin).count();
+  return time / static_cast<float>(std::max(repetitionCount, static_cast<size_t>(1u)));
+}
+
+void Renderer::recordScene(VkCommandBuffer commandBuffer,
+                           const RenderProcess* renderProcess,
+                           size_t swapchainImageIndex,
+                           bool geometryAvailable)
+{
+  recordingContext = { renderProcess, swapchainImageIndex, geometryAvailable };
+
+  // Bind the resources of this recording, the render graph records the passes with the barriers between them
+  const RenderTarget* renderTarget = headset->getRenderTarget(swapchainImageIndex);
+  renderGraph->setImage(eyeImageResource, renderTarget->getImage(), renderTarget->getImageView());
+  if (headset->getRenderPass())
+  {
+    renderGraph->setImage(depthImageResource, headset->getDepthImage(), headset->getDepthImageView());
+  }
+
+  if (cullPipeline)
+  {
+    renderGraph->setBuffer(drawBufferResource, renderProcess->getDrawBuffer());
+    renderGraph->setBuffer(countBufferResource, renderProcess->getCountBuffer());
+  }
+
+  renderGraph->execute(commandBuffer);
+}
+
+void Renderer::recordScenePass(VkCommandBuffer commandBuffer)
+{
+  const RenderProcess* renderProcess = recordingContext.renderProcess;
+  const size_t swapchainImageIndex = recordingContext.swapchainImageIndex;
+
+  // Only clear until the geometry has been uploaded
+  if (!recordingContext.geometryAvailable)
+  {
+    beginRendering(commandBuffer, swapchainImageIndex, false);
+    endRendering(commandBuffer);
+    return;
+  }
+
+  if (cullPipeline)
+  {
+    beginRendering(commandBuffer, swapchainImageIndex, false);
+    recordDrawState(commandBuffer, renderProcess);
+
+    // Draw each batch with the commands that survived culling
+    const Pipeline* boundPipeline = nullptr;
+    StateTracker stateTracker(dynamicState);
+    for (size_t batchIndex = 0u; batchIndex < drawBatches.size(); ++batchIndex)
+    {
+      const DrawBatch& drawBatch = drawBatches.at(batchIndex);
+      if (drawBatch.objectCount == 0u)
+      {
+        continue;
+      }
+
+      if (drawBatch.pipeline != boundPipeline)
+      {
+        drawBatch.pipeline->bind(commandBuffer);
+        boundPipeline = drawBatch.pipeline;
+      }
+
+      stateTracker.apply(commandBuffer, *drawBatch.renderState);
+      vkCmdDrawIndexedIndirectCount(
+        commandBuffer, renderProcess->getDrawBuffer(),
+        static_cast<VkDeviceSize>(drawBatch.firstObject * sizeof(VkDrawIndexedIndirectCommand)),
+        renderProcess->getCountBuffer(), static_cast<VkDeviceSize>(batchIndex * sizeof(uint32_t)),
+        drawBatch.objectCount, static_cast<uint32_t>(sizeof(VkDrawIndexedIndirectCommand)));
+    }
+  }
+  else if (staticCommandBuffers)
+  {
+    // A kept recording cannot follow the view, so draw every object and leave culling to the GPU's clipper
+    beginRendering(commandBuffer, swapchainImageIndex, false);
+    recordDrawState(commandBuffer, renderProcess);
+    recordObjectDraws(commandBuffer, renderProcess, 0u, renderProcess->objectData.size(), false);
+  }
+  else
+  {
+    // Cull the objects on the CPU, split them across threads into secondary command buffers
+    beginRendering(commandBuffer, swapchainImageIndex, true);
+
+    const VkFramebuffer framebuffer = headset->getRenderTarget(swapchainImageIndex)->getFramebuffer();
+    if (recordObjectDrawsInParallel(currentRenderProcessIndex, framebuffer, renderProcess,
+                                    commandRecorder->getThreadCount()) &&
+        !secondaryCommandBuffers.empty())
+    {
+      vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(secondaryCommandBuffers.size()),
+                           secondaryCommandBuffers.data());
+    }
+  }
+
+  endRendering(commandBuffer);
+}
+
+void Renderer::updateViewData(RenderProcess* renderProcess) const
+{
   for (size_t eyeIndex = 0u; eyeIndex < headset->getEyeCount(); ++eyeIndex)
   {
     renderProcess->uniformBufferData.viewProjection[eyeIndex] =
       headset->getEyeProjectionMatrix(eyeIndex) * headset->getEyeViewMatrix(eyeIndex);
+    util::extractFrustumPlanes(renderProcess->uniformBufferData.viewProjection[eyeIndex],
+                               &renderProcess->uniformBufferData.frustumPlanes[eyeIndex * 6u]);
   }
+}
 
-  if (!renderProcess->updateUniformBufferData())
+void Renderer::beginRendering(VkCommandBuffer commandBuffer, size_t swapchainImageIndex, bool secondary) const
+{
+  const RenderTarget* renderTarget = headset->getRenderTarget(swapchainImageIndex);
+  const std::array clearValues = { VkClearValue({ 0.01f, 0.01f, 0.01f, 1.0f }), VkClearValue({ 1.0f, 0u }) };
+
+  if (headset->getRenderPass())
   {
+    VkRenderPassBeginInfo renderPassBeginInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+    renderPassBeginInfo.renderPass = headset->getRenderPass();
+    renderPassBeginInfo.framebuffer = renderTarget->getFramebuffer();
+    renderPassBeginInfo.renderArea.offset = { 0, 0 };
+    renderPassBeginInfo.renderArea.extent = headset->getEyeResolution(0u);
+    renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+    renderPassBeginInfo.pClearValues = clearValues.data();
+    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo,
+                         secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
     return;
   }
 
-  const std::array clearValues = { VkClearValue({ 0.01f, 0.01f, 0.01f, 1.0f }), VkClearValue({ 1.0f, 0u }) };
+  // Begin rendering into both eyes, the render graph has already transitioned the attachments
+  VkRenderingAttachmentInfoKHR colorAttachmentInfo{ VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR };
+  colorAttachmentInfo.imageView = renderTarget->getImageView();
+  colorAttachmentInfo.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+  colorAttachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  colorAttachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+  colorAttachmentInfo.clearValue = clearValues.at(0u);
+
+  VkRenderingAttachmentInfoKHR depthAttachmentInfo{ VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO_KHR };
+  depthAttachmentInfo.imageView = renderGraph->getImageView(depthImageResource);
+  depthAttachmentInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+  depthAttachmentInfo.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+  depthAttachmentInfo.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+  depthAttachmentInfo.clearValue = clearValues.at(1u);
+
+  VkRenderingInfoKHR renderingInfo{ VK_STRUCTURE_TYPE_RENDERING_INFO_KHR };
+  renderingInfo.flags = secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT_KHR : 0u;
+  renderingInfo.renderArea.offset = { 0, 0 };
+  renderingInfo.renderArea.extent = headset->getEyeResolution(0u);
+  renderingInfo.layerCount = 1u;
+  renderingInfo.viewMask = headset->getViewMask();
+  renderingInfo.colorAttachmentCount = 1u;
+  renderingInfo.pColorAttachments = &colorAttachmentInfo;
+  renderingInfo.pDepthAttachment = &depthAttachmentInfo;
+  context->vkCmdBeginRenderingKHR(commandBuffer, &renderingInfo);
+}
+
+void Renderer::endRendering(VkCommandBuffer commandBuffer) const
+{
+  if (headset->getRenderPass())
+  {
+    vkCmdEndRenderPass(commandBuffer);
+  }
+  else
+  {
+    context->vkCmdEndRenderingKHR(commandBuffer);
+  }
+}
+
+void Renderer::updateDrawListVersion(bool geometryAvailable)
+{
+  // Everything that is baked into a scene recording, the object data itself is read from buffers at draw time
+  const std::vector<RenderProcess::ObjectData>& objects = renderProcesses.at(currentRenderProcessIndex)->objectData;
+  drawList.clear();
+  drawList.push_back(geometryAvailable ? 1u : 0u);
+  drawList.push_back(pipelineRegistry->getGeneration());
+  for (const DrawBatch& drawBatch : drawBatches)
+  {
+    drawList.insert(drawList.end(), { drawBatch.firstObject, drawBatch.objectCount });
+  }
+
+  // Without GPU culling, each object's index range is part of its draw command
+  if (!cullPipeline)
+  {
+    for (const RenderProcess::ObjectData& object : objects)
+    {
+      drawList.insert(drawList.end(), { object.firstIndex, object.indexCount });
+    }
+  }
+
+  if (drawList != recordedDrawList)
+  {
+    recordedDrawList.swap(drawList);
+    ++drawListVersion;
+  }
+}
+
+void Renderer::recordCulling(VkCommandBuffer commandBuffer, const RenderProcess* renderProcess) const
+{
+  // Test each object against both eye frustums and compact the survivors into draw commands
+  const VkDescriptorSet descriptorSet = renderProcess->getDescriptorSet();
+  const uint32_t uniformBufferOffset = renderProcess->getUniformBufferOffset();
+  cullPipeline->bind(commandBuffer);
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0u, 1u, &descriptorSet, 1u,
+                          &uniformBufferOffset);
 
-  VkRenderPassBeginInfo renderPassBeginInfo{ VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
-  renderPassBeginInfo.renderPass = headset->getRenderPass();
-  renderPassBeginInfo.framebuffer = headset->getRenderTarget(swapchainImageIndex)->getFramebuffer();
-  renderPassBeginInfo.renderArea.offset = { 0, 0 };
-  renderPassBeginInfo.renderArea.extent = headset->getEyeResolution(0u);
-  renderPassBeginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-  renderPassBeginInfo.pClearValues = clearValues.data();
+  const uint32_t objectCount = renderProcess->uniformBufferData.objectCount;
+  vkCmdDispatch(commandBuffer, (objectCount + cullWorkgroupSize - 1u) / cullWorkgroupSize, 1u, 1u);
+}
 
-  vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+void Renderer::recordDrawState(VkCommandBuffer commandBuffer, const RenderProcess* renderProcess) const
+{
+  const VkExtent2D eyeResolution = headset->getEyeResolution(0u);
 
   // Set the viewport
   VkViewport viewport;
-  viewport.x = static_cast<float>(renderPassBeginInfo.renderArea.offset.x);
-  viewport.y = static_cast<float>(renderPassBeginInfo.renderArea.offset.y);
-  viewport.width = static_cast<float>(renderPassBeginInfo.renderArea.extent.width);
-  viewport.height = static_cast<float>(renderPassBeginInfo.renderArea.extent.height);
+  viewport.x = 0.0f;
+  viewport.y = 0.0f;
+  viewport.width = static_cast<float>(eyeResolution.width);
+  viewport.height = static_cast<float>(eyeResolution.height);
   viewport.minDepth = 0.0f;
   viewport.maxDepth = 1.0f;
   vkCmdSetViewport(commandBuffer, 0u, 1u, &viewport);
 
   // Set the scissor
   VkRect2D scissor;
-  scissor.offset = renderPassBeginInfo.renderArea.offset;
-  scissor.extent = renderPassBeginInfo.renderArea.extent;
+  scissor.offset = { 0, 0 };
+  scissor.extent = eyeResolution;
   vkCmdSetScissor(commandBuffer, 0u, 1u, &scissor);
 
   // Bind the vertex buffer
@@ -369,57 +998,172 @@ void Renderer::render(size_t swapchainImageIndex)
 
   // Bind the uniform buffer
   const VkDescriptorSet descriptorSet = renderProcess->getDescriptorSet();
-  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0u, 1u, &descriptorSet, 0u,
-                          nullptr);
+  const uint32_t uniformBufferOffset = renderProcess->getUniformBufferOffset();
+  vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0u, 1u, &descriptorSet, 1u,
+                          &uniformBufferOffset);
+}
 
-  // Draw the grid
-  gridPipeline->bind(commandBuffer);
-  vkCmdDrawIndexed(commandBuffer, 6u, 1u, 0u, 0u, 0u);
+bool Renderer::recordObjectDrawsInParallel(size_t frameIndex,
+                                           VkFramebuffer framebuffer,
+                                           const RenderProcess* renderProcess,
+                                           size_t threadCount)
+{
+  // Each secondary command buffer starts without any state, so every range binds its own
+  const CommandRecorder::RecordFunction recordFunction =
+    [this, renderProcess](VkCommandBuffer commandBuffer, size_t firstObject, size_t objectCount)
+  {
+    recordDrawState(commandBuffer, renderProcess);
+    recordObjectDraws(commandBuffer, renderProcess, firstObject, objectCount, true);
+  };
+
+  // Without a render pass the secondary command buffers inherit the attachment formats of dynamic rendering instead
+  const VkFormat colorFormat = headset->getColorFormat();
+  VkCommandBufferInheritanceRenderingInfoKHR inheritanceRenderingInfo{
+    VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO_KHR
+  };
+  inheritanceRenderingInfo.viewMask = headset->getViewMask();
+  inheritanceRenderingInfo.colorAttachmentCount = 1u;
+  inheritanceRenderingInfo.pColorAttachmentFormats = &colorFormat;
+  inheritanceRenderingInfo.depthAttachmentFormat = headset->getDepthFormat();
+  inheritanceRenderingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+  const VkRenderPass renderPass = headset->getRenderPass();
+  return commandRecorder->record(frameIndex, renderPass, framebuffer, renderPass ? nullptr : &inheritanceRenderingInfo,
+                                 renderProcess->objectData.size(), threadCount, recordFunction,
+                                 secondaryCommandBuffers);
+}
 
-  // Draw the cube
-  cubePipeline->bind(commandBuffer);
-  vkCmdDrawIndexed(commandBuffer, 36u, 1u, 6u, 0u, 0u);
+void Renderer::recordObjectDraws(VkCommandBuffer commandBuffer,
+                                 const RenderProcess* renderProcess,
+                                 size_t firstObject,
+                                 size_t objectCount,
+                                 bool cull) const
+{
+  // Optionally cull on the CPU, contiguous visible objects of the same batch and mesh are drawn as one instanced draw
+  // whose instance index selects the object, so all tracked points take a single draw when they are visible
+  const RenderProcess::UniformBufferData& uniformBufferData = renderProcess->uniformBufferData;
+  const DrawBatch* currentDrawBatch = nullptr;
+  const Pipeline* boundPipeline = nullptr;
+  StateTracker stateTracker(dynamicState);
+  const RenderProcess::ObjectData* runObject = nullptr; // First object of the run that is not drawn yet
+  uint32_t firstRunObject = 0u, runObjectCount = 0u;
+  for (size_t objectIndex = firstObject; objectIndex <= firstObject + objectCount; ++objectIndex)
+  {
+    // One past the last object only ends the run
+    const RenderProcess::ObjectData* object = nullptr;
+    if (objectIndex < firstObject + objectCount)
+    {
+      object = &renderProcess->objectData.at(objectIndex);
+
+      const glm::mat4 transform = uniformBufferData.world * object->transform;
+      const glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(object->boundingSphere), 1.0f));
+      const float scale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                                     glm::length(glm::vec3(transform[2])) });
+      const float radius = object->boundingSphere.w * scale;
+      if (cull && !util::isSphereInFrustum(&uniformBufferData.frustumPlanes[0], center, radius) &&
+          !util::isSphereInFrustum(&uniformBufferData.frustumPlanes[6], center, radius))
+      {
+        object = nullptr;
+      }
+    }
 
-  // Draw the lhand cube
-  for (int i = 0; i < 64; i++) {
-    trackedPipeline[i]->bind(commandBuffer);
-    vkCmdDrawIndexed(commandBuffer, 36u, 1u, 6u, 0u, 0u);
-  }
+    // Extend the run while the object continues it
+    if (object && runObject && object->batchIndex == runObject->batchIndex &&
+        object->firstIndex == runObject->firstIndex && object->indexCount == runObject->indexCount)
+    {
+      ++runObjectCount;
+      continue;
+    }
+
+    if (runObject)
+    {
+      // Objects are grouped by batch, so the pipeline and render state only change at batch boundaries
+      const DrawBatch& drawBatch = drawBatches.at(runObject->batchIndex);
+      if (&drawBatch != currentDrawBatch)
+      {
+        if (drawBatch.pipeline != boundPipeline)
+        {
+          drawBatch.pipeline->bind(commandBuffer);
+          boundPipeline = drawBatch.pipeline;
+        }
+
+        stateTracker.apply(commandBuffer, *drawBatch.renderState);
+        currentDrawBatch = &drawBatch;
+      }
+
+      vkCmdDrawIndexed(commandBuffer, runObject->indexCount, runObjectCount, runObject->firstIndex, 0u,
+                       firstRunObject);
+    }
 
-  vkCmdEndRenderPass(commandBuffer);
+    runObject = object;
+    firstRunObject = static_cast<uint32_t>(objectIndex);
+    runObjectCount = 1u;
+  }
 }
 
-void Renderer::submit(bool useSemaphores) const
+void Renderer::submit(bool useSemaphores)
 {
-  const RenderProcess* renderProcess = renderProcesses.at(currentRenderProcessIndex);
-  const VkCommandBuffer commandBuffer = renderProcess->getCommandBuffer();
-  if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+  RenderProcess* renderProcess = renderProcesses.at(currentRenderProcessIndex);
+  if (timestampQueryPool)
   {
-    return;
+    vkCmdWriteTimestamp(getCurrentCommandBuffer(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool,
+                        static_cast<uint32_t>(currentRenderProcessIndex * 2u + 1u));
   }
 
-  const VkPipelineStageFlags waitStages = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-  const VkSemaphore drawableSemaphore = renderProcess->getDrawableSemaphore();
-  const VkSemaphore presentableSemaphore = renderProcess->getPresentableSemaphore();
-  const VkFence busyFence = renderProcess->getBusyFence();
-
-  VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
-  submitInfo.pWaitDstStageMask = &waitStages;
-  submitInfo.commandBufferCount = 1u;
-  submitInfo.pCommandBuffers = &commandBuffer;
+  if (vkEndCommandBuffer(getCurrentCommandBuffer()) != VK_SUCCESS)
+  {
+    return;
+  }
 
-  if (useSemaphores)
+  // With static command buffers the scene recording runs between the frame's own command buffer and its epilogue
+  std::array<VkCommandBuffer, 3u> commandBuffers = { renderProcess->getCommandBuffer(), nullptr, nullptr };
+  uint32_t commandBufferCount = 1u;
+  if (staticCommandBuffers)
   {
-    submitInfo.waitSemaphoreCount = 1u;
-    submitInfo.pWaitSemaphores = &drawableSemaphore;
-    submitInfo.signalSemaphoreCount = 1u;
-    submitInfo.pSignalSemaphores = &presentableSemaphore;
+    commandBuffers.at(1u) = renderProcess->sceneRecordings.at(currentSwapchainImageIndex).commandBuffer;
+    commandBuffers.at(2u) = renderProcess->getEpilogueCommandBuffer();
+    commandBufferCount = 3u;
   }
 
-  if (vkQueueSubmit(context->getVkDrawQueue(), 1u, &submitInfo, busyFence) != VK_SUCCESS)
+  // Wait for the uploads acquired in this frame and for the mirror view to be drawable, the swapchain only works
+  // with binary semaphores which come last so that they can be left out
+  const std::array waitSemaphores = { uploader->getSemaphore(), renderProcess->getDrawableSemaphore() };
+  const std::array<VkPipelineStageFlags, 2u> waitStages = { VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                                            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+  const std::array<uint64_t, 2u> waitValues = { uploader->getAvailableToken(), 0u };
+
+  // Signal the next frame value and the mirror view being presentable
+  const uint64_t signalFrameValue = frameValue + 1u;
+  const std::array signalSemaphores = { frameSemaphore, renderProcess->getPresentableSemaphore() };
+  const std::array<uint64_t, 2u> signalValues = { signalFrameValue, 0u };
+
+  const uint32_t semaphoreCount = useSemaphores ? 2u : 1u;
+
+  VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+  timelineSemaphoreSubmitInfo.waitSemaphoreValueCount = semaphoreCount;
+  timelineSemaphoreSubmitInfo.pWaitSemaphoreValues = waitValues.data();
+  timelineSemaphoreSubmitInfo.signalSemaphoreValueCount = semaphoreCount;
+  timelineSemaphoreSubmitInfo.pSignalSemaphoreValues = signalValues.data();
+
+  VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+  submitInfo.pNext = &timelineSemaphoreSubmitInfo;
+  submitInfo.waitSemaphoreCount = semaphoreCount;
+  submitInfo.pWaitSemaphores = waitSemaphores.data();
+  submitInfo.pWaitDstStageMask = waitStages.data();
+  submitInfo.commandBufferCount = commandBufferCount;
+  submitInfo.pCommandBuffers = commandBuffers.data();
+  submitInfo.signalSemaphoreCount = semaphoreCount;
+  submitInfo.pSignalSemaphores = signalSemaphores.data();
+  if (vkQueueSubmit(context->getVkDrawQueue(), 1u, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
   {
     return;
   }
+
+  // The uploads acquired in this frame are now owned by the draw queue for all later frames
+  uploader->commitAcquireBarriers();
+
+  frameValue = signalFrameValue;
+  renderProcess->frameValue = signalFrameValue;
 }
 
 bool Renderer::isValid() const
@@ -427,9 +1171,55 @@ bool Renderer::isValid() const
   return valid;
 }
 
+size_t Renderer::getFramesInFlight() const
+{
+  return renderProcesses.size();
+}
+
+size_t Renderer::getRecordingThreadCount() const
+{
+  return commandRecorder->getThreadCount();
+}
+
+size_t Renderer::getPipelineHitCount() const
+{
+  return pipelineRegistry->getHitCount();
+}
+
+size_t Renderer::getPipelineMissCount() const
+{
+  return pipelineRegistry->getMissCount();
+}
+
+size_t Renderer::getDescriptorPoolCount() const
+{
+  return descriptorAllocator->getPoolCount();
+}
+
+size_t Renderer::getDescriptorSetHitCount() const
+{
+  return descriptorAllocator->getHitCount();
+}
+
+size_t Renderer::getDescriptorSetMissCount() const
+{
+  return descriptorAllocator->getMissCount();
+}
+
+float Renderer::getFrameWaitTime() const
+{
+  return frameWaitTime;
+}
+
+float Renderer::getGpuTime() const
+{
+  return gpuTime;
+}
+
 VkCommandBuffer Renderer::getCurrentCommandBuffer() const
 {
-  return renderProcesses.at(currentRenderProcessIndex)->getCommandBuffer();
+  const RenderProcess* renderProcess = renderProcesses.at(currentRenderProcessIndex);
+  return staticCommandBuffers ? renderProcess->getEpilogueCommandBuffer() : renderProcess->getCommandBuffer();
 }
 
 VkSemaphore Renderer::getCurrentDrawableSemaphore() const
@@ -2,41 +2,135 @@
 
 #include <vulkan/vulkan.h>
 
+#include <string>
 #include <vector>
 
 class Buffer;
+class CommandRecorder;
 class Context;
+class DescriptorAllocator;
+class DynamicState;
 class Headset;
 class Pipeline;
+class PipelineCache;
+class PipelineCompiler;
+class PipelineRegistry;
+class RenderGraph;
 class RenderProcess;
+class RingBuffer;
+class ShaderRegistry;
+class Uploader;
+struct RenderState;
 
 class Renderer final
 {
 public:
-  Renderer(const Context* context, const Headset* headset);
+  Renderer(const Context* context,
+           const Headset* headset,
+           size_t framesInFlight,
+           size_t recordingThreadCount,
+           bool staticCommandBuffers,
+           const std::string& shaderOverrideDirectory);
   ~Renderer();
 
-  void render(size_t swapchainImageIndex);
-  void submit(bool useSemaphores) const;
+  bool render(size_t swapchainImageIndex); // Nothing may be recorded into or submitted for a frame that failed
+  bool latch(); // Rewrites the views and tracked points of the rendered frame with the latest poses before submission
+  void submit(bool useSemaphores);
+
+  // Average CPU time in seconds to record the given number of draws with up to the given number of threads
+  float measureRecordingTime(size_t drawCount, size_t threadCount, size_t repetitionCount);
 
   bool isValid() const;
-  VkCommandBuffer getCurrentCommandBuffer() const;
+  size_t getFramesInFlight() const;
+  size_t getRecordingThreadCount() const;
+  size_t getPipelineHitCount() const;       // Since startup
+  size_t getPipelineMissCount() const;      // Since startup
+  size_t getDescriptorPoolCount() const;
+  size_t getDescriptorSetHitCount() const;  // Since startup
+  size_t getDescriptorSetMissCount() const; // Since startup
+  float getFrameWaitTime() const; // In seconds, spent by the CPU in the last frame waiting for a frame in flight
+  float getGpuTime() const;       // In seconds, of the last frame the GPU finished, zero without timestamp support
+  VkCommandBuffer getCurrentCommandBuffer() const; // Executes after the scene, open until the frame is submitted
   VkSemaphore getCurrentDrawableSemaphore() const;
   VkSemaphore getCurrentPresentableSemaphore() const;
 
 private:
   bool valid = true;
+  bool staticCommandBuffers = false; // Keep scene recordings until the draw list changes
 
   const Context* context = nullptr;
   const Headset* headset = nullptr;
 
   VkCommandPool commandPool = nullptr;
-  VkDescriptorPool descriptorPool = nullptr;
+  CommandRecorder* commandRecorder = nullptr;
+  std::vector<VkCommandBuffer> secondaryCommandBuffers;
+  VkSemaphore frameSemaphore = nullptr;     // Timeline
+  uint64_t frameValue = 0u;                 // Signaled by the last submitted frame
+  VkQueryPool timestampQueryPool = nullptr; // Two timestamps per frame in flight, null without timestamp support
+  float timestampPeriod = 0.0f;             // Nanoseconds per timestamp tick
+  uint64_t timestampMask = 0u;              // Of the bits the draw queue writes
+  DescriptorAllocator* descriptorAllocator = nullptr;
   VkDescriptorSetLayout descriptorSetLayout = nullptr;
+  RingBuffer* dynamicDataBuffer = nullptr;
   std::vector<RenderProcess*> renderProcesses;
   VkPipelineLayout pipelineLayout = nullptr;
-  Pipeline *gridPipeline = nullptr, *cubePipeline = nullptr;
-  Pipeline *trackedPipeline[64];
+  PipelineCache* pipelineCache = nullptr;
+  ShaderRegistry* shaderRegistry = nullptr;
+  DynamicState* dynamicState = nullptr;
+  PipelineCompiler* pipelineCompiler = nullptr;
+  PipelineRegistry* pipelineRegistry = nullptr;
+  size_t cubePipelineHandle = 0u;
+  size_t gridPipelineHandle = 0u;         // Created in the background, the cube pipeline is used until it is ready
+  const Pipeline* cubePipeline = nullptr; // Owned by the pipeline registry, updated every frame
+  Pipeline* cullPipeline = nullptr;       // Only created if indirect count draws are supported
+  RenderGraph* renderGraph = nullptr;
+  size_t eyeImageResource = 0u, depthImageResource = 0u, drawBufferResource = 0u, countBufferResource = 0u;
+  Uploader* uploader = nullptr;
   Buffer *vertexBuffer = nullptr, *indexBuffer = nullptr;
-  size_t currentRenderProcessIndex = 0u;
+  uint64_t geometryUploadToken = 0u;
+  size_t currentRenderProcessIndex = 0u, currentSwapchainImageIndex = 0u;
+  float frameWaitTime = 0.0f, gpuTime = 0.0f;
+
+  // A range of objects that is drawn with the same pipeline and render state
+  struct DrawBatch final
+  {
+    const Pipeline* pipeline;
+    const RenderState* renderState; // The dynamic parts are set on the command buffer
+    uint32_t firstObject, objectCount;
+  };
+  std::vector<DrawBatch> drawBatches;
+
+  // Everything the scene recordings depend on, the version changes whenever the draw list does
+  std::vector<uint32_t> drawList, recordedDrawList;
+  uint64_t drawListVersion = 0u;
+
+  // What the render graph passes record, only valid during a scene recording
+  struct RecordingContext final
+  {
+    const RenderProcess* renderProcess;
+    size_t swapchainImageIndex;
+    bool geometryAvailable;
+  };
+  RecordingContext recordingContext = {};
+
+  void recordScene(VkCommandBuffer commandBuffer,
+                   const RenderProcess* renderProcess,
+                   size_t swapchainImageIndex,
+                   bool geometryAvailable);
+  void recordScenePass(VkCommandBuffer commandBuffer);
+  void updateViewData(RenderProcess* renderProcess) const;
+  void beginRendering(VkCommandBuffer commandBuffer, size_t swapchainImageIndex, bool secondary) const;
+  void endRendering(VkCommandBuffer commandBuffer) const;
+  void updateDrawListVersion(bool geometryAvailable);
+  void recordCulling(VkCommandBuffer commandBuffer, const RenderProcess* renderProcess) const;
+  void recordDrawState(VkCommandBuffer commandBuffer, const RenderProcess* renderProcess) const;
+  void recordObjectDraws(VkCommandBuffer commandBuffer,
+                         const RenderProcess* renderProcess,
+                         size_t firstObject,
+                         size_t objectCount,
+                         bool cull) const;
+  bool recordObjectDrawsInParallel(size_t frameIndex,
+                                   VkFramebuffer framebuffer,
+                                   const RenderProcess* renderProcess,
+                                   size_t threadCount);
 };
\ No newline at end of file
@@ -0,0 +1,145 @@
+#include "RingBuffer.h"
+
+#include "Buffer.h"
+#include "Util.h"
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+constexpr size_t blockSize = 16u; // Granularity at which unchanged data is skipped
+} // namespace
+
+RingBuffer::RingBuffer(VkDevice device,
+                       VkPhysicalDevice physicalDevice,
+                       MemoryAllocator* memoryAllocator,
+                       VkBufferUsageFlags bufferUsageFlags,
+                       VkDeviceSize regionSize,
+                       size_t regionCount)
+{
+  // Dynamic offsets have to respect the minimum offset alignment of each descriptor type
+  VkPhysicalDeviceProperties physicalDeviceProperties;
+  vkGetPhysicalDeviceProperties(physicalDevice, &physicalDeviceProperties);
+  if (bufferUsageFlags & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+  {
+    alignment = std::max(alignment, physicalDeviceProperties.limits.minUniformBufferOffsetAlignment);
+  }
+
+  if (bufferUsageFlags & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+  {
+    alignment = std::max(alignment, physicalDeviceProperties.limits.minStorageBufferOffsetAlignment);
+  }
+
+  this->regionSize = (regionSize + alignment - 1u) / alignment * alignment;
+
+  // Create the buffer, it does not need to be coherent as written ranges are flushed explicitly
+  const VkDeviceSize size = this->regionSize * static_cast<VkDeviceSize>(regionCount);
+  buffer = new Buffer(device, memoryAllocator, bufferUsageFlags, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, size);
+  if (!buffer->isValid())
+  {
+    valid = false;
+    return;
+  }
+
+  // The buffer stays mapped for its whole lifetime
+  mappedData = static_cast<char*>(buffer->getMappedData());
+  if (!mappedData)
+  {
+    valid = false;
+    return;
+  }
+
+  // Clear the buffer and its shadow copy so that both start out identical
+  shadowData.resize(static_cast<size_t>(size), 0);
+  memset(mappedData, 0, static_cast<size_t>(size));
+  if (!buffer->flush(0u, size))
+  {
+    valid = false;
+    return;
+  }
+
+  regionEnd = this->regionSize;
+}
+
+RingBuffer::~RingBuffer()
+{
+  delete buffer;
+}
+
+void RingBuffer::beginRegion(size_t regionIndex)
+{
+  head = regionSize * static_cast<VkDeviceSize>(regionIndex);
+  regionEnd = head + regionSize;
+}
+
+bool RingBuffer::allocate(VkDeviceSize size, uint32_t& offset)
+{
+  if (head + size > regionEnd)
+  {
+    std::stringstream s;
+    s << size << " bytes in ring buffer region";
+    util::error(Error::OutOfMemory, s.str());
+    return false;
+  }
+
+  offset = static_cast<uint32_t>(head);
+  head = std::min(regionEnd, (head + size + alignment - 1u) / alignment * alignment);
+  return true;
+}
+
+void RingBuffer::write(uint32_t offset, const void* data, size_t size)
+{
+  const char* source = static_cast<const char*>(data);
+  for (size_t blockBegin = 0u; blockBegin < size; blockBegin += blockSize)
+  {
+    const size_t blockLength = std::min(blockSize, size - blockBegin);
+    char* shadow = shadowData.data() + offset + blockBegin;
+
+    // Skip blocks that already hold the same data
+    if (memcmp(shadow, source + blockBegin, blockLength) == 0)
+    {
+      continue;
+    }
+
+    memcpy(shadow, source + blockBegin, blockLength);
+    memcpy(mappedData + offset + blockBegin, source + blockBegin, blockLength);
+
+    // Grow the dirty range to include the block
+    const VkDeviceSize begin = static_cast<VkDeviceSize>(offset + blockBegin);
+    const VkDeviceSize end = begin + static_cast<VkDeviceSize>(blockLength);
+    if (dirtyBegin == dirtyEnd)
+    {
+      dirtyBegin = begin;
+      dirtyEnd = end;
+    }
+    else
+    {
+      dirtyBegin = std::min(dirtyBegin, begin);
+      dirtyEnd = std::max(dirtyEnd, end);
+    }
+  }
+}
+
+bool RingBuffer::flush()
+{
+  if (dirtyBegin == dirtyEnd)
+  {
+    return true;
+  }
+
+  const bool result = buffer->flush(dirtyBegin, dirtyEnd - dirtyBegin);
+  dirtyBegin = dirtyEnd = 0u;
+  return result;
+}
+
+bool RingBuffer::isValid() const
+{
+  return valid;
+}
+
+VkBuffer RingBuffer::getVkBuffer() const
+{
+  return buffer->getVkBuffer();
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+
+class Buffer;
+class MemoryAllocator;
+
+// Persistently mapped buffer with one region per frame in flight, sub-allocated and bound with dynamic offsets
+class RingBuffer final
+{
+public:
+  RingBuffer(VkDevice device,
+             VkPhysicalDevice physicalDevice,
+             MemoryAllocator* memoryAllocator,
+             VkBufferUsageFlags bufferUsageFlags,
+             VkDeviceSize regionSize,
+             size_t regionCount);
+  ~RingBuffer();
+
+  void beginRegion(size_t regionIndex);
+  bool allocate(VkDeviceSize size, uint32_t& offset);
+  void write(uint32_t offset, const void* data, size_t size);
+  bool flush();
+
+  bool isValid() const;
+  VkBuffer getVkBuffer() const;
+
+private:
+  bool valid = true;
+
+  Buffer* buffer = nullptr;
+  char* mappedData = nullptr;
+  std::vector<char> shadowData; // Reading back from mapped memory can be very slow
+  VkDeviceSize regionSize = 0u, alignment = 1u;
+  VkDeviceSize regionEnd = 0u, head = 0u;
+  VkDeviceSize dirtyBegin = 0u, dirtyEnd = 0u;
+};
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include "ShaderCompiler.h"
+
+#include "Util.h"
+
+#include <glslang/Include/glslang_c_interface.h>
+#include <glslang/Public/resource_limits_c.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+namespace
+{
+// Part of every cache key, change it whenever the compiler settings below change
+constexpr char compilerSettings[] = "glslang vulkan1.2 spirv1.5 450core";
+
+glslang_stage_t getGlslangStage(VkShaderStageFlagBits stage)
+{
+  switch (stage)
+  {
+  case VK_SHADER_STAGE_FRAGMENT_BIT:
+    return GLSLANG_STAGE_FRAGMENT;
+  case VK_SHADER_STAGE_COMPUTE_BIT:
+    return GLSLANG_STAGE_COMPUTE;
+  default:
+    return GLSLANG_STAGE_VERTEX;
+  }
+}
+
+// Inserts the defines after the version directive, a line directive keeps the line numbers in messages unchanged
+std::string applyDefines(const std::string& source, const std::vector<std::string>& defines)
+{
+  if (defines.empty())
+  {
+    return source;
+  }
+
+  size_t insertPosition = 0u;
+  const size_t versionPosition = source.find("#version");
+  if (versionPosition != std::string::npos)
+  {
+    const size_t lineEnd = source.find('\n', versionPosition);
+    insertPosition = (lineEnd == std::string::npos) ? source.size() : lineEnd + 1u;
+  }
+
+  std::string preamble;
+  for (const std::string& define : defines)
+  {
+    std::string directive = define;
+    std::replace(directive.begin(), directive.end(), '=', ' ');
+    preamble += "#define " + directive + "\n";
+  }
+
+  const size_t lineCount = std::count(source.begin(), source.begin() + insertPosition, '\n');
+  preamble += "#line " + std::to_string(lineCount + 1u) + "\n";
+
+  std::string result = source;
+  result.insert(insertPosition, preamble);
+  return result;
+}
+
+// Compiles a single job, returns false and fills in the log on error
+bool compileJob(ShaderCompiler::Job& job)
+{
+  const std::string source = applyDefines(job.source, job.defines);
+
+  glslang_input_t input = {};
+  input.language = GLSLANG_SOURCE_GLSL;
+  input.stage = getGlslangStage(job.stage);
+  input.client = GLSLANG_CLIENT_VULKAN;
+  input.client_version = GLSLANG_TARGET_VULKAN_1_2;
+  input.target_language = GLSLANG_TARGET_SPV;
+  input.target_language_version = GLSLANG_TARGET_SPV_1_5;
+  input.code = source.c_str();
+  input.default_version = 450;
+  input.default_profile = GLSLANG_CORE_PROFILE;
+  input.force_default_version_and_profile = false;
+  input.forward_compatible = false;
+  input.messages = static_cast<glslang_messages_t>(GLSLANG_MSG_SPV_RULES_BIT | GLSLANG_MSG_VULKAN_RULES_BIT);
+  input.resource = glslang_default_resource();
+
+  glslang_shader_t* shader = glslang_shader_create(&input);
+  if (!glslang_shader_preprocess(shader, &input) || !glslang_shader_parse(shader, &input))
+  {
+    job.log = glslang_shader_get_info_log(shader);
+    glslang_shader_delete(shader);
+    return false;
+  }
+
+  glslang_program_t* program = glslang_program_create();
+  glslang_program_add_shader(program, shader);
+  if (!glslang_program_link(program, input.messages))
+  {
+    job.log = glslang_program_get_info_log(program);
+    glslang_program_delete(program);
+    glslang_shader_delete(shader);
+    return false;
+  }
+
+  glslang_program_SPIRV_generate(program, input.stage);
+  job.code.resize(glslang_program_SPIRV_get_size(program));
+  glslang_program_SPIRV_get(program, job.code.data());
+
+  glslang_program_delete(program);
+  glslang_shader_delete(shader);
+  return !job.code.empty();
+}
+} // namespace
+
+ShaderCompiler::ShaderCompiler(const std::string& cacheDirectory, size_t threadCount)
+: cacheDirectory(cacheDirectory), threadCount(std::max(threadCount, static_cast<size_t>(1u)))
+{
+  glslang_initialize_process();
+}
+
+ShaderCompiler::~ShaderCompiler()
+{
+  glslang_finalize_process();
+}
+
+bool ShaderCompiler::compile(std::vector<Job>& jobs) const
+{
+  // Take what is already in the cache
+  std::vector<Job*> missedJobs;
+  std::vector<std::string> cacheFilenames(jobs.size());
+  for (size_t jobIndex = 0u; jobIndex < jobs.size(); ++jobIndex)
+  {
+    Job& job = jobs.at(jobIndex);
+    job.log.clear();
+    cacheFilenames.at(jobIndex) = getCacheFilename(job);
+    job.cacheHit = loadFromCache(cacheFilenames.at(jobIndex), job.code);
+    if (!job.cacheHit)
+    {
+      missedJobs.push_back(&job);
+    }
+  }
+
+  if (missedJobs.empty())
+  {
+    return true;
+  }
+
+  // Compile the rest on as many threads as there are jobs, up to the thread count
+  std::atomic<size_t> nextJobIndex = 0u;
+  std::atomic<bool> success = true;
+  const auto work = [&]()
+  {
+    size_t jobIndex;
+    while ((jobIndex = nextJobIndex.fetch_add(1u)) < missedJobs.size())
+    {
+      Job& job = *missedJobs.at(jobIndex);
+      if (compileJob(job))
+      {
+        saveToCache(cacheFilenames.at(static_cast<size_t>(&job - jobs.data())), job.code);
+      }
+      else
+      {
+        job.code.clear();
+        success = false;
+      }
+    }
+  };
+
+  std::vector<std::thread> workerThreads;
+  for (size_t threadIndex = 1u; threadIndex < std::min(threadCount, missedJobs.size()); ++threadIndex)
+  {
+    workerThreads.emplace_back(work);
+  }
+
+  work(); // The calling thread helps out
+  for (std::thread& workerThread : workerThreads)
+  {
+    workerThread.join();
+  }
+
+  return success;
+}
+
+std::string ShaderCompiler::getCacheFilename(const Job& job) const
+{
+  // Hash everything that affects the resulting SPIR-V
+  uint64_t hash = util::hashData(compilerSettings, sizeof(compilerSettings));
+  hash = util::hashData(reinterpret_cast<const char*>(&job.stage), sizeof(job.stage), hash);
+  for (const std::string& define : job.defines)
+  {
+    hash = util::hashData(define.c_str(), define.size() + 1u, hash); // Including the terminator as a separator
+  }
+  hash = util::hashData(job.source.data(), job.source.size(), hash);
+
+  char name[17];
+  snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(hash));
+  return cacheDirectory + "/" + name + ".spv";
+}
+
+bool ShaderCompiler::loadFromCache(const std::string& filename, std::vector<uint32_t>& code) const
+{
+  std::ifstream file(filename, std::ios::ate | std::ios::binary);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  const size_t fileSize = static_cast<size_t>(file.tellg());
+  if (fileSize == 0u || fileSize % sizeof(uint32_t) != 0u)
+  {
+    return false;
+  }
+
+  code.resize(fileSize / sizeof(uint32_t));
+  file.seekg(0);
+  file.read(reinterpret_cast<char*>(code.data()), static_cast<std::streamsize>(fileSize));
+  return static_cast<bool>(file);
+}
+
+void ShaderCompiler::saveToCache(const std::string& filename, const std::vector<uint32_t>& code) const
+{
+  std::error_code errorCode;
+  std::filesystem::create_directories(cacheDirectory, errorCode);
+
+  // Write to a temporary file first so that an interrupted save never leaves a partial entry behind, failing to save
+  // only means compiling again next time
+  const std::string temporaryFilename = filename + ".tmp";
+  std::ofstream file(temporaryFilename, std::ios::binary | std::ios::trunc);
+  if (!file.is_open())
+  {
+    return;
+  }
+
+  file.write(reinterpret_cast<const char*>(code.data()), static_cast<std::streamsize>(code.size() * sizeof(uint32_t)));
+  file.close();
+  if (!file)
+  {
+    std::filesystem::remove(temporaryFilename, errorCode);
+    return;
+  }
+
+  std::filesystem::rename(temporaryFilename, filename, errorCode);
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+// Compiles GLSL to SPIR-V in process with glslang, results are stored in an on-disk cache addressed by a hash of the
+// source, defines and target environment so that a shader is only ever compiled once
+class ShaderCompiler final
+{
+public:
+  ShaderCompiler(const std::string& cacheDirectory, size_t threadCount);
+  ~ShaderCompiler();
+
+  struct Job final
+  {
+    std::string name; // Only used in messages
+    VkShaderStageFlagBits stage = VK_SHADER_STAGE_VERTEX_BIT;
+    std::string source;
+    std::vector<std::string> defines; // Either "NAME" or "NAME=VALUE"
+
+    // Results
+    std::vector<uint32_t> code;
+    std::string log; // Compiler messages if the compilation failed
+    bool cacheHit = false;
+  };
+
+  // Fills in the results of all jobs, cache misses are compiled in parallel, returns false if any job failed
+  bool compile(std::vector<Job>& jobs) const;
+
+private:
+  std::string cacheDirectory;
+  size_t threadCount = 1u;
+
+  std::string getCacheFilename(const Job& job) const;
+  bool loadFromCache(const std::string& filename, std::vector<uint32_t>& code) const;
+  void saveToCache(const std::string& filename, const std::vector<uint32_t>& code) const;
+};
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include "ShaderRegistry.h"
+
+#include "Util.h"
+
+#ifdef HAS_SHADER_COMPILER
+#include "ShaderCompiler.h"
+#endif
+
+#include <vulkan/vk_enum_string_helper.h>
+
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+// SPIR-V compiled by the build, see CMakeLists.txt, stored as words so that it is always correctly aligned
+constexpr uint32_t basicVertexCode[] = {
+#include "Basic.vert.inc"
+};
+
+constexpr uint32_t basicFragmentCode[] = {
+#include "Basic.frag.inc"
+};
+
+constexpr uint32_t cullComputeCode[] = {
+#include "Cull.comp.inc"
+};
+
+struct EmbeddedShader final
+{
+  const char* filename; // The GLSL source looked up in the override directory
+  VkShaderStageFlagBits stage;
+  const uint32_t* code;
+  size_t codeSize; // In bytes
+};
+
+// In the order of the shader enum
+constexpr std::array embeddedShaders = {
+  EmbeddedShader{ "Basic.vert", VK_SHADER_STAGE_VERTEX_BIT, basicVertexCode, sizeof(basicVertexCode) },
+  EmbeddedShader{ "Basic.frag", VK_SHADER_STAGE_FRAGMENT_BIT, basicFragmentCode, sizeof(basicFragmentCode) },
+  EmbeddedShader{ "Cull.comp", VK_SHADER_STAGE_COMPUTE_BIT, cullComputeCode, sizeof(cullComputeCode) }
+};
+
+#ifdef HAS_SHADER_COMPILER
+constexpr char shaderCacheDirectory[] = "shaders.cache"; // SPIR-V of compiled override sources
+
+// Reads a GLSL source file, returns false if it is missing
+bool loadSource(const std::string& filename, std::string& source)
+{
+  std::ifstream file(filename, std::ios::binary);
+  if (!file.is_open())
+  {
+    return false;
+  }
+
+  std::stringstream stream;
+  stream << file.rdbuf();
+  source = stream.str();
+  return static_cast<bool>(file);
+}
+#endif
+
+// Returns the SPIR-V for each shader that has a source in the override directory, empty for the others
+std::vector<std::vector<uint32_t>> compileOverrides(const std::string& overrideDirectory)
+{
+  std::vector<std::vector<uint32_t>> overrideCodes(embeddedShaders.size());
+  if (overrideDirectory.empty())
+  {
+    return overrideCodes;
+  }
+
+#ifdef HAS_SHADER_COMPILER
+  // Compile the sources found in the override directory, unchanged sources come straight from the shader cache
+  std::vector<ShaderCompiler::Job> jobs;
+  std::vector<size_t> jobShaderIndices;
+  for (size_t shaderIndex = 0u; shaderIndex < embeddedShaders.size(); ++shaderIndex)
+  {
+    const EmbeddedShader& embeddedShader = embeddedShaders.at(shaderIndex);
+
+    ShaderCompiler::Job job;
+    job.name = overrideDirectory + "/" + embeddedShader.filename;
+    job.stage = embeddedShader.stage;
+    if (loadSource(job.name, job.source))
+    {
+      jobs.push_back(job);
+      jobShaderIndices.push_back(shaderIndex);
+    }
+  }
+
+  if (jobs.empty())
+  {
+    return overrideCodes;
+  }
+
+  const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+  const ShaderCompiler shaderCompiler(shaderCacheDirectory, std::thread::hardware_concurrency());
+  shaderCompiler.compile(jobs);
+  const std::chrono::duration<double, std::milli> duration = std::chrono::steady_clock::now() - startTime;
+
+  size_t compiledCount = 0u;
+  for (size_t jobIndex = 0u; jobIndex < jobs.size(); ++jobIndex)
+  {
+    const ShaderCompiler::Job& job = jobs.at(jobIndex);
+    if (job.code.empty())
+    {
+      // Keep running with the embedded shader
+      util::error(Error::ShaderCompilationFailed, job.name + "\n" + job.log);
+    }
+    else
+    {
+      std::cout << "Shader override: \"" << job.name << "\"" << (job.cacheHit ? " (cached)" : "") << "\n";
+      overrideCodes.at(jobShaderIndices.at(jobIndex)) = job.code;
+    }
+
+    if (!job.cacheHit)
+    {
+      ++compiledCount;
+    }
+  }
+
+  std::cout << "Shader cache: " << jobs.size() - compiledCount << " of " << jobs.size() << " shaders cached, "
+            << compiledCount << " compiled in " << duration.count() << " ms\n";
+#else
+  // Keep running with the embedded shaders
+  util::error(Error::FeatureNotSupported, "Shader overrides, built without glslang");
+#endif
+
+  return overrideCodes;
+}
+} // namespace
+
+ShaderRegistry::ShaderRegistry(VkDevice device, const std::string& overrideDirectory) : device(device)
+{
+  const std::vector<std::vector<uint32_t>> overrideCodes = compileOverrides(overrideDirectory);
+
+  // Create a shader module for each shader, preferring compiled override code if there is any
+  shaderModules.resize(embeddedShaders.size());
+  for (size_t shaderIndex = 0u; shaderIndex < embeddedShaders.size(); ++shaderIndex)
+  {
+    const EmbeddedShader& embeddedShader = embeddedShaders.at(shaderIndex);
+
+    VkShaderModuleCreateInfo shaderModuleCreateInfo{ VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+    shaderModuleCreateInfo.codeSize = embeddedShader.codeSize;
+    shaderModuleCreateInfo.pCode = embeddedShader.code;
+
+    const std::vector<uint32_t>& overrideCode = overrideCodes.at(shaderIndex);
+    if (!overrideCode.empty())
+    {
+      shaderModuleCreateInfo.codeSize = overrideCode.size() * sizeof(uint32_t);
+      shaderModuleCreateInfo.pCode = overrideCode.data();
+    }
+
+    VkResult result;
+    if ((result = vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shaderModules.at(shaderIndex))) !=
+        VK_SUCCESS)
+    {
+      util::error(Error::GenericVulkan, string_VkResult(result));
+      valid = false;
+      return;
+    }
+  }
+}
+
+ShaderRegistry::~ShaderRegistry()
+{
+  for (const VkShaderModule shaderModule : shaderModules)
+  {
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+  }
+}
+
+bool ShaderRegistry::isValid() const
+{
+  return valid;
+}
+
+VkShaderModule ShaderRegistry::getShaderModule(Shader shader) const
+{
+  return shaderModules.at(static_cast<size_t>(shader));
+}
\ No newline at end of file
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+
+// Creates a shader module for each shader embedded into the executable exactly once, shaders can be overridden with
+// GLSL sources from a directory during development that are compiled at startup
+class ShaderRegistry final
+{
+public:
+  ShaderRegistry(VkDevice device, const std::string& overrideDirectory);
+  ~ShaderRegistry();
+
+  enum class Shader
+  {
+    BasicVertex,
+    BasicFragment,
+    CullCompute
+  };
+
+  bool isValid() const;
+  VkShaderModule getShaderModule(Shader shader) const;
+
+private:
+  bool valid = true;
+
+  VkDevice device = nullptr;
+  std::vector<VkShaderModule> shaderModules; // Indexed by shader
+};
\ No newline at end of file
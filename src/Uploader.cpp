@@ -0,0 +1,366 @@
+#include "Uploader.h"
+
+#include "Buffer.h"
+#include "Context.h"
+#include "Util.h"
+
+#include <vulkan/vk_enum_string_helper.h>
+
+#include <cstring>
+#include <sstream>
+
+namespace
+{
+constexpr VkDeviceSize stagingBufferSize = 8u * 1024u * 1024u; // Largest amount of data in flight at once
+constexpr VkDeviceSize stagingAlignment = 16u;                  // Keeps copies on their optimal alignment
+} // namespace
+
+Uploader::Uploader(const Context* context) : context(context)
+{
+  const VkDevice device = context->getVkDevice();
+  VkResult result = VK_SUCCESS;
+
+  // Create a command pool on the transfer queue family
+  VkCommandPoolCreateInfo commandPoolCreateInfo{ VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+  commandPoolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+  commandPoolCreateInfo.queueFamilyIndex = context->getVkTransferQueueFamilyIndex();
+  if ((result = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool)) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan, string_VkResult(result));
+    valid = false;
+    return;
+  }
+
+  // Create a timeline semaphore, each submit signals the next value which doubles as its completion token
+  VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+  semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+  semaphoreTypeCreateInfo.initialValue = 0u;
+
+  VkSemaphoreCreateInfo semaphoreCreateInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+  semaphoreCreateInfo.pNext = &semaphoreTypeCreateInfo;
+  if ((result = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore)) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan, string_VkResult(result));
+    valid = false;
+    return;
+  }
+
+  // Create a staging buffer that stays mapped
+  stagingBuffer =
+    new Buffer(device, context->getMemoryAllocator(), VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBufferSize);
+  if (!stagingBuffer->isValid())
+  {
+    valid = false;
+    return;
+  }
+
+  stagingData = static_cast<char*>(stagingBuffer->getMappedData());
+  if (!stagingData)
+  {
+    valid = false;
+    return;
+  }
+}
+
+Uploader::~Uploader()
+{
+  const VkDevice device = context->getVkDevice();
+
+  // Let the copies in flight complete before their command buffers and staging memory go away
+  if (semaphore)
+  {
+    wait(submittedToken);
+  }
+
+  std::vector<Batch*> batches = submittedBatches;
+  batches.insert(batches.end(), freeBatches.begin(), freeBatches.end());
+  if (recordingBatch)
+  {
+    batches.push_back(recordingBatch);
+  }
+
+  for (const Batch* batch : batches)
+  {
+    delete batch;
+  }
+
+  delete stagingBuffer;
+  vkDestroySemaphore(device, semaphore, nullptr);
+  vkDestroyCommandPool(device, commandPool, nullptr);
+}
+
+bool Uploader::upload(const Buffer& target, VkDeviceSize targetOffset, const void* data, VkDeviceSize size)
+{
+  if (size > stagingBufferSize)
+  {
+    std::stringstream s;
+    s << size << " bytes in upload staging buffer";
+    util::error(Error::OutOfMemory, s.str());
+    return false;
+  }
+
+  // Skip to the start of the staging buffer if the data would wrap around its end
+  VkDeviceSize begin = (stagingHead + stagingAlignment - 1u) / stagingAlignment * stagingAlignment;
+  if (begin % stagingBufferSize + size > stagingBufferSize)
+  {
+    begin += stagingBufferSize - begin % stagingBufferSize;
+  }
+
+  // Make room by submitting the pending copies and waiting for the oldest batches to complete
+  while (begin + size - stagingTail > stagingBufferSize)
+  {
+    if (recordingBatch && submit() == UPLOAD_TOKEN_FAILED)
+    {
+      return false;
+    }
+
+    // Without batches in flight the whole staging buffer is free
+    if (submittedBatches.empty())
+    {
+      stagingTail = begin;
+      break;
+    }
+
+    if (!retireBatches(true))
+    {
+      return false;
+    }
+  }
+
+  Batch* batch = recordingBatch ? recordingBatch : beginBatch();
+  if (!batch)
+  {
+    return false;
+  }
+
+  // Stage the data and record the copy
+  const VkDeviceSize stagingOffset = begin % stagingBufferSize;
+  memcpy(stagingData + stagingOffset, data, static_cast<size_t>(size));
+
+  VkBufferCopy copyRegion;
+  copyRegion.srcOffset = stagingOffset;
+  copyRegion.dstOffset = targetOffset;
+  copyRegion.size = size;
+  vkCmdCopyBuffer(batch->commandBuffer, stagingBuffer->getVkBuffer(), target.getVkBuffer(), 1u, &copyRegion);
+
+  // Remember the target range for the queue ownership transfer
+  VkBufferMemoryBarrier bufferMemoryBarrier{ VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER };
+  bufferMemoryBarrier.srcQueueFamilyIndex = context->getVkTransferQueueFamilyIndex();
+  bufferMemoryBarrier.dstQueueFamilyIndex = context->getVkDrawQueueFamilyIndex();
+  bufferMemoryBarrier.buffer = target.getVkBuffer();
+  bufferMemoryBarrier.offset = targetOffset;
+  bufferMemoryBarrier.size = size;
+  if (bufferMemoryBarrier.srcQueueFamilyIndex == bufferMemoryBarrier.dstQueueFamilyIndex)
+  {
+    bufferMemoryBarrier.srcQueueFamilyIndex = bufferMemoryBarrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+  }
+  batch->bufferMemoryBarriers.push_back(bufferMemoryBarrier);
+
+  stagingHead = begin + size;
+  batch->stagingEnd = stagingHead;
+  return true;
+}
+
+uint64_t Uploader::submit()
+{
+  // Nothing new to submit, everything uploaded so far is covered by the last token, if there was any
+  if (!recordingBatch)
+  {
+    return submittedToken;
+  }
+
+  Batch* batch = recordingBatch;
+  recordingBatch = nullptr;
+
+  // Release the target ranges from the transfer queue family
+  if (context->getVkTransferQueueFamilyIndex() != context->getVkDrawQueueFamilyIndex())
+  {
+    std::vector<VkBufferMemoryBarrier> releaseBarriers = batch->bufferMemoryBarriers;
+    for (VkBufferMemoryBarrier& releaseBarrier : releaseBarriers)
+    {
+      releaseBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+      releaseBarrier.dstAccessMask = 0u;
+    }
+
+    vkCmdPipelineBarrier(batch->commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                         0u, 0u, nullptr, static_cast<uint32_t>(releaseBarriers.size()), releaseBarriers.data(), 0u,
+                         nullptr);
+  }
+
+  if (vkEndCommandBuffer(batch->commandBuffer) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    freeBatches.push_back(batch);
+    return UPLOAD_TOKEN_FAILED;
+  }
+
+  // Signal the next value of the timeline semaphore once the copies are complete
+  const uint64_t token = nextToken;
+
+  VkTimelineSemaphoreSubmitInfo timelineSemaphoreSubmitInfo{ VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+  timelineSemaphoreSubmitInfo.signalSemaphoreValueCount = 1u;
+  timelineSemaphoreSubmitInfo.pSignalSemaphoreValues = &token;
+
+  VkSubmitInfo submitInfo{ VK_STRUCTURE_TYPE_SUBMIT_INFO };
+  submitInfo.pNext = &timelineSemaphoreSubmitInfo;
+  submitInfo.commandBufferCount = 1u;
+  submitInfo.pCommandBuffers = &batch->commandBuffer;
+  submitInfo.signalSemaphoreCount = 1u;
+  submitInfo.pSignalSemaphores = &semaphore;
+  if (vkQueueSubmit(context->getVkTransferQueue(), 1u, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    freeBatches.push_back(batch);
+    return UPLOAD_TOKEN_FAILED;
+  }
+
+  // The draw queue can acquire the target ranges right away as long as it waits for the token first
+  acquireBarriers.insert(acquireBarriers.end(), batch->bufferMemoryBarriers.begin(),
+                         batch->bufferMemoryBarriers.end());
+  submittedToken = token;
+
+  batch->token = token;
+  ++nextToken;
+  submittedBatches.push_back(batch);
+  return token;
+}
+
+void Uploader::recordAcquireBarriers(VkCommandBuffer commandBuffer)
+{
+  // Free up the staging space of completed batches
+  retireBatches(false);
+
+  if (!acquireBarriers.empty())
+  {
+    // Acquire the target ranges on the draw queue family and make the copies visible to all later reads
+    const bool ownershipTransfer = context->getVkTransferQueueFamilyIndex() != context->getVkDrawQueueFamilyIndex();
+    for (VkBufferMemoryBarrier& acquireBarrier : acquireBarriers)
+    {
+      acquireBarrier.srcAccessMask = ownershipTransfer ? 0u : VK_ACCESS_TRANSFER_WRITE_BIT;
+      acquireBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    }
+
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0u, 0u,
+                         nullptr, static_cast<uint32_t>(acquireBarriers.size()), acquireBarriers.data(), 0u, nullptr);
+  }
+
+  // Keep the barriers until the frame is submitted, a frame that fails after this point records them again
+  recordedAcquireBarrierCount = acquireBarriers.size();
+  availableToken = submittedToken;
+}
+
+void Uploader::commitAcquireBarriers()
+{
+  acquireBarriers.erase(acquireBarriers.begin(), acquireBarriers.begin() + recordedAcquireBarrierCount);
+  recordedAcquireBarrierCount = 0u;
+}
+
+bool Uploader::wait(uint64_t token)
+{
+  VkSemaphoreWaitInfo semaphoreWaitInfo{ VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+  semaphoreWaitInfo.semaphoreCount = 1u;
+  semaphoreWaitInfo.pSemaphores = &semaphore;
+  semaphoreWaitInfo.pValues = &token;
+  if (vkWaitSemaphores(context->getVkDevice(), &semaphoreWaitInfo, UINT64_MAX) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return false;
+  }
+
+  return retireBatches(false);
+}
+
+bool Uploader::isValid() const
+{
+  return valid;
+}
+
+bool Uploader::isAvailable(uint64_t token) const
+{
+  return token <= availableToken;
+}
+
+VkSemaphore Uploader::getSemaphore() const
+{
+  return semaphore;
+}
+
+uint64_t Uploader::getAvailableToken() const
+{
+  return availableToken;
+}
+
+Uploader::Batch* Uploader::beginBatch()
+{
+  const VkDevice device = context->getVkDevice();
+
+  Batch* batch = nullptr;
+  if (!freeBatches.empty())
+  {
+    batch = freeBatches.back();
+    freeBatches.pop_back();
+  }
+  else
+  {
+    batch = new Batch();
+
+    // Allocate a command buffer
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    commandBufferAllocateInfo.commandPool = commandPool;
+    commandBufferAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    commandBufferAllocateInfo.commandBufferCount = 1u;
+    if (vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &batch->commandBuffer) != VK_SUCCESS)
+    {
+      util::error(Error::GenericVulkan);
+      delete batch;
+      return nullptr;
+    }
+  }
+
+  VkCommandBufferBeginInfo commandBufferBeginInfo{ VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+  commandBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+  if (vkBeginCommandBuffer(batch->commandBuffer, &commandBufferBeginInfo) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    freeBatches.push_back(batch);
+    return nullptr;
+  }
+
+  batch->bufferMemoryBarriers.clear();
+  recordingBatch = batch;
+  return batch;
+}
+
+bool Uploader::retireBatches(bool waitForOldest)
+{
+  if (waitForOldest && !submittedBatches.empty() && !wait(submittedBatches.front()->token))
+  {
+    return false;
+  }
+
+  uint64_t completedToken = 0u;
+  if (vkGetSemaphoreCounterValue(context->getVkDevice(), semaphore, &completedToken) != VK_SUCCESS)
+  {
+    util::error(Error::GenericVulkan);
+    return false;
+  }
+
+  // Batches complete in submission order on the transfer queue
+  size_t retiredBatchCount = 0u;
+  for (Batch* batch : submittedBatches)
+  {
+    if (batch->token > completedToken)
+    {
+      break;
+    }
+
+    stagingTail = batch->stagingEnd;
+    vkResetCommandBuffer(batch->commandBuffer, 0u);
+    freeBatches.push_back(batch);
+    ++retiredBatchCount;
+  }
+
+  submittedBatches.erase(submittedBatches.begin(), submittedBatches.begin() + retiredBatchCount);
+  return true;
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <vector>
+
+#define UPLOAD_TOKEN_NONE (0u)           // Nothing to wait for, always available
+#define UPLOAD_TOKEN_FAILED (UINT64_MAX) // Returned by a submit that failed, never becomes available
+
+class Buffer;
+class Context;
+
+// Streams data into device local buffers through a staging ring on the transfer queue without blocking the GPU
+class Uploader final
+{
+public:
+  Uploader(const Context* context);
+  ~Uploader();
+
+  bool upload(const Buffer& target, VkDeviceSize targetOffset, const void* data, VkDeviceSize size);
+  uint64_t submit();                                         // Returns the last token if nothing new was uploaded
+  void recordAcquireBarriers(VkCommandBuffer commandBuffer); // Recorded again by every frame until they are committed
+  void commitAcquireBarriers();                              // Once the frame they were recorded into is submitted
+  bool wait(uint64_t token);
+
+  bool isValid() const;
+  bool isAvailable(uint64_t token) const;
+  VkSemaphore getSemaphore() const;
+  uint64_t getAvailableToken() const; // Draw submits have to wait for this value before reading uploaded data
+
+private:
+  // The copies of one submit, its command buffer is reused once the copies are complete
+  struct Batch final
+  {
+    VkCommandBuffer commandBuffer = nullptr;
+    uint64_t token = 0u;
+    VkDeviceSize stagingEnd = 0u;
+    std::vector<VkBufferMemoryBarrier> bufferMemoryBarriers;
+  };
+
+  bool valid = true;
+
+  const Context* context = nullptr;
+
+  VkCommandPool commandPool = nullptr;
+  VkSemaphore semaphore = nullptr; // Timeline, reaches the token of each batch once its copies are complete
+  Buffer* stagingBuffer = nullptr;
+  char* stagingData = nullptr;
+  VkDeviceSize stagingHead = 0u, stagingTail = 0u; // Ever increasing, wrapped around the staging buffer size
+
+  Batch* recordingBatch = nullptr;
+  std::vector<Batch*> submittedBatches, freeBatches;
+  std::vector<VkBufferMemoryBarrier> acquireBarriers; // Of submitted batches, to be recorded on the draw queue
+  size_t recordedAcquireBarrierCount = 0u;             // Recorded into the command buffer of the current frame
+
+  uint64_t nextToken = 1u, submittedToken = UPLOAD_TOKEN_NONE, availableToken = UPLOAD_TOKEN_NONE;
+
+  Batch* beginBatch();
+  bool retireBatches(bool waitForOldest);
+};
\ No newline at end of file
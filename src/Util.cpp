@@ -4,10 +4,17 @@
 
 //#include <boxer/boxer.h>
 
-#include <fstream>
 #include <sstream>
 #include <stdio.h>
 
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#endif
+
 void util::error(Error error, const std::string& details)
 {
   std::stringstream s;
@@ -32,9 +39,15 @@ void util::error(Error error, const std::string& details)
   case Error::HeadsetNotConnected:
     s << "No headset detected.\nPlease make sure that your headset is connected and running";
     break;
+  case Error::InvalidRenderGraph:
+    s << "Render graph is invalid";
+    break;
   case Error::OutOfMemory:
     s << "Program ran out of memory";
     break;
+  case Error::ShaderCompilationFailed:
+    s << "Failed to compile shader";
+    break;
   case Error::VulkanNotSupported:
     s << "Vulkan is not supported";
     break;
@@ -72,6 +85,77 @@ PFN_vkVoidFunction util::loadVkExtensionFunction(VkInstance instance, const std:
   return vkGetInstanceProcAddr(instance, name.c_str());
 }
 
+uint64_t util::hashData(const char* data, size_t size, uint64_t hash)
+{
+  for (size_t index = 0u; index < size; ++index)
+  {
+    hash = (hash ^ static_cast<uint8_t>(data[index])) * 1099511628211u;
+  }
+  return hash;
+}
+
+bool util::setThreadPlacement(int core, bool highPriority)
+{
+  bool success = true;
+
+#ifdef _WIN32
+  const HANDLE thread = GetCurrentThread();
+  if (core >= 0 && SetThreadAffinityMask(thread, static_cast<DWORD_PTR>(1u) << core) == 0u)
+  {
+    success = false;
+  }
+
+  if (highPriority && !SetThreadPriority(thread, THREAD_PRIORITY_HIGHEST))
+  {
+    success = false;
+  }
+#else
+#ifdef __linux__
+  if (core >= 0)
+  {
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    CPU_SET(core, &cpuSet);
+    if (pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+    {
+      success = false;
+    }
+  }
+#else
+  // Threads cannot be pinned to cores on other platforms like macOS
+  if (core >= 0)
+  {
+    success = false;
+  }
+#endif
+
+  // Real-time scheduling usually needs elevated privileges
+  if (highPriority)
+  {
+    sched_param schedParam{};
+    schedParam.sched_priority = sched_get_priority_min(SCHED_FIFO);
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &schedParam) != 0)
+    {
+      success = false;
+    }
+  }
+#endif
+
+  return success;
+}
+
+VkSpecializationInfo util::makeSpecializationInfo(const uint32_t& value)
+{
+  static constexpr VkSpecializationMapEntry specializationMapEntry = { 0u, 0u, sizeof(uint32_t) };
+
+  VkSpecializationInfo specializationInfo;
+  specializationInfo.mapEntryCount = 1u;
+  specializationInfo.pMapEntries = &specializationMapEntry;
+  specializationInfo.dataSize = sizeof(value);
+  specializationInfo.pData = &value;
+  return specializationInfo;
+}
+
 std::vector<const char*> util::unpackExtensionString(const std::string& string)
 {
   std::vector<const char*> out;
@@ -88,34 +172,6 @@ std::vector<const char*> util::unpackExtensionString(const std::string& string)
   return out;
 }
 
-bool util::loadShaderFromFile(VkDevice device, const std::string& filename, VkShaderModule& shaderModule)
-{
-  std::ifstream file(filename, std::ios::ate | std::ios::binary);
-  if (!file.is_open())
-  {
-    return false;
-  }
-
-  const size_t fileSize = static_cast<size_t>(file.tellg());
-  std::vector<char> code(fileSize);
-  file.seekg(0);
-  file.read(code.data(), fileSize);
-  file.close();
-
-  VkShaderModuleCreateInfo shaderModuleCreateInfo;
-  shaderModuleCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-  shaderModuleCreateInfo.pNext = nullptr;
-  shaderModuleCreateInfo.flags = 0u;
-  shaderModuleCreateInfo.codeSize = code.size();
-  shaderModuleCreateInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
-  if (vkCreateShaderModule(device, &shaderModuleCreateInfo, nullptr, &shaderModule) != VK_SUCCESS)
-  {
-    return false;
-  }
-
-  return true;
-}
-
 XrPosef util::makeIdentity()
 {
   XrPosef identity;
@@ -151,4 +207,36 @@ glm::mat4 util::createProjectionMatrix(XrFovf fov, float nearClip, float farClip
   projectionMatrix[2] = { (r + l) / w, (u + d) / h, -(farClip + nearClip) / (farClip - nearClip), -1.0f };
   projectionMatrix[3] = { 0.0f, 0.0f, -(farClip * (nearClip + nearClip)) / (farClip - nearClip), 0.0f };
   return projectionMatrix;
+}
+
+void util::extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4* planes)
+{
+  const glm::mat4 m = glm::transpose(viewProjection); // Rows of the view projection matrix
+
+  // The near plane assumes a [-1, 1] depth range which is conservative for [0, 1] as well
+  planes[0] = m[3] + m[0]; // Left
+  planes[1] = m[3] - m[0]; // Right
+  planes[2] = m[3] + m[1]; // Bottom
+  planes[3] = m[3] - m[1]; // Top
+  planes[4] = m[3] + m[2]; // Near
+  planes[5] = m[3] - m[2]; // Far
+
+  for (size_t planeIndex = 0u; planeIndex < 6u; ++planeIndex)
+  {
+    planes[planeIndex] /= glm::length(glm::vec3(planes[planeIndex]));
+  }
+}
+
+bool util::isSphereInFrustum(const glm::vec4* planes, const glm::vec3& center, float radius)
+{
+  for (size_t planeIndex = 0u; planeIndex < 6u; ++planeIndex)
+  {
+    const glm::vec4& plane = planes[planeIndex];
+    if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+    {
+      return false;
+    }
+  }
+
+  return true;
 }
\ No newline at end of file
@@ -20,7 +20,9 @@ enum class Error
   GenericOpenXR,
   GenericVulkan,
   HeadsetNotConnected,
+  InvalidRenderGraph,
   OutOfMemory,
+  ShaderCompilationFailed,
   VulkanNotSupported,
   WindowFailure
 };
@@ -36,12 +38,19 @@ bool loadXrExtensionFunction(XrInstance instance, const std::string& name, PFN_x
 // Loads a Vulkan extension function by 'name', returns nullptr on error
 PFN_vkVoidFunction loadVkExtensionFunction(VkInstance instance, const std::string& name);
 
+// Hashes 'size' bytes of 'data' with FNV-1a, pass a previous result as 'hash' to continue hashing across buffers
+uint64_t hashData(const char* data, size_t size, uint64_t hash = 14695981039346656037u);
+
+// Pins the calling thread to 'core' unless it is negative and raises its priority if 'highPriority' is set, returns
+// false if the platform does not support or refuses either
+bool setThreadPlacement(int core, bool highPriority);
+
+// Describes a shader variant with a single specialization constant with ID zero, the value has to outlive its use
+VkSpecializationInfo makeSpecializationInfo(const uint32_t& value);
+
 // Unpacks an extension list in a single string into a vector of c-style strings
 std::vector<const char*> unpackExtensionString(const std::string& string);
 
-// Loads a shader from 'file' into 'shaderModule', returns false on error
-bool loadShaderFromFile(VkDevice device, const std::string& filename, VkShaderModule& shaderModule);
-
 // Creates an identity pose
 XrPosef makeIdentity();
 
@@ -50,4 +59,10 @@ glm::mat4 poseToMatrix(const XrPosef& pose);
 
 // Creates a projection matrix
 glm::mat4 createProjectionMatrix(XrFovf fov, float nearClip, float farClip);
+
+// Extracts the six normalized frustum planes of a view projection matrix into 'planes'
+void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4* planes);
+
+// Checks whether a sphere intersects the frustum described by six 'planes'
+bool isSphereInFrustum(const glm::vec4* planes, const glm::vec3& center, float radius);
 } // namespace util
\ No newline at end of file
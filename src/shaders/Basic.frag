@@ -1,3 +1,9 @@
+// Selects the material at pipeline creation, the other materials are folded away by the driver
+layout(constant_id = 0) const uint material = 0;
+
+const uint materialCube = 0;
+const uint materialGrid = 1;
+
 layout(location = 0) in vec3 color;
 layout(location = 1) in vec3 position;
 
@@ -10,6 +16,12 @@ bool isOnGrid(float position, float threshold)
 
 void main()
 {
+  if (material == materialCube)
+  {
+    outColor = vec4(color - position.y * 0.001, 1.0);
+    return;
+  }
+
   const float crossThickness = 0.01;
   const float crossLength = 0.05;
 
@@ -3,10 +3,26 @@
 layout(binding = 0) uniform UniformBufferObject
 {
     mat4 world;
-    mat4 tracked_points[64];
     mat4 viewProjection[2];
+    vec4 frustumPlanes[12];
+    uint objectCount;
 } ubo;
 
+struct Object
+{
+    mat4 transform;
+    vec4 boundingSphere;
+    uint firstIndex;
+    uint indexCount;
+    uint batchIndex;
+    uint drawOffset;
+};
+
+layout(std430, binding = 1) readonly buffer ObjectBuffer
+{
+    Object objects[];
+};
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 
@@ -15,7 +31,8 @@ layout(location = 1) out vec3 position; // In world space
 
 void main()
 {
-  vec4 pos = ubo.world * vec4(inPosition, 1.0);
+  // Every draw references its object through the first instance
+  vec4 pos = ubo.world * objects[gl_InstanceIndex].transform * vec4(inPosition, 1.0);
   gl_Position = ubo.viewProjection[gl_ViewIndex] * pos;
   color = inColor;
   position = pos.xyz;